@@ -0,0 +1,54 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+// Cost of HPP_ASSERT when the condition holds.
+
+#ifndef HPP_ENABLE_ASSERTIONS
+# define HPP_ENABLE_ASSERTIONS
+#endif // HPP_ENABLE_ASSERTIONS
+
+#include <hpp/util/assertion.hh>
+#include <hpp/util/benchmark.hh>
+
+using namespace hpp::benchmark;
+
+static void
+baseline (State& state)
+{
+  int i = 0;
+  while (state.keepRunning ())
+    {
+      ++i;
+      doNotOptimize (i);
+    }
+}
+HPP_BENCHMARK (baseline);
+
+static void
+assertion (State& state)
+{
+  int i = 0;
+  while (state.keepRunning ())
+    {
+      ++i;
+      doNotOptimize (i);
+      HPP_ASSERT (i > 0);
+    }
+}
+HPP_BENCHMARK (assertion);
+
+HPP_BENCHMARK_MAIN ()
@@ -0,0 +1,102 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+// Cost of hpp::Exception.
+
+#include <hpp/util/benchmark.hh>
+#include <hpp/util/debug.hh>
+#include <hpp/util/exception.hh>
+#include <hpp/util/exception-telemetry.hh>
+
+#include "common.hh"
+
+using namespace hpp::benchmark;
+using namespace hpp::debug;
+
+static void
+construct (State& state)
+{
+  while (state.keepRunning ())
+    {
+      hpp::Exception exception ("benchmark exception", __FILE__, __LINE__);
+      doNotOptimize (exception);
+    }
+}
+HPP_BENCHMARK (construct);
+
+static void
+copy (State& state)
+{
+  hpp::Exception exception ("benchmark exception", __FILE__, __LINE__);
+  while (state.keepRunning ())
+    {
+      hpp::Exception copy (exception);
+      doNotOptimize (copy);
+    }
+}
+HPP_BENCHMARK (copy);
+
+static void
+what (State& state)
+{
+  hpp::Exception exception ("benchmark exception", __FILE__, __LINE__);
+  while (state.keepRunning ())
+    doNotOptimize (*exception.what ());
+}
+HPP_BENCHMARK (what);
+
+static void
+throwAndCatch (State& state)
+{
+  while (state.keepRunning ())
+    try
+      {
+	HPP_THROW_EXCEPTION_ ("benchmark exception");
+      }
+    catch (const hpp::Exception& exception)
+      {
+	doNotOptimize (exception);
+      }
+}
+HPP_BENCHMARK (throwAndCatch);
+
+static void
+throwCounted (State& state)
+{
+  // Only the first exception is logged, see ExceptionTelemetry. Keep
+  // it and the summary of the others out of the journal.
+  NullOutput output;
+  logging.info.unsubscribe (&logging.journal);
+  logging.info.subscribe (&output);
+  ExceptionTelemetry::setEnabled (true);
+  while (state.keepRunning ())
+    try
+      {
+	HPP_THROW_EXCEPTION_ ("benchmark exception");
+      }
+    catch (const hpp::Exception& exception)
+      {
+	doNotOptimize (exception);
+      }
+  ExceptionTelemetry::setEnabled (false);
+  ExceptionTelemetry::logSummary ();
+  logging.info.unsubscribe (&output);
+  logging.info.subscribe (&logging.journal);
+}
+HPP_BENCHMARK (throwCounted);
+
+HPP_BENCHMARK_MAIN ()
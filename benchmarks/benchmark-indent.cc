@@ -0,0 +1,78 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+// Cost of the indentation manipulators.
+
+#include <ostream>
+#include <streambuf>
+
+#include <hpp/util/benchmark.hh>
+#include <hpp/util/indent.hh>
+
+using namespace hpp::benchmark;
+
+/// \brief Discard the characters.
+class NullBuffer : public std::streambuf
+{
+protected:
+  int_type overflow (int_type c)
+  {
+    return traits_type::not_eof (c);
+  }
+
+  std::streamsize xsputn (const char*, std::streamsize n)
+  {
+    return n;
+  }
+};
+
+static NullBuffer buffer;
+static std::ostream stream (&buffer);
+
+static void
+plainNewline (State& state)
+{
+  while (state.keepRunning ())
+    stream << "line" << '\n';
+}
+HPP_BENCHMARK (plainNewline);
+
+static void
+indentNewline (State& state)
+{
+  while (state.keepRunning ())
+    stream << "line" << hpp::inl;
+}
+HPP_BENCHMARK (indentNewline);
+
+static void
+indentEndl (State& state)
+{
+  while (state.keepRunning ())
+    stream << "line" << hpp::iendl;
+}
+HPP_BENCHMARK (indentEndl);
+
+static void
+incrementDecrement (State& state)
+{
+  while (state.keepRunning ())
+    stream << hpp::incindent << "line" << hpp::inl << hpp::decindent;
+}
+HPP_BENCHMARK (incrementDecrement);
+
+HPP_BENCHMARK_MAIN ()
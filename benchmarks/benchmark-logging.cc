@@ -0,0 +1,162 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+// Cost of the logging macros and outputs.
+
+#define HPP_DEBUG_CHANNEL_INFO 1
+#define HPP_DEBUG_CHANNEL_NOTICE 0
+
+#include <cstdio>
+#include <string>
+
+#include <hpp/util/benchmark.hh>
+#include <hpp/util/debug.hh>
+
+#include "common.hh"
+
+using namespace hpp::benchmark;
+using namespace hpp::debug;
+
+/// \brief Route the info channel to a null output while alive.
+class InfoToNull
+{
+public:
+  InfoToNull ()
+  {
+    logging.info.unsubscribe (&logging.journal);
+    logging.info.subscribe (&output);
+  }
+
+  ~InfoToNull ()
+  {
+    logging.info.unsubscribe (&output);
+    logging.info.subscribe (&logging.journal);
+  }
+
+  NullOutput output;
+};
+
+static void
+doutCompiledOut (State& state)
+{
+  int i = 0;
+  while (state.keepRunning ())
+    {
+      hppDout (notice, "value " << ++i);
+      doNotOptimize (i);
+    }
+}
+HPP_BENCHMARK (doutCompiledOut);
+
+static void
+doutDisabled (State& state)
+{
+  logging.info.setEnabled (false);
+  int i = 0;
+  while (state.keepRunning ())
+    hppDout (info, "value " << ++i);
+  logging.info.setEnabled (true);
+}
+HPP_BENCHMARK (doutDisabled);
+
+static void
+doutEnabled (State& state)
+{
+  InfoToNull redirect;
+  int i = 0;
+  while (state.keepRunning ())
+    hppDout (info, "value " << ++i);
+}
+HPP_BENCHMARK (doutEnabled);
+
+/// \brief Channel::write to \a n outputs, at most 8.
+static void
+fanOut (State& state, std::size_t n)
+{
+  NullOutput outputs[8];
+  Channel::subscribers_t subscribers;
+  for (std::size_t i = 0; i < n; ++i)
+    subscribers.push_back (&outputs[i]);
+  Channel channel ("BENCHMARK", subscribers);
+  while (state.keepRunning ())
+    channel.write (__FILE__, __LINE__, __PRETTY_FUNCTION__, "record\n");
+}
+
+static void
+channelWrite1 (State& state)
+{
+  fanOut (state, 1);
+}
+HPP_BENCHMARK (channelWrite1);
+
+static void
+channelWrite2 (State& state)
+{
+  fanOut (state, 2);
+}
+HPP_BENCHMARK (channelWrite2);
+
+static void
+channelWrite4 (State& state)
+{
+  fanOut (state, 4);
+}
+HPP_BENCHMARK (channelWrite4);
+
+static void
+channelWrite8 (State& state)
+{
+  fanOut (state, 8);
+}
+HPP_BENCHMARK (channelWrite8);
+
+/// \brief JournalOutput::write, switching between \a functions.
+static void
+journalWrite (State& state, char const* const* functions, std::size_t n)
+{
+  std::string filename;
+  {
+    // Measure formatting rather than one flush per record.
+    JournalOutput journal ("benchmark-journal");
+    journal.setFlushPolicy (Output::FLUSH_ON_SIZE, 1 << 16);
+    filename = journal.getFilename ();
+    std::size_t i = 0;
+    while (state.keepRunning ())
+      journal.write (logging.info, __FILE__, __LINE__, functions[i++ % n],
+		     "record\n");
+  }
+  // The journal is only opened when hpp-util logs to files.
+  std::remove (filename.c_str ());
+}
+
+static char const* const functions[] = { "void f ()", "void g ()" };
+
+static void
+journalWriteSameFunction (State& state)
+{
+  journalWrite (state, functions, 1);
+}
+HPP_BENCHMARK (journalWriteSameFunction);
+
+static void
+journalWriteFunctionChange (State& state)
+{
+  journalWrite (state, functions, 2);
+}
+HPP_BENCHMARK (journalWriteFunctionChange);
+
+HPP_BENCHMARK_MAIN ()
@@ -0,0 +1,103 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+// Cost of the clocks and of Timer.
+
+#include <hpp/util/benchmark.hh>
+#include <hpp/util/clock.hh>
+#include <hpp/util/timer.hh>
+
+using namespace hpp::benchmark;
+using namespace hpp::debug;
+
+static void
+steadyClock (State& state)
+{
+  while (state.keepRunning ())
+    doNotOptimize (steadyNow ());
+}
+HPP_BENCHMARK (steadyClock);
+
+static void
+tscClock (State& state)
+{
+  calibrateTsc ();
+  while (state.keepRunning ())
+    doNotOptimize (tscNow ());
+}
+HPP_BENCHMARK (tscClock);
+
+static void
+threadCpuClock (State& state)
+{
+  while (state.keepRunning ())
+    doNotOptimize (threadCpuNow ());
+}
+HPP_BENCHMARK (threadCpuClock);
+
+static void
+startStop (State& state, ClockSource source)
+{
+  Timer timer (source);
+  while (state.keepRunning ())
+    {
+      timer.start ();
+      timer.stop ();
+    }
+  doNotOptimize (timer);
+}
+
+static void
+timerSteady (State& state)
+{
+  startStop (state, STEADY_CLOCK);
+}
+HPP_BENCHMARK (timerSteady);
+
+static void
+timerTsc (State& state)
+{
+  startStop (state, TSC_CLOCK);
+}
+HPP_BENCHMARK (timerTsc);
+
+static void
+timerThreadCpu (State& state)
+{
+  startStop (state, THREAD_CPU_CLOCK);
+}
+HPP_BENCHMARK (timerThreadCpu);
+
+static void
+timerCompensated (State& state)
+{
+  Timer::setOverheadCompensation (true);
+  startStop (state, STEADY_CLOCK);
+  Timer::setOverheadCompensation (false);
+}
+HPP_BENCHMARK (timerCompensated);
+
+static void
+timerPerfCounters (State& state)
+{
+  PerfCounters::setEnabled (true);
+  startStop (state, STEADY_CLOCK);
+  PerfCounters::setEnabled (false);
+}
+HPP_BENCHMARK (timerPerfCounters);
+
+HPP_BENCHMARK_MAIN ()
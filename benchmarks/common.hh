@@ -0,0 +1,35 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef BENCHMARKS_COMMON_HH
+# define BENCHMARKS_COMMON_HH
+# include <hpp/util/benchmark.hh>
+# include <hpp/util/debug.hh>
+
+/// \brief Discard the records.
+class NullOutput : public ::hpp::debug::Output
+{
+public:
+  void write (const ::hpp::debug::Channel&, char const*, int, char const*,
+	      boost::string_ref data)
+  {
+    ::hpp::benchmark::doNotOptimize (data);
+  }
+};
+
+#endif //! BENCHMARKS_COMMON_HH
@@ -0,0 +1,78 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_ALLOCATION_TRACKER_HH
+# define HPP_UTIL_ALLOCATION_TRACKER_HH
+# include <iosfwd>
+
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Heap allocations made by a thread.
+    struct HPP_UTIL_DLLAPI AllocationCounters
+    {
+      AllocationCounters ();
+
+      boost::uint64_t allocations;
+      boost::uint64_t deallocations;
+      /// \brief Bytes allocated.
+      boost::uint64_t bytes;
+      /// \brief Bytes allocated minus bytes freed by the thread,
+      /// negative if it frees memory allocated by other threads.
+      boost::int64_t live;
+    };
+
+    /// \brief Heap allocations per profiled region (hpp-util-alloc
+    /// library).
+    ///
+    /// Linking a program against hpp-util-alloc replaces the global
+    /// operator new and delete by versions counting, per thread, the
+    /// allocations, the bytes and the live bytes. The library observes
+    /// the regions of ProfileScope (hppProfileScope,
+    /// hppStartBenchmark...) and adds to each region name:
+    /// \li the number of calls,
+    /// \li the allocations, deallocations and bytes allocated by the
+    ///     thread in the region,
+    /// \li the largest increase of live bytes within a call (peak),
+    /// \li the change of the resident set size of the process, only
+    ///     measured for the calls not nested in another region, as
+    ///     reading it is a system call ("-" if there were none).
+    ///
+    /// The counts of a region include its child regions. The report is
+    /// logged to the benchmark channel at exit.
+    class HPP_UTIL_DLLAPI AllocationTracker
+    {
+    public:
+      /// \brief Counters of the calling thread.
+      static AllocationCounters current ();
+
+      /// \brief Resident set size of the process in bytes, 0 if not
+      /// available.
+      static boost::uint64_t residentSetSize ();
+
+      /// \brief Print the allocations of each region.
+      static void print (std::ostream& o);
+
+      /// \brief Log the report to the benchmark channel, if any region
+      /// was left.
+      static void logReport ();
+
+      /// \brief Forget the regions measured so far.
+      static void reset ();
+    };
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_ALLOCATION_TRACKER_HH
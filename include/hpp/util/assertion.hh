@@ -10,38 +10,202 @@
 
 #ifndef HPP_UTIL_ASSERTION_HH
 # define HPP_UTIL_ASSERTION_HH
+# include <iosfwd>
+
+# include <boost/atomic.hpp>
+# include <boost/cstdint.hpp>
 # include <boost/scope_exit.hpp>
 
 # include <hpp/util/config.hh>
+# include <hpp/util/portability.hh>
 # include <hpp/util/exception.hh>
 
+# ifdef HPP_PROFILE_ASSERTIONS
+#  include <hpp/util/clock.hh>
+# endif // HPP_PROFILE_ASSERTIONS
+
 // If debug mode is disabled and assertions are not already
 // disabled, disable them automatically.
 # if (defined HPP_DEBUG) && (!defined HPP_ENABLE_ASSERTIONS)
 #  define HPP_ENABLE_ASSERTIONS
 # endif // (!defined HPP_DEBUG) && (!defined HPP_ENABLE_ASSERTIONS)
 
+/// \brief Highest level of the assertions compiled in.
+///
+/// 0 compiles all the assertions out, 1 keeps HPP_ASSERT_CHEAP, 2
+/// adds HPP_ASSERT, 3 adds HPP_ASSERT_AUDIT. Defaults to 2 if
+/// HPP_ENABLE_ASSERTIONS is defined, 0 otherwise.
+# ifndef HPP_ASSERTION_LEVEL
+#  ifdef HPP_ENABLE_ASSERTIONS
+#   define HPP_ASSERTION_LEVEL 2
+#  else
+#   define HPP_ASSERTION_LEVEL 0
+#  endif // HPP_ENABLE_ASSERTIONS
+# endif // HPP_ASSERTION_LEVEL
+
 namespace hpp
 {
   HPP_MAKE_EXCEPTION (HPP_UTIL_DLLAPI, AssertionError);
+
+  enum AssertionLevel
+    {
+      /// \brief Constant time checks, affordable in production.
+      ASSERTION_CHEAP = 1,
+      ASSERTION_NORMAL = 2,
+      /// \brief Expensive checks, such as O(n) invariants.
+      ASSERTION_AUDIT = 3
+    };
+
+  /// \brief Assertion call site, profiled if HPP_PROFILE_ASSERTIONS
+  /// is defined.
+  ///
+  /// Sites are static objects of the assertions, registered the first
+  /// time they are checked, like RateLimiter. They count the
+  /// evaluations of the condition and the time spent in them.
+  class HPP_UTIL_DLLAPI AssertionSite
+  {
+  public:
+    AssertionSite (char const* condition,
+		   char const* file,
+		   unsigned line,
+		   int level);
+
+    /// \brief Add an evaluation of \a duration nanoseconds.
+    void record (boost::uint64_t duration)
+    {
+      evaluations_.fetch_add (1, boost::memory_order_relaxed);
+      time_.fetch_add (duration, boost::memory_order_relaxed);
+    }
+
+    char const* condition () const;
+    char const* file () const;
+    unsigned line () const;
+    int level () const;
+
+    boost::uint64_t evaluations () const;
+    /// \brief Time spent evaluating the condition, in nanoseconds,
+    /// including the clock reading bias.
+    boost::uint64_t time () const;
+
+  private:
+    AssertionSite (const AssertionSite&);
+    AssertionSite& operator= (const AssertionSite&);
+
+    friend class Assertion;
+
+    char const* condition_;
+    char const* file_;
+    unsigned line_;
+    int level_;
+    boost::atomic<boost::uint64_t> evaluations_;
+    boost::atomic<boost::uint64_t> time_;
+
+    /// \brief Next registered site.
+    AssertionSite* next_;
+  };
+
+  /// \brief Runtime control and failure path of the assertions.
+  class HPP_UTIL_DLLAPI Assertion
+  {
+  public:
+    /// \brief Only check the assertions up to \a level from now on.
+    ///
+    /// Assertions above HPP_ASSERTION_LEVEL are compiled out
+    /// whatever the level. All the levels are checked by default.
+    static void setLevel (AssertionLevel level);
+    static AssertionLevel level ();
+
+    /// \brief Whether assertions of \a level are checked.
+    static bool isEnabled (int level)
+    {
+      return level + lowered_.load (boost::memory_order_relaxed)
+	<= ASSERTION_AUDIT;
+    }
+
+    /// \brief Print the \a count sites which took the most time
+    /// evaluating their condition.
+    static void printProfile (std::ostream& o, std::size_t count = 20);
+
+    /// \brief Log the profile to the benchmark channel, if any site
+    /// was registered.
+    ///
+    /// Logging calls it on destruction.
+    static void logProfile ();
+
+    /// \brief Throw an AssertionError for \a condition.
+    ///
+    /// Out of line, so that the assertions only inline the test.
+    HPP_NORETURN HPP_COLD static void
+    fail (char const* condition, char const* file, unsigned line);
+
+  private:
+    /// \brief Number of levels disabled at runtime.
+    ///
+    /// Zero-initialized, hence valid before static initialization.
+    static boost::atomic<int> lowered_;
+  };
 } // end of namespace hpp.
 
+/// \brief Check CONDITION if assertions of LEVEL are enabled at
+/// runtime.
+///
+/// If HPP_PROFILE_ASSERTIONS is defined, the evaluation is timed and
+/// recorded in the AssertionSite of the assertion.
+# ifdef HPP_PROFILE_ASSERTIONS
+#  define HPP_ASSERT_AT_LEVEL_(LEVEL, CONDITION)			\
+  do {									\
+    if (::hpp::Assertion::isEnabled (LEVEL))				\
+      {									\
+	static ::hpp::AssertionSite _site_				\
+	  (#CONDITION, __FILE__, __LINE__, LEVEL);			\
+	boost::uint64_t _start_ = ::hpp::debug::tscNow ();		\
+	bool _holds_ = (CONDITION);					\
+	_site_.record (::hpp::debug::tscNow () - _start_);		\
+	if (HPP_UNLIKELY (!_holds_))					\
+	  ::hpp::Assertion::fail (#CONDITION, __FILE__, __LINE__);	\
+      }									\
+  } while (0)
+# else
+#  define HPP_ASSERT_AT_LEVEL_(LEVEL, CONDITION)			\
+  do {								\
+    if (::hpp::Assertion::isEnabled (LEVEL)			\
+	&& HPP_UNLIKELY (!(CONDITION)))				\
+      ::hpp::Assertion::fail (#CONDITION, __FILE__, __LINE__);	\
+  } while (0)
+# endif // HPP_PROFILE_ASSERTIONS
+
+/// \brief Define HPP_ASSERT_CHEAP.
+///
+/// Throw an ::hpp::AssertionError if macro argument evaluates to
+/// false, compiled in if HPP_ASSERTION_LEVEL >= 1.
+# if HPP_ASSERTION_LEVEL >= 1
+#  define HPP_ASSERT_CHEAP(CONDITION)				\
+  HPP_ASSERT_AT_LEVEL_ (::hpp::ASSERTION_CHEAP, CONDITION)
+# else
+#  define HPP_ASSERT_CHEAP(CONDITION)
+# endif // HPP_ASSERTION_LEVEL >= 1
+
 /// \brief Define HPP_ASSERT.
 ///
 /// Throw an ::hpp::AssertionError if macro argument evaluates to
-/// false.
-# ifdef HPP_ENABLE_ASSERTIONS
+/// false, compiled in if HPP_ASSERTION_LEVEL >= 2.
+# if HPP_ASSERTION_LEVEL >= 2
 #  define HPP_ASSERT(CONDITION)					\
-  do {								\
-    bool _x = (CONDITION);					\
-    if (!_x)							\
-      HPP_THROW_EXCEPTION					\
-	(::hpp::AssertionError,					\
-	 #CONDITION " evaluates to false");			\
-  } while (0)
+  HPP_ASSERT_AT_LEVEL_ (::hpp::ASSERTION_NORMAL, CONDITION)
 # else
 #  define HPP_ASSERT(CONDITION)
-# endif // HPP_ENABLE_ASSERTIONS
+# endif // HPP_ASSERTION_LEVEL >= 2
+
+/// \brief Define HPP_ASSERT_AUDIT.
+///
+/// Throw an ::hpp::AssertionError if macro argument evaluates to
+/// false, compiled in if HPP_ASSERTION_LEVEL >= 3.
+# if HPP_ASSERTION_LEVEL >= 3
+#  define HPP_ASSERT_AUDIT(CONDITION)				\
+  HPP_ASSERT_AT_LEVEL_ (::hpp::ASSERTION_AUDIT, CONDITION)
+# else
+#  define HPP_ASSERT_AUDIT(CONDITION)
+# endif // HPP_ASSERTION_LEVEL >= 3
 
 /// \brief Define macro for precondition checking.
 # define HPP_PRECONDITION(CONDITION) HPP_ASSERT (CONDITION)
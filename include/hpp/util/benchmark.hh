@@ -0,0 +1,205 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_BENCHMARK_HH
+# define HPP_UTIL_BENCHMARK_HH
+# include <iosfwd>
+# include <string>
+# include <vector>
+
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+
+/// \brief Micro-benchmark harness (hpp-util-benchmark library).
+///
+/// A benchmark is a function looping while State::keepRunning
+/// returns true:
+///
+/// \code
+/// static void pushBack (hpp::benchmark::State& state)
+/// {
+///   std::vector<int> v;
+///   while (state.keepRunning ())
+///     {
+///       v.push_back (1);
+///       hpp::benchmark::doNotOptimize (v.back ());
+///     }
+/// }
+/// HPP_BENCHMARK (pushBack);
+/// HPP_BENCHMARK_MAIN ()
+/// \endcode
+///
+/// The runner warms each benchmark up, chooses an iteration count
+/// reaching a minimum time, then times several repetitions of that
+/// count. Run the program with --help for the options.
+///
+/// Benchmark programs link against hpp-util-benchmark, found through
+/// the hpp-util-benchmark pkg-config file.
+namespace hpp
+{
+  namespace benchmark
+  {
+    /// \brief Iteration state of a running benchmark.
+    class HPP_UTIL_DLLAPI State
+    {
+    public:
+      explicit State (boost::uint64_t iterations);
+
+      /// \brief Whether the benchmark should run one more iteration.
+      bool keepRunning ()
+      {
+	if (remaining_)
+	  {
+	    --remaining_;
+	    return true;
+	  }
+	return false;
+      }
+
+      /// \brief Number of iterations of this run.
+      boost::uint64_t iterations () const;
+
+    private:
+      boost::uint64_t iterations_;
+      boost::uint64_t remaining_;
+    };
+
+    typedef void (*function_t) (State& state);
+
+    /// \brief Register a benchmark, see HPP_BENCHMARK.
+    class HPP_UTIL_DLLAPI Registrar
+    {
+    public:
+      Registrar (char const* name, function_t function);
+    };
+
+    /// \brief Runner settings, parsed from the command line.
+    struct HPP_UTIL_DLLAPI Options
+    {
+      Options ();
+
+      /// \brief Parse \a argv, write errors and --help to \a o.
+      ///
+      /// \return false if the program should exit
+      bool parse (int argc, char** argv, std::ostream& o);
+
+      /// \brief Only run the benchmarks whose name contains it.
+      std::string filter;
+      /// \brief Number of timed runs of each benchmark.
+      unsigned int repetitions;
+      /// \brief Minimum duration of a timed run, in seconds.
+      double minTime;
+      /// \brief Maximum iteration count of a timed run, reached by
+      /// benchmarks too fast to measure.
+      boost::uint64_t maxIterations;
+      /// \brief Duration of the warmup, in seconds.
+      double warmupTime;
+      /// \brief Write JSON instead of text.
+      bool json;
+      /// \brief Write JSON results to this file as well.
+      std::string output;
+      /// \brief Compare results with this JSON file.
+      std::string baseline;
+      /// \brief Relative slowdown of the median flagged as a
+      /// regression.
+      double threshold;
+    };
+
+    /// \brief Timing of a benchmark, per iteration, in nanoseconds.
+    struct HPP_UTIL_DLLAPI Result
+    {
+      Result ();
+
+      std::string name;
+      boost::uint64_t iterations;
+      unsigned int repetitions;
+      double min;
+      double median;
+      double mean;
+      double stddev;
+      /// \brief Whether runs of Options::maxIterations iterations
+      /// were shorter than Options::minTime: the timings are not
+      /// meaningful.
+      bool tooFast;
+    };
+
+    typedef std::vector<Result> results_t;
+
+    /// \brief Prevent the compiler from optimizing \a value away.
+    template <typename T>
+    inline void doNotOptimize (const T& value)
+    {
+# ifdef __GNUC__
+      asm volatile ("" : : "g" (&value) : "memory");
+# else
+      static const T* volatile sink;
+      sink = &value;
+# endif // __GNUC__
+    }
+
+    /// \brief Force pending memory writes to be performed.
+    inline void clobberMemory ()
+    {
+# ifdef __GNUC__
+      asm volatile ("" : : : "memory");
+# endif // __GNUC__
+    }
+
+    /// \brief Run the registered benchmarks selected by \a options.
+    HPP_UTIL_DLLAPI results_t run (const Options& options);
+
+    /// \brief Warn about settings making timings unreliable (CPU
+    /// frequency scaling...).
+    ///
+    /// \return whether there were warnings
+    HPP_UTIL_DLLAPI bool checkEnvironment (std::ostream& o);
+
+    HPP_UTIL_DLLAPI void printText (std::ostream& o, const results_t& results);
+    HPP_UTIL_DLLAPI void printJson (std::ostream& o, const results_t& results);
+
+    /// \brief Read results written by printJson.
+    ///
+    /// \throw std::runtime_error if \a i is not valid JSON or a
+    /// benchmark misses a field.
+    HPP_UTIL_DLLAPI results_t readJson (std::istream& i);
+
+    /// \brief Print the change of the median of each benchmark
+    /// against \a baseline.
+    ///
+    /// Benchmarks too fast to measure are not compared.
+    ///
+    /// \return number of regressions, slowdowns above \a threshold
+    HPP_UTIL_DLLAPI std::size_t compare (std::ostream& o,
+					 const results_t& results,
+					 const results_t& baseline,
+					 double threshold);
+
+    /// \brief Run the benchmarks as configured by the command line.
+    ///
+    /// \return the exit status: non-zero on errors and regressions
+    HPP_UTIL_DLLAPI int main (int argc, char** argv);
+  } // end of namespace benchmark
+} // end of namespace hpp
+
+/// \brief Register benchmark function \a FUNCTION.
+# define HPP_BENCHMARK(FUNCTION)					\
+  static ::hpp::benchmark::Registrar					\
+  _##FUNCTION##_registrar_ (#FUNCTION, &FUNCTION)
+
+/// \brief Define main running the registered benchmarks.
+# define HPP_BENCHMARK_MAIN()			\
+  int						\
+  main (int argc, char** argv)			\
+  {						\
+    return ::hpp::benchmark::main (argc, argv);	\
+  }
+
+#endif //! HPP_UTIL_BENCHMARK_HH
@@ -0,0 +1,205 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_BINARY_RECORD_HH
+# define HPP_UTIL_BINARY_RECORD_HH
+# include <cstddef>
+# include <ios>
+# include <ostream>
+# include <sstream>
+# include <string>
+
+# include <boost/cstdint.hpp>
+# include <boost/utility/string_ref.hpp>
+
+# include <hpp/util/config.hh>
+
+/// \brief First bytes of a binary journal file.
+///
+/// A binary journal is made of this magic string followed by entries,
+/// each starting with a one byte kind (see BinaryJournalEntry):
+/// \li call site definition, written before the first message of a
+/// site: u32 site id, i32 line, then the channel label, file, function
+/// and format as u32 length followed by the characters;
+/// \li message: u32 site id, u64 monotonic timestamp in nanoseconds,
+/// u32 size, then the arguments serialized by BinaryRecord.
+///
+/// Integers are stored in native byte order.
+# define HPP_UTIL_BINARY_JOURNAL_MAGIC "HPPBLOG1"
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Kinds of binary journal entries.
+    enum BinaryJournalEntry
+      {
+	ENTRY_SITE = 'S',
+	ENTRY_MESSAGE = 'M'
+      };
+
+    /// \brief Static description of a logging call site.
+    ///
+    /// Binary journals write this metadata once per site and then
+    /// only refer to the site by its identifier.
+    class HPP_UTIL_DLLAPI CallSite
+    {
+    public:
+      /// \param file source file (must outlive the site)
+      /// \param line source line
+      /// \param function enclosing function (must outlive the site)
+      /// \param format streamed expression, as written in the source
+      CallSite (char const* file,
+		int line,
+		char const* function,
+		char const* format);
+
+      /// \brief Process-wide unique identifier, never zero.
+      boost::uint32_t id () const
+      {
+	return id_;
+      }
+
+      char const* file () const
+      {
+	return file_;
+      }
+
+      int line () const
+      {
+	return line_;
+      }
+
+      char const* function () const
+      {
+	return function_;
+      }
+
+      char const* format () const
+      {
+	return format_;
+      }
+
+    private:
+      boost::uint32_t id_;
+      char const* file_;
+      int line_;
+      char const* function_;
+      char const* format_;
+    };
+
+    /// \brief Arguments of a logging statement, in binary form.
+    ///
+    /// Records the values streamed into it with a one byte type tag,
+    /// so that they can be formatted later, possibly by another
+    /// process (see hpp-log-decode). Fundamental types, strings and
+    /// the hpp indentation manipulators are stored raw; other types
+    /// are formatted through their operator<< when streamed. Changes
+    /// of the format flags, precision and field width, as made by
+    /// std::hex, std::setprecision or std::setw, are recorded too.
+    ///
+    /// Values are stored in native byte order.
+    class HPP_UTIL_DLLAPI BinaryRecord
+    {
+    public:
+      /// \brief Argument type tags.
+      enum Tag
+	{
+	  TAG_BOOL = 'b',
+	  TAG_CHAR = 'c',
+	  TAG_SIGNED = 'i',
+	  TAG_UNSIGNED = 'u',
+	  TAG_DOUBLE = 'd',
+	  TAG_POINTER = 'p',
+	  TAG_STRING = 's',
+	  TAG_FLAGS = 'f',
+	  TAG_PRECISION = 'r',
+	  TAG_WIDTH = 'w',
+	  TAG_IENDL = 'n',
+	  TAG_INCENDL = '>',
+	  TAG_DECENDL = '<',
+	  TAG_INCINDENT = '+',
+	  TAG_DECINDENT = '-',
+	  TAG_RESETINDENT = '0'
+	};
+
+      BinaryRecord ();
+
+      BinaryRecord& operator<< (bool value);
+      BinaryRecord& operator<< (char value);
+      BinaryRecord& operator<< (signed char value);
+      BinaryRecord& operator<< (unsigned char value);
+      BinaryRecord& operator<< (short value);
+      BinaryRecord& operator<< (unsigned short value);
+      BinaryRecord& operator<< (int value);
+      BinaryRecord& operator<< (unsigned int value);
+      BinaryRecord& operator<< (long value);
+      BinaryRecord& operator<< (unsigned long value);
+      BinaryRecord& operator<< (long long value);
+      BinaryRecord& operator<< (unsigned long long value);
+      BinaryRecord& operator<< (float value);
+      BinaryRecord& operator<< (double value);
+      BinaryRecord& operator<< (const void* value);
+      BinaryRecord& operator<< (const char* value);
+      BinaryRecord& operator<< (char* value);
+      BinaryRecord& operator<< (const std::string& value);
+      BinaryRecord& operator<< (boost::string_ref value);
+      BinaryRecord& operator<< (std::ostream& (*manipulator) (std::ostream&));
+      BinaryRecord&
+	operator<< (std::ios_base& (*manipulator) (std::ios_base&));
+
+      /// \brief Format any other streamable value immediately, with
+      /// the current format state.
+      template <typename T>
+      BinaryRecord& operator<< (const T& value)
+      {
+	std::ostringstream stream;
+	stream.flags (flags_);
+	stream.precision (precision_);
+	stream.width (width_);
+	stream << value;
+	return append (stream);
+      }
+
+      const char* data () const;
+      std::size_t size () const;
+
+      /// \brief Format the record as the original stream expression.
+      void print (std::ostream& o) const;
+
+      /// \brief Format serialized arguments.
+      ///
+      /// \return false if the data is truncated or corrupted.
+      static bool print (std::ostream& o, const char* data, std::size_t size);
+
+    private:
+      void append (const void* value, std::size_t size);
+      void append (char tag, const void* value, std::size_t size);
+      /// \brief Record the format state and the text of \a stream.
+      BinaryRecord& append (const std::ostringstream& stream);
+
+      static const std::size_t inlineCapacity = 256;
+
+      /// \brief Storage for short records, avoiding any allocation.
+      char inline_[inlineCapacity];
+      /// \brief Storage for records larger than inlineCapacity.
+      std::string overflow_;
+      std::size_t size_;
+      /// \brief Format state, as set by manipulators.
+      std::ios_base::fmtflags flags_;
+      std::streamsize precision_;
+      /// \brief Width of the next value, 0 once it is written.
+      std::streamsize width_;
+    };
+
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_BINARY_RECORD_HH
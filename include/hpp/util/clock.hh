@@ -0,0 +1,64 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_CLOCK_HH
+# define HPP_UTIL_CLOCK_HH
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Clocks available for timing measurements.
+    ///
+    /// All of them return nanoseconds.
+    enum ClockSource
+      {
+	/// \brief Monotonic clock (clock_gettime (CLOCK_MONOTONIC)).
+	STEADY_CLOCK,
+	/// \brief Time stamp counter, converted to nanoseconds on the
+	/// steady clock scale after a calibration.
+	///
+	/// Falls back to the steady clock when the processor has no
+	/// invariant time stamp counter.
+	TSC_CLOCK,
+	/// \brief CPU time consumed by the calling thread.
+	THREAD_CPU_CLOCK
+      };
+
+    /// \brief Monotonic time in nanoseconds.
+    HPP_UTIL_DLLAPI boost::uint64_t steadyNow ();
+
+    /// \brief Time stamp counter time in nanoseconds.
+    ///
+    /// The first call calibrates the counter against the steady
+    /// clock, which takes about 10 ms: call calibrateTsc at startup
+    /// to avoid this delay in a measurement.
+    HPP_UTIL_DLLAPI boost::uint64_t tscNow ();
+
+    /// \brief CPU time of the calling thread in nanoseconds.
+    HPP_UTIL_DLLAPI boost::uint64_t threadCpuNow ();
+
+    /// \brief Current time of \a source in nanoseconds.
+    HPP_UTIL_DLLAPI boost::uint64_t clockNow (ClockSource source);
+
+    /// \brief Whether TSC_CLOCK actually reads the time stamp counter.
+    HPP_UTIL_DLLAPI bool isTscAvailable ();
+
+    /// \brief Calibrate the time stamp counter, if not done yet.
+    ///
+    /// \return the counter frequency in Hz, 0 if not available
+    HPP_UTIL_DLLAPI double calibrateTsc ();
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_CLOCK_HH
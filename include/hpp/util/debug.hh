@@ -10,21 +10,34 @@
 
 #ifndef HPP_UTIL_DEBUG_HH
 # define HPP_UTIL_DEBUG_HH
+# include <cstddef>
 # include <cstdlib>
 # include <ostream>
 # include <fstream>
+# include <map>
 # include <sstream>
 # include <vector>
 
+# include <boost/atomic.hpp>
+# include <boost/cstdint.hpp>
+# include <boost/thread/mutex.hpp>
+# include <boost/utility/string_ref.hpp>
+
 # include <hpp/util/config.hh>
+# include <hpp/util/binary-record.hh>
+# include <hpp/util/format-buffer.hh>
 # include <hpp/util/indent.hh>
+# include <hpp/util/rate-limiter.hh>
 
 namespace hpp
 {
   namespace debug
   {
+    class AsyncWriter;
+    class ThreadedWriter;
     class Output;
     class JournalOutput;
+    class BinaryJournalOutput;
     class ConsoleOutput;
 
     class Channel;
@@ -81,9 +94,45 @@ namespace hpp
     /// \li console which points to std::cerr
     /// \li journal which points to the ``journal'' file in the
     /// debugging prefix
+    ///
+    /// An output is synchronous by default: each record is written
+    /// and flushed by the thread emitting it. Outputs supporting it
+    /// can be switched to an asynchronous mode where finished records
+    /// are queued into a bounded ring and written in batches by a
+    /// background thread.
     class HPP_UTIL_DLLAPI Output
     {
     public:
+      /// \brief Behavior of an asynchronous output when its queue is full.
+      enum OverflowPolicy
+	{
+	  /// \brief Wait until the writer thread makes room.
+	  BLOCK,
+	  /// \brief Discard the record being written.
+	  DROP_NEWEST,
+	  /// \brief Discard the oldest queued record.
+	  DROP_OLDEST
+	};
+
+      /// \brief When a synchronous output flushes its stream.
+      ///
+      /// Whatever the policy, records of urgent channels (see
+      /// setUrgent) are flushed immediately, and flush writes
+      /// everything.
+      enum FlushPolicy
+	{
+	  /// \brief After every record.
+	  FLUSH_ALWAYS,
+	  /// \brief When the records written since the last flush reach
+	  /// a number of bytes.
+	  FLUSH_ON_SIZE,
+	  /// \brief After the first record written a number of
+	  /// milliseconds after the last flush.
+	  FLUSH_ON_INTERVAL,
+	  /// \brief Only after records of urgent channels.
+	  FLUSH_ON_SEVERITY
+	};
+
       explicit Output ();
       virtual ~Output ();
 
@@ -92,15 +141,100 @@ namespace hpp
 	       char const* file,
 	       int line,
 	       char const* function,
-	       const std::string& data) = 0;
+	       boost::string_ref data) = 0;
+
+      /// \brief Write a record whose arguments are still in binary form.
+      ///
+      /// By default, format the record and forward it to write.
+      virtual void
+	writeBinary (const Channel& channel,
+		     const CallSite& site,
+		     const BinaryRecord& record);
+
+      /// \brief Wait until all queued records are written and flushed.
+      ///
+      /// Does nothing for a synchronous output.
+      virtual void flush ();
+
+      /// \brief Stop the writer thread, if any, after having drained
+      /// its queue.
+      virtual void setSynchronous ();
+
+      bool isAsynchronous () const;
+
+      /// \brief Number of records discarded by the overflow policy.
+      virtual unsigned long long droppedRecords () const;
+
+      /// \brief Choose when the output is flushed in synchronous mode.
+      ///
+      /// Asynchronous writers flush after each batch instead.
+      ///
+      /// \param policy flushing condition
+      /// \param threshold number of bytes for FLUSH_ON_SIZE,
+      /// milliseconds for FLUSH_ON_INTERVAL, ignored otherwise
+      void setFlushPolicy (FlushPolicy policy,
+			   boost::uint64_t threshold = 0);
+
+      FlushPolicy flushPolicy () const;
+
+      /// \brief Flush right after the records of \a channel, whatever
+      /// the flush policy.
+      void setUrgent (const Channel& channel, bool urgent = true);
+
+      /// \brief Enable or disable the output.
+      ///
+      /// A disabled output ignores the records it receives. Channels
+      /// whose outputs are all disabled skip message formatting.
+      void setEnabled (bool enabled);
+
+      bool isEnabled () const;
 
     protected:
+      /// \brief Start writing queued records to \a stream from a
+      /// background thread.
+      ///
+      /// \param stream stream the records are written to, it must
+      /// not be used by anyone else until setSynchronous is called.
+      /// \param capacity maximum number of queued records
+      /// \param policy behavior when the queue is full
+      void startAsynchronous (std::ostream& stream,
+			      std::size_t capacity,
+			      OverflowPolicy policy);
+
+      /// \brief Queue a formatted record (asynchronous mode only).
+      void push (boost::string_ref record);
+
+      /// \brief Account for a record written in synchronous mode.
+      ///
+      /// \param size size of the record in bytes
+      /// \return whether the flush policy requires a flush now
+      bool shouldFlush (const Channel& channel, std::size_t size);
+
       std::ostream&
 	writePrefix (std::ostream& stream,
 		     const Channel& channel,
 		     char const* file,
 		     int line,
 		     char const* function);
+
+    private:
+      Output (const Output&);
+      Output& operator= (const Output&);
+
+      friend class Channel;
+
+      AsyncWriter* asyncWriter_;
+      boost::atomic<bool> enabled_;
+
+      FlushPolicy flushPolicy_;
+      boost::uint64_t flushThreshold_;
+      /// \brief Bytes written since the last flush.
+      boost::uint64_t unflushedSize_;
+      /// \brief Monotonic time of the last flush, in nanoseconds.
+      boost::uint64_t lastFlush_;
+      std::vector<const Channel*> urgentChannels_;
+      /// \brief Channels this output is subscribed to.
+      std::vector<Channel*> channels_;
     };
 
     /// \brief Receive debugging information.
@@ -113,6 +247,13 @@ namespace hpp
     /// - warning for non-fatal problems
     /// - notice for user information
     /// - info for technical information and debugging output
+    ///
+    /// A channel is enabled when it has not been disabled explicitly
+    /// and at least one of its subscribers is enabled. Logging macros
+    /// check this flag before formatting anything.
+    ///
+    /// Subscriptions and enabling are configuration operations: they
+    /// must not run concurrently with write.
     class HPP_UTIL_DLLAPI Channel
     {
     public:
@@ -125,18 +266,64 @@ namespace hpp
       void write (char const* file,
 		  int line,
 		  char const* function,
-		  const std::string& data);
+		  boost::string_ref data);
+
+      /// \brief Forward a record in binary form to the subscribers.
+      void write (const CallSite& site, const BinaryRecord& record);
 
       const char* label () const;
+
+      const subscribers_t& subscribers () const;
+
+      /// \brief Add an output to the subscribers.
+      void subscribe (Output* output);
+
+      /// \brief Remove an output from the subscribers.
+      void unsubscribe (Output* output);
+
+      /// \brief Enable or disable the channel independently of
+      /// its subscribers.
+      void setEnabled (bool enabled);
+
+      /// \brief Whether writing to this channel has any effect.
+      bool isEnabled () const
+      {
+	return enabled_.load (boost::memory_order_relaxed);
+      }
+
     private:
+      Channel (const Channel&);
+      Channel& operator= (const Channel&);
+
+      friend class Output;
+
+      /// \brief Recompute the enabled flag.
+      void update ();
+
       const char* label_;
       subscribers_t subscribers_;
+      bool userEnabled_;
+      boost::atomic<bool> enabled_;
     };
 
     /// \brief Logging in journal file in the logging directory.
+    ///
+    /// In synchronous and asynchronous modes, the journal keeps track
+    /// of the last function logged and must only be written by one
+    /// thread at a time. Use the thread-aware mode when several
+    /// threads log concurrently.
     class HPP_UTIL_DLLAPI JournalOutput : public Output
     {
     public:
+      /// \brief Destination of the records in thread-aware mode.
+      enum ThreadLayout
+	{
+	  /// \brief Merge the records of all threads by timestamp.
+	  MERGED,
+	  /// \brief Write one journal.PID.N.log file per thread.
+	  SHARDED
+	};
+
       explicit JournalOutput (std::string filename);
       ~JournalOutput ();
 
@@ -144,14 +331,109 @@ namespace hpp
 		  char const* file,
 		  int line,
 		  char const* function,
-		  const std::string& data);
+		  boost::string_ref data);
 
       std::string getFilename () const;
 
+      /// \brief Write the journal from a background thread.
+      ///
+      /// \param capacity maximum number of queued records
+      /// \param policy behavior when the queue is full
+      void setAsynchronous (std::size_t capacity = 4096,
+			    OverflowPolicy policy = BLOCK);
+
+      /// \brief Make the journal safe to write from several threads.
+      ///
+      /// Each thread formats its records with its own entering/exiting
+      /// tracking and indentation, and queues them into its own buffer.
+      /// A background thread writes them according to \a layout.
+      ///
+      /// \param layout merge all records or write one file per thread
+      /// \param capacity number of records buffered per thread
+      void setThreadAware (ThreadLayout layout = MERGED,
+			   std::size_t capacity = 4096);
+
+      bool isThreadAware () const;
+
+      void setSynchronous ();
+      void flush ();
+
     private:
+      /// \brief Open the journal file, if not done yet.
+      ///
+      /// Debug builds open it on construction, other builds on the
+      /// first record.
+      void open ();
+
+      void writeRecord (std::ostream& out,
+			std::string& previousFunction,
+			const Channel& channel,
+			char const* file,
+			int line,
+			char const* function,
+			boost::string_ref data);
+
       std::string filename;
       std::string lastFunction;
       std::ofstream stream;
+      ThreadedWriter* threadedWriter_;
+    };
+
+    /// \brief Logging in a binary journal file in the logging directory.
+    ///
+    /// Records are stored as a call site identifier, a timestamp and
+    /// the raw arguments; the static description of each call site is
+    /// written once. The file (journal.PID.bin) is created on first
+    /// write and can be turned into text with hpp-log-decode.
+    ///
+    /// Records only keep their arguments in binary form when emitted
+    /// by hppDout in translation units compiled with
+    /// HPP_BINARY_JOURNAL, other records are stored as text.
+    class HPP_UTIL_DLLAPI BinaryJournalOutput : public Output
+    {
+    public:
+      explicit BinaryJournalOutput (std::string filename);
+      ~BinaryJournalOutput ();
+
+      void write (const Channel& channel,
+		  char const* file,
+		  int line,
+		  char const* function,
+		  boost::string_ref data);
+
+      void writeBinary (const Channel& channel,
+			const CallSite& site,
+			const BinaryRecord& record);
+
+      void flush ();
+
+      std::string getFilename () const;
+
+    private:
+      /// \brief Identifies the origin of text records.
+      struct SiteKey
+      {
+	const Channel* channel;
+	char const* file;
+	int line;
+	char const* function;
+
+	bool operator< (const SiteKey& other) const;
+      };
+      typedef std::map<SiteKey, CallSite*> textSites_t;
+
+      void writeMessage (const Channel& channel,
+			 const CallSite& site,
+			 const char* data,
+			 std::size_t size);
+
+      std::string filename;
+      std::ofstream stream;
+      boost::mutex mutex_;
+      /// \brief Whether a site has been written, by site id.
+      std::vector<bool> defined_;
+      /// \brief Sites created for records received as text.
+      textSites_t textSites_;
     };
 
     /// \brief Logging in console (std::cerr).
@@ -164,7 +446,27 @@ namespace hpp
 		  char const* file,
 		  int line,
 		  char const* function,
-		  const std::string& data);
+		  boost::string_ref data);
+
+      /// \brief Write to std::cerr from a background thread.
+      ///
+      /// \param capacity maximum number of queued records
+      /// \param policy behavior when the queue is full
+      void setAsynchronous (std::size_t capacity = 4096,
+			    OverflowPolicy policy = BLOCK);
+
+      /// \brief Write the pending records to std::cerr.
+      void flush ();
+
+    private:
+      /// \brief Write the pending records, with mutex_ held.
+      void writePending ();
+
+      /// \brief Records not written yet (synchronous mode), as
+      /// std::cerr is not buffered.
+      std::string pending_;
+      /// \brief Guard pending_ and the flush counters.
+      boost::mutex mutex_;
     };
 
     /// \brief Logging class owns all channels and outputs.
@@ -172,14 +474,34 @@ namespace hpp
     {
     public:
       explicit Logging ();
+
+      /// \brief Log the rate limiting summary (see RateLimiter) and
+      /// drain asynchronous outputs before destruction.
       ~Logging ();
 
+      /// \brief Wait until every output has written its pending records.
+      void flush ();
+
+      /// \brief Prepare for exiting on a fatal error.
+      ///
+      /// Flush every output and dump the flight recorders.
+      void fatal ();
+
+      /// \brief Replace the text journal by the binary journal in the
+      /// subscribers of all channels (or the other way around).
+      void setBinaryJournal (bool binary);
+
       /// \brief Logs to console (i.e. stderr).
       ConsoleOutput console;
       /// \brief Logs to main journal file (i.e. journal.XXX.log).
       JournalOutput journal;
       /// \brief Logs to benchmark journal file (i.e. benchmark.XXX.log).
       JournalOutput benchmarkJournal;
+      /// \brief Logs to binary journal file (i.e. journal.XXX.bin).
+      ///
+      /// Not subscribed to any channel by default, see
+      /// setBinaryJournal.
+      BinaryJournalOutput binaryJournal;
 
       /// \brief Fatal problems channel.
       Channel error;
@@ -210,6 +532,55 @@ namespace hpp
 } // end of namespace hpp
 
 
+// Compile-time channel switches.
+//
+// Each channel is compiled in when its HPP_DEBUG_CHANNEL_<NAME> macro
+// is 1 and compiled out when it is 0. Unless defined by the user, they
+// follow HPP_DEBUG. For instance, a production build can keep errors
+// and warnings with:
+//
+//   -DHPP_DEBUG_CHANNEL_ERROR=1 -DHPP_DEBUG_CHANNEL_WARNING=1
+//
+// Disabled channels generate no code and no runtime check at all.
+# ifdef HPP_DEBUG
+#  define HPP_DEBUG_CHANNEL_DEFAULT 1
+# else
+#  define HPP_DEBUG_CHANNEL_DEFAULT 0
+# endif // HPP_DEBUG
+
+# ifndef HPP_DEBUG_CHANNEL_ERROR
+#  define HPP_DEBUG_CHANNEL_ERROR HPP_DEBUG_CHANNEL_DEFAULT
+# endif // HPP_DEBUG_CHANNEL_ERROR
+# ifndef HPP_DEBUG_CHANNEL_WARNING
+#  define HPP_DEBUG_CHANNEL_WARNING HPP_DEBUG_CHANNEL_DEFAULT
+# endif // HPP_DEBUG_CHANNEL_WARNING
+# ifndef HPP_DEBUG_CHANNEL_NOTICE
+#  define HPP_DEBUG_CHANNEL_NOTICE HPP_DEBUG_CHANNEL_DEFAULT
+# endif // HPP_DEBUG_CHANNEL_NOTICE
+# ifndef HPP_DEBUG_CHANNEL_INFO
+#  define HPP_DEBUG_CHANNEL_INFO HPP_DEBUG_CHANNEL_DEFAULT
+# endif // HPP_DEBUG_CHANNEL_INFO
+# ifndef HPP_DEBUG_CHANNEL_BENCHMARK
+#  define HPP_DEBUG_CHANNEL_BENCHMARK HPP_DEBUG_CHANNEL_DEFAULT
+# endif // HPP_DEBUG_CHANNEL_BENCHMARK
+
+// Map the channel names used in the macros to their switches.
+# define HPP_DEBUG_CHANNEL_error HPP_DEBUG_CHANNEL_ERROR
+# define HPP_DEBUG_CHANNEL_warning HPP_DEBUG_CHANNEL_WARNING
+# define HPP_DEBUG_CHANNEL_notice HPP_DEBUG_CHANNEL_NOTICE
+# define HPP_DEBUG_CHANNEL_info HPP_DEBUG_CHANNEL_INFO
+# define HPP_DEBUG_CHANNEL_benchmark HPP_DEBUG_CHANNEL_BENCHMARK
+
+// Expand to MACRO_0 or MACRO_1 according to the channel switch. The
+// extra level of indirection expands the switch before pasting.
+# define HPP_DEBUG_SELECT(macro, channel)				\
+  HPP_DEBUG_SELECT_ (macro, HPP_DEBUG_CHANNEL_##channel)
+# define HPP_DEBUG_SELECT_(macro, enabled)				\
+  HPP_DEBUG_SELECT__ (macro, enabled)
+# define HPP_DEBUG_SELECT__(macro, enabled)				\
+  macro##_##enabled
+
+
 # ifdef HPP_DEBUG
 
 #  define hppDebug(statement)			\
@@ -221,44 +592,111 @@ namespace hpp
 #  define hppDebugStatement(statement)		\
   statement
 
+# else
 
-#  define hppDout(channel, data)					\
+#  define hppDebug(statement)			\
+  do {                                          \
+  } while (0)
+#  define hppDebugStatement(statement)
+
+# endif // HPP_DEBUG
+
+
+// With HPP_BINARY_JOURNAL, arguments are kept in binary form and only
+// formatted by outputs requiring text.
+# ifdef HPP_BINARY_JOURNAL
+#  define HPP_DEBUG_DOUT_1(channel, data)				\
+  do {									\
+    using namespace hpp;						\
+    using namespace ::hpp::debug;					\
+    if (!logging.channel.isEnabled ())					\
+      break;								\
+    static const CallSite __site					\
+      (__FILE__, __LINE__, __PRETTY_FUNCTION__, #data);			\
+    BinaryRecord __record;						\
+    __record << data << inl;						\
+    logging.channel.write (__site, __record);				\
+  } while (0)
+# else
+#  define HPP_DEBUG_DOUT_1(channel, data)				\
   do {									\
     using namespace hpp;						\
     using namespace ::hpp::debug;					\
-    std::stringstream __ss;						\
-    __ss << data << iendl;						\
+    if (!logging.channel.isEnabled ())					\
+      break;								\
+    ScopedFormatStream __ss;						\
+    __ss.stream () << data << inl;					\
     logging.channel.write (__FILE__, __LINE__, __PRETTY_FUNCTION__,     \
 			   __ss.str ());				\
   } while (0)
+# endif // HPP_BINARY_JOURNAL
 
-#  define hppDoutFatal(channel, data)					\
+# define HPP_DEBUG_DOUT_0(channel, data)	\
+  do {                                          \
+  } while (0)
+
+# define HPP_DEBUG_DOUT_FATAL_1(channel, data)				\
   do {									\
     using namespace hpp;						\
     using namespace ::hpp::debug;					\
-    std::stringstream __ss;						\
-    __ss << data << iendl;						\
+    ScopedFormatStream __ss;						\
+    __ss.stream () << data << inl;					\
     logging.channel.write ( __FILE__, __LINE__,	__PRETTY_FUNCTION__,	\
 			    __ss.str ());				\
+    logging.fatal ();							\
     ::std::exit(EXIT_FAILURE);						\
   } while (1)
 
-# else
-
-#  define hppDebug(statement)			\
-  do {                                          \
-  } while (0)
-#  define hppDebugStatement(statement)
-#  define hppDout(channel, data)                \
-  do {                                          \
-  } while (0)
-#  define hppDoutFatal(channel, data)		\
+# define HPP_DEBUG_DOUT_FATAL_0(channel, data)	\
   do {						\
     using namespace hpp;			\
     ::std::cerr << data << iendl;		\
+    ::hpp::debug::logging.fatal ();		\
     ::std::exit (EXIT_FAILURE);			\
   } while (1)
 
-# endif // HPP_DEBUG
+// Log only if the per-site limiter accepts the hit, before any
+// formatting.
+# define HPP_DEBUG_DOUT_LIMITED_1(channel, test, data)			\
+  do {									\
+    using namespace ::hpp::debug;					\
+    if (!logging.channel.isEnabled ())					\
+      break;								\
+    static RateLimiter __limiter					\
+      (logging.channel, __FILE__, __LINE__, __PRETTY_FUNCTION__);	\
+    if (!__limiter.test)						\
+      break;								\
+    HPP_DEBUG_DOUT_1 (channel, data);					\
+  } while (0)
+
+# define HPP_DEBUG_DOUT_LIMITED_0(channel, test, data)	\
+  do {							\
+  } while (0)
+
+/// \brief Log \a data to \a channel (error, warning, notice, info or
+/// benchmark), if the channel is compiled in and enabled.
+# define hppDout(channel, data)					\
+  HPP_DEBUG_SELECT (HPP_DEBUG_DOUT, channel) (channel, data)
+
+/// \brief Log \a data to \a channel and exit.
+///
+/// If the channel is compiled out, \a data is printed on std::cerr.
+# define hppDoutFatal(channel, data)				\
+  HPP_DEBUG_SELECT (HPP_DEBUG_DOUT_FATAL, channel) (channel, data)
+
+/// \brief Log the 1st, (n+1)th, (2n+1)th... hits of this call site.
+# define hppDoutEveryN(channel, n, data)				\
+  HPP_DEBUG_SELECT (HPP_DEBUG_DOUT_LIMITED, channel)			\
+  (channel, everyN (n), data)
+
+/// \brief Log the first \a n hits of this call site only.
+# define hppDoutFirstN(channel, n, data)				\
+  HPP_DEBUG_SELECT (HPP_DEBUG_DOUT_LIMITED, channel)			\
+  (channel, firstN (n), data)
+
+/// \brief Log at most \a limit hits of this call site per second.
+# define hppDoutRateLimited(channel, limit, data)			\
+  HPP_DEBUG_SELECT (HPP_DEBUG_DOUT_LIMITED, channel)			\
+  (channel, perSecond (limit), data)
 
 #endif //! HPP_UTIL_DEBUG_HH
@@ -0,0 +1,84 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_EXCEPTION_TELEMETRY_HH
+# define HPP_UTIL_EXCEPTION_TELEMETRY_HH
+# include <iosfwd>
+# include <string>
+# include <vector>
+
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+
+namespace hpp
+{
+  class Exception;
+
+  namespace debug
+  {
+    /// \brief Exceptions constructed at a throw site.
+    struct HPP_UTIL_DLLAPI ExceptionSiteCount
+    {
+      std::string file;
+      unsigned line;
+      std::string type;
+      boost::uint64_t count;
+    };
+
+    typedef std::vector<ExceptionSiteCount> exceptionSiteCounts_t;
+
+    /// \brief Count of the exceptions by throw site.
+    ///
+    /// When enabled, every hpp::Exception constructed is counted in the
+    /// site of its file, line and type (see HPP_MAKE_EXCEPTION), without
+    /// locking. The first exception of a site is logged in full on the
+    /// info channel; the following ones are only summarized, at most
+    /// once per summary interval, when the site throws again, and at
+    /// exit. Logging calls logSummary on destruction.
+    ///
+    /// Enabled by default if the library is compiled with
+    /// HPP_LOG_EXCEPTION. Sites are never removed; exceptions thrown
+    /// once the capacity is reached are only counted in overflow.
+    class HPP_UTIL_DLLAPI ExceptionTelemetry
+    {
+    public:
+      static const std::size_t capacity = 256;
+
+      static void setEnabled (bool enabled);
+      static bool isEnabled ();
+
+      /// \brief Set the minimum time between two summaries of a site,
+      /// in nanoseconds (10 s by default).
+      ///
+      /// 0 logs every exception in full.
+      static void setSummaryInterval (boost::uint64_t interval);
+      static boost::uint64_t summaryInterval ();
+
+      /// \brief Count \a exception, called by its constructor.
+      static void record (const Exception& exception) throw ();
+
+      /// \brief Counts of the sites, most frequent first.
+      static exceptionSiteCounts_t sites ();
+
+      /// \brief Number of exceptions not counted in a site.
+      static boost::uint64_t overflow ();
+
+      /// \brief Print the counts of the sites, most frequent first.
+      static std::ostream& print (std::ostream& o);
+
+      /// \brief Log the exceptions thrown since the last summary of
+      /// every site.
+      static void logSummary ();
+    };
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_EXCEPTION_TELEMETRY_HH
@@ -21,9 +21,27 @@ namespace hpp
   /// \brief Main exception class for HPP.
   ///
   /// All exceptions thrown in HPP must inherit this class.
+  ///
+  /// The message is stored once, in an immutable reference-counted
+  /// buffer: copying an exception, as throwing and catching do, only
+  /// increments a counter. The file name is kept as a pointer, so it
+  /// must be static (__FILE__) unless given as a string. what () is
+  /// formatted on first call, as "file:line: message".
+  ///
+  /// When enabled (see setStackTraceEnabled), the return addresses of
+  /// the call stack are captured along with the message. They are
+  /// only symbolized when the exception is printed, and the demangled
+  /// names are cached across exceptions.
   class HPP_UTIL_DLLAPI Exception : public std::exception
   {
   public:
+    /// \brief Maximum number of frames captured.
+    static const std::size_t maxStackDepth = 32;
+
+    Exception (const std::string& message,
+	       char const* file,
+	       unsigned line) throw ();
+    /// \brief Copy \a file along with the message.
     Exception (const std::string& message,
 	       const std::string& file,
 	       unsigned line) throw ();
@@ -33,15 +51,64 @@ namespace hpp
 
     virtual const char* what () const throw ();
 
-    /// \brief Display the exception on the specified output stream.
+    char const* message () const throw ();
+    char const* file () const throw ();
+    unsigned line () const throw ();
+    /// \brief Name of the class given to HPP_MAKE_EXCEPTION,
+    /// "hpp::Exception" for other classes.
+    char const* type () const throw ();
+
+    /// \brief Number of frames captured, 0 if disabled.
+    std::size_t stackDepth () const throw ();
+
+    /// \brief Print the frames captured, one per line, without a
+    /// final newline.
+    ///
+    /// The first frames are the constructors of the classes derived
+    /// from Exception, if any, then the thrower.
+    ///
+    /// Only exported symbols are named: link executables with
+    /// -rdynamic to name their functions.
+    std::ostream& printStackTrace (std::ostream& o) const throw ();
+
+    /// \brief Capture the call stack of the exceptions constructed
+    /// from now on (disabled by default).
+    static void setStackTraceEnabled (bool enabled);
+    static bool isStackTraceEnabled ();
+
+    /// \brief Display the exception, then its call stack, on the
+    /// specified output stream.
     ///
     /// \param o output stream used for display
     /// \return output stream
     virtual std::ostream& print (std::ostream& o) const throw ();
+
+  protected:
+    /// \brief Constructors of the classes defined by
+    /// HPP_MAKE_EXCEPTION.
+    ///
+    /// \param type name of the class, which must be static
+    Exception (const std::string& message,
+	       char const* file,
+	       unsigned line,
+	       char const* type) throw ();
+    Exception (const std::string& message,
+	       const std::string& file,
+	       unsigned line,
+	       char const* type) throw ();
+
   private:
-    std::string message_;
-    std::string file_;
+    struct Message;
+
+    void initialize (const std::string& message,
+		     char const* file,
+		     std::size_t fileSize) throw ();
+
+    /// \brief Shared message, null if it could not be allocated.
+    Message* message_;
+    char const* file_;
     unsigned line_;
+    char const* type_;
   };
 
   /// \brief Override operator<< to handle exception display.
@@ -67,10 +134,15 @@ namespace hpp
   class EXTRA_QUALIFIER TYPE : public ::hpp::Exception  \
   {							\
   public:						\
+    TYPE (const std::string& message,			\
+	  char const* file,				\
+	  unsigned line) throw ()			\
+      : ::hpp::Exception (message, file, line, #TYPE)	\
+      {}						\
     TYPE (const std::string& message,			\
 	  const std::string& file,			\
 	  unsigned line) throw ()			\
-      : ::hpp::Exception (message, file, line)		\
+      : ::hpp::Exception (message, file, line, #TYPE)	\
       {}						\
   }
 
@@ -79,10 +151,15 @@ namespace hpp
   class TYPE : public ::hpp::Exception			\
   {							\
   public:						\
+    TYPE (const std::string& message,			\
+	  char const* file,				\
+	  unsigned line) throw ()			\
+      : ::hpp::Exception (message, file, line, #TYPE)	\
+      {}						\
     TYPE (const std::string& message,			\
 	  const std::string& file,			\
 	  unsigned line) throw ()			\
-      : ::hpp::Exception (message, file, line)		\
+      : ::hpp::Exception (message, file, line, #TYPE)	\
       {}						\
   }
 
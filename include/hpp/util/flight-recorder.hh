@@ -0,0 +1,86 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_FLIGHT_RECORDER_HH
+# define HPP_UTIL_FLIGHT_RECORDER_HH
+# include <cstddef>
+# include <string>
+# include <vector>
+
+# include <boost/atomic.hpp>
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+# include <hpp/util/debug.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Keep the last records in memory, write them on crash.
+    ///
+    /// Records are copied into a fixed in-memory ring and nothing is
+    /// written to disk during normal operation. The ring is dumped to
+    /// FILENAME.PID.log in the logging directory:
+    /// \li by hppDoutFatal (see Logging::fatal),
+    /// \li when the program terminates on an uncaught exception, the
+    /// hpp::Exception being recorded first,
+    /// \li on SIGSEGV and SIGABRT, from an async-signal-safe handler.
+    ///
+    /// The handlers are installed when the first recorder is created
+    /// and chain to the previous ones. At most 16 recorders living at
+    /// the same time are dumped automatically: the ones created while
+    /// 16 others exist are only written by an explicit call to dump.
+    ///
+    /// Writers never lock: a record being written while the ring is
+    /// dumped, or overwritten by a writer lapping it, may be torn.
+    class HPP_UTIL_DLLAPI FlightRecorderOutput : public Output
+    {
+    public:
+      /// \param filename base name of the dump file
+      /// \param capacity size of the ring in bytes
+      explicit FlightRecorderOutput (std::string filename = "flight-recorder",
+				     std::size_t capacity = 64 << 10);
+      ~FlightRecorderOutput ();
+
+      void write (const Channel& channel,
+		  char const* file,
+		  int line,
+		  char const* function,
+		  boost::string_ref data);
+
+      /// \brief Copy raw text into the ring.
+      void append (const char* data, std::size_t size);
+
+      /// \brief Write the content of the ring to the dump file.
+      ///
+      /// Async-signal-safe: only uses open, write and close on a path
+      /// computed at construction.
+      ///
+      /// \return false if the file could not be written
+      bool dump () const;
+
+      /// \brief Dump every living recorder (async-signal-safe).
+      static void dumpAll ();
+
+      std::string getFilename () const;
+
+    private:
+      std::string filename;
+      /// \brief Dump file path, computed once for signal handlers.
+      std::string path_;
+      std::vector<char> buffer_;
+      /// \brief Total number of bytes ever appended.
+      boost::atomic<boost::uint64_t> head_;
+    };
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_FLIGHT_RECORDER_HH
@@ -0,0 +1,111 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_FORMAT_BUFFER_HH
+# define HPP_UTIL_FORMAT_BUFFER_HH
+# include <cstddef>
+# include <ostream>
+# include <streambuf>
+# include <vector>
+
+# include <boost/utility/string_ref.hpp>
+
+# include <hpp/util/config.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Stream buffer writing into a growable array.
+    ///
+    /// Unlike std::stringbuf, the content is read in place and the
+    /// storage is kept when the buffer is cleared, so that a reused
+    /// buffer stops allocating once it has reached its working size.
+    class HPP_UTIL_DLLAPI FormatBuffer : public std::streambuf
+    {
+    public:
+      explicit FormatBuffer (std::size_t capacity = 256);
+
+      /// \brief Content written since the last clear.
+      ///
+      /// Only valid until the next write or clear.
+      boost::string_ref str () const
+      {
+	return boost::string_ref (pbase (), (std::size_t) (pptr () - pbase ()));
+      }
+
+      /// \brief Forget the content, keep the storage.
+      void clear ();
+
+    protected:
+      int_type overflow (int_type c);
+      std::streamsize xsputn (const char* s, std::streamsize n);
+
+    private:
+      /// \brief Make room for at least \a size more characters.
+      void reserve (std::size_t size);
+
+      std::vector<char> buffer_;
+    };
+
+    /// \brief Output stream writing into a FormatBuffer.
+    class HPP_UTIL_DLLAPI FormatStream : public std::ostream
+    {
+    public:
+      FormatStream ();
+
+      boost::string_ref str () const
+      {
+	return buffer_.str ();
+      }
+
+      /// \brief Restore the state of a newly created stream: empty,
+      /// default flags, precision, fill and indentation.
+      void reset ();
+
+    private:
+      FormatBuffer buffer_;
+    };
+
+    /// \brief Borrow a formatting stream owned by the calling thread.
+    ///
+    /// Used by the logging macros in place of a fresh std::stringstream:
+    /// each thread keeps a stack of streams, reused from one record to
+    /// the next, so that formatting a record neither allocates nor
+    /// constructs a stream in steady state. Nested borrows (a value
+    /// whose operator<< logs itself) get distinct streams.
+    ///
+    /// The stream is reset when borrowed.
+    class HPP_UTIL_DLLAPI ScopedFormatStream
+    {
+    public:
+      ScopedFormatStream ();
+      ~ScopedFormatStream ();
+
+      std::ostream& stream ()
+      {
+	return stream_;
+      }
+
+      boost::string_ref str () const
+      {
+	return stream_.str ();
+      }
+
+    private:
+      ScopedFormatStream (const ScopedFormatStream&);
+      ScopedFormatStream& operator= (const ScopedFormatStream&);
+
+      FormatStream& stream_;
+    };
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_FORMAT_BUFFER_HH
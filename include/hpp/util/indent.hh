@@ -39,6 +39,17 @@ namespace hpp
   /// and set the indentation.
   HPP_UTIL_DLLAPI std::ostream& decendl (std::ostream& o);
 
+  /// \brief Print a newline without flushing, then set the indentation.
+  HPP_UTIL_DLLAPI std::ostream& inl (std::ostream& o);
+
+  /// \brief Increment the indentation, print a newline without
+  /// flushing, and set the indentation.
+  HPP_UTIL_DLLAPI std::ostream& incnl (std::ostream& o);
+
+  /// \brief Decrement the indentation, print a newline without
+  /// flushing, and set the indentation.
+  HPP_UTIL_DLLAPI std::ostream& decnl (std::ostream& o);
+
 } // end of namespace hpp.
 
 #endif // !HPP_UTIL_INDENT_HH
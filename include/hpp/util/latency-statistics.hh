@@ -0,0 +1,113 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_LATENCY_STATISTICS_HH
+# define HPP_UTIL_LATENCY_STATISTICS_HH
+# include <cstddef>
+# include <iosfwd>
+# include <string>
+
+# include <boost/atomic.hpp>
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Streaming statistics of the durations of a benchmark.
+    ///
+    /// Keeps the count, minimum, maximum, mean and standard deviation
+    /// of the samples, and a log-linear (HDR) histogram for the
+    /// percentiles: values are split in powers of two, each divided in
+    /// 2^subBucketBits buckets, so that percentiles are exact to 1/32
+    /// over the whole 64 bit range. Memory is constant and record is
+    /// lock-free.
+    ///
+    /// Statistics are named after the benchmark ID; they are never
+    /// destroyed, so that Logging reports them on destruction.
+    class HPP_UTIL_DLLAPI LatencyStatistics
+    {
+    public:
+      static const std::size_t subBucketBits = 5;
+      static const std::size_t bucketCount =
+	(64 - subBucketBits + 1) << subBucketBits;
+
+      /// \brief Statistics of benchmark \a name, created on first use.
+      ///
+      /// Looking up takes a lock: call sites should keep the result.
+      static LatencyStatistics& get (const std::string& name);
+
+      /// \brief Add a duration in nanoseconds.
+      ///
+      /// If a report interval is set, the first sample recorded after
+      /// each interval logs the statistics.
+      void record (boost::uint64_t duration);
+
+      const std::string& name () const;
+
+      boost::uint64_t count () const;
+      boost::uint64_t min () const;
+      boost::uint64_t max () const;
+      double mean () const;
+      double standardDeviation () const;
+
+      /// \brief Smallest recorded duration not exceeded by a fraction
+      /// \a q of the samples (e.g. 0.99), up to the bucket precision.
+      boost::uint64_t percentile (double q) const;
+
+      /// \brief Forget the samples recorded so far.
+      ///
+      /// Samples recorded concurrently may be partially kept.
+      void reset ();
+
+      std::ostream& print (std::ostream& o) const;
+
+      /// \brief Log the statistics to the benchmark channel.
+      void log () const;
+
+      /// \brief Log the statistics of every benchmark with samples.
+      static void logAll ();
+
+      /// \brief Log statistics every \a interval nanoseconds while
+      /// samples are recorded (0, the default, disables it).
+      static void setReportInterval (boost::uint64_t interval);
+      static boost::uint64_t reportInterval ();
+
+    private:
+      explicit LatencyStatistics (const std::string& name);
+      LatencyStatistics (const LatencyStatistics&);
+      LatencyStatistics& operator= (const LatencyStatistics&);
+
+      static std::size_t bucketIndex (boost::uint64_t value);
+      /// \brief Smallest value of bucket \a index.
+      static boost::uint64_t bucketStart (std::size_t index);
+
+      std::string name_;
+      boost::atomic<boost::uint64_t> count_;
+      boost::atomic<boost::uint64_t> sum_;
+      boost::atomic<double> sumOfSquares_;
+      boost::atomic<boost::uint64_t> min_;
+      boost::atomic<boost::uint64_t> max_;
+      boost::atomic<boost::uint64_t> buckets_[bucketCount];
+      /// \brief Steady time of the next periodic report.
+      boost::atomic<boost::uint64_t> nextReport_;
+
+      /// \brief Next registered statistics.
+      LatencyStatistics* next_;
+    };
+
+    HPP_UTIL_DLLAPI std::ostream&
+    operator<< (std::ostream& o, const LatencyStatistics& statistics);
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_LATENCY_STATISTICS_HH
@@ -0,0 +1,122 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_MAPPED_JOURNAL_HH
+# define HPP_UTIL_MAPPED_JOURNAL_HH
+# include <cstddef>
+# include <deque>
+# include <string>
+# include <vector>
+
+# include <boost/atomic.hpp>
+# include <boost/thread/condition_variable.hpp>
+# include <boost/thread/mutex.hpp>
+# include <boost/thread/thread.hpp>
+
+# include <hpp/util/config.hh>
+# include <hpp/util/debug.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Logging in memory-mapped, size-capped journal files.
+    ///
+    /// Records are copied into preallocated segments of a fixed size
+    /// mapped in memory (FILENAME.PID.N.log in the logging directory).
+    /// Writers reserve their space with an atomic increment and never
+    /// take a lock; when a segment is full, the writer crossing its end
+    /// switches to a standby segment prepared in advance by a
+    /// background thread. The same thread closes full segments and
+    /// removes the oldest ones so that at most \a maxSegments files
+    /// are kept.
+    ///
+    /// Records are written as by ConsoleOutput, without entering and
+    /// exiting lines, so that concurrent writers share no state.
+    ///
+    /// Only available on POSIX systems; elsewhere, every record is
+    /// dropped.
+    class HPP_UTIL_DLLAPI MappedJournalOutput : public Output
+    {
+    public:
+      /// \param filename base name of the segment files
+      /// \param segmentSize size of a segment in bytes
+      /// \param maxSegments number of segment files kept on disk
+      explicit MappedJournalOutput (std::string filename,
+				    std::size_t segmentSize = 64 << 20,
+				    std::size_t maxSegments = 8);
+      ~MappedJournalOutput ();
+
+      /// \brief Copy the record in the current segment.
+      ///
+      /// Records longer than a segment are cut to the segment size,
+      /// see truncatedRecords.
+      void write (const Channel& channel,
+		  char const* file,
+		  int line,
+		  char const* function,
+		  boost::string_ref data);
+
+      /// \brief Schedule the write back of the current segment.
+      void flush ();
+
+      /// \brief Number of records discarded because no segment was
+      /// available.
+      unsigned long long droppedRecords () const;
+
+      /// \brief Number of records cut because they were longer than a
+      /// segment.
+      unsigned long long truncatedRecords () const;
+
+      /// \brief Name of the segment file of rank \a index.
+      std::string getFilename (std::size_t index) const;
+
+    private:
+      struct Segment;
+
+      void run ();
+      /// \brief Copy \a size bytes in the current segment.
+      void append (const char* data, std::size_t size);
+      /// \brief Replace the full segment \a segment by the standby one.
+      void rotate (Segment* segment);
+      Segment* createSegment ();
+      void closeSegment (Segment* segment);
+
+      std::string filename;
+      std::size_t segmentSize_;
+      std::size_t maxSegments_;
+      std::size_t nextIndex_;
+
+      boost::atomic<Segment*> current_;
+      boost::atomic<Segment*> standby_;
+      boost::atomic<unsigned long long> dropped_;
+      boost::atomic<unsigned long long> truncated_;
+      boost::atomic<bool> stopping_;
+      /// \brief Set when no new segment could be created.
+      boost::atomic<bool> failed_;
+
+      boost::mutex mutex_;
+      boost::condition_variable wakeUpCondition_;
+      /// \brief Full segments waiting to be closed (mutex_).
+      std::vector<Segment*> retired_;
+      /// \brief Closed segments, available for reuse (helper thread).
+      std::vector<Segment*> free_;
+      /// \brief All allocated segments: they are only freed on
+      /// destruction, so that writers can safely hold stale pointers.
+      std::vector<Segment*> segments_;
+      /// \brief Segment files on disk, oldest first (helper thread).
+      std::deque<std::string> files_;
+
+      boost::thread thread_;
+    };
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_MAPPED_JOURNAL_HH
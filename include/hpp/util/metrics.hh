@@ -0,0 +1,225 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_METRICS_HH
+# define HPP_UTIL_METRICS_HH
+# include <string>
+
+# include <boost/atomic.hpp>
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+
+/// \brief First bytes of a metrics segment.
+# define HPP_UTIL_METRICS_MAGIC "HPPMETR"
+
+namespace hpp
+{
+  namespace debug
+  {
+    enum MetricType
+      {
+	METRIC_NONE,
+	/// \brief Monotonic count, shown as a rate by hpp-util-top.
+	METRIC_COUNTER,
+	/// \brief Current value, such as a queue depth.
+	METRIC_GAUGE,
+	/// \brief Distribution of values in power of two buckets.
+	METRIC_HISTOGRAM
+      };
+
+    /// \brief Header of a metrics segment.
+    ///
+    /// The segment is the header followed by capacity slots; the
+    /// layout only changes with version. Slots below size are
+    /// published: their name and type do not change anymore.
+    struct MetricsHeader
+    {
+      static const boost::uint32_t version = 1;
+
+      char magic[8];
+      boost::uint32_t layoutVersion;
+      boost::uint32_t capacity;
+      boost::uint32_t slotSize;
+      boost::uint32_t pid;
+      boost::atomic<boost::uint32_t> size;
+      char padding[36];
+    };
+
+    /// \brief A metric in a segment, updated without locking.
+    struct MetricSlot
+    {
+      static const std::size_t nameSize = 64;
+      /// \brief Bucket 0 counts the zero values, bucket i > 0 the
+      /// values in [2^(i-1), 2^i), the last one the values above.
+      static const std::size_t bucketCount = 64;
+
+      /// \brief Index of the bucket of \a value.
+      static std::size_t bucket (boost::uint64_t value)
+      {
+	if (!value)
+	  return 0;
+# ifdef __GNUC__
+	std::size_t i = 64 - (std::size_t) __builtin_clzll (value);
+# else
+	std::size_t i = 0;
+	for (; value; value >>= 1)
+	  ++i;
+# endif // __GNUC__
+	return i < bucketCount ? i : bucketCount - 1;
+      }
+
+      /// \brief Null terminated, possibly truncated, name.
+      char name[nameSize];
+      boost::uint32_t type;
+      boost::uint32_t reserved;
+      /// \brief Count of a counter, value of a gauge, sum of the
+      /// values of a histogram.
+      boost::atomic<boost::int64_t> value;
+      /// \brief Number of values of a histogram.
+      boost::atomic<boost::uint64_t> count;
+      boost::atomic<boost::uint64_t> buckets[bucketCount];
+      char padding[40];
+    };
+
+    /// \brief Monotonic counter, see Metrics.
+    class HPP_UTIL_DLLAPI Counter
+    {
+    public:
+      /// \brief Counter not published in the registry.
+      Counter ();
+
+      void add (boost::uint64_t n = 1)
+      {
+	slot_->value.fetch_add ((boost::int64_t) n,
+				boost::memory_order_relaxed);
+      }
+
+      boost::uint64_t value () const;
+
+    private:
+      friend class Metrics;
+      explicit Counter (MetricSlot* slot);
+
+      MetricSlot* slot_;
+    };
+
+    /// \brief Current value, see Metrics.
+    class HPP_UTIL_DLLAPI Gauge
+    {
+    public:
+      /// \brief Gauge not published in the registry.
+      Gauge ();
+
+      void set (boost::int64_t value)
+      {
+	slot_->value.store (value, boost::memory_order_relaxed);
+      }
+
+      void add (boost::int64_t delta)
+      {
+	slot_->value.fetch_add (delta, boost::memory_order_relaxed);
+      }
+
+      boost::int64_t value () const;
+
+    private:
+      friend class Metrics;
+      explicit Gauge (MetricSlot* slot);
+
+      MetricSlot* slot_;
+    };
+
+    /// \brief Distribution of values, see Metrics.
+    class HPP_UTIL_DLLAPI Histogram
+    {
+    public:
+      /// \brief Histogram not published in the registry.
+      Histogram ();
+
+      void record (boost::uint64_t value)
+      {
+	slot_->buckets[MetricSlot::bucket (value)]
+	  .fetch_add (1, boost::memory_order_relaxed);
+	slot_->value.fetch_add ((boost::int64_t) value,
+				boost::memory_order_relaxed);
+	slot_->count.fetch_add (1, boost::memory_order_relaxed);
+      }
+
+      boost::uint64_t count () const;
+      boost::uint64_t sum () const;
+
+    private:
+      friend class Metrics;
+      explicit Histogram (MetricSlot* slot);
+
+      MetricSlot* slot_;
+    };
+
+    /// \brief Registry of live metrics, readable by other processes.
+    ///
+    /// Metrics are published in the POSIX shared memory segment
+    /// segmentName (pid), created on first registration and removed
+    /// at exit, so that hpp-util-top can show them while the process
+    /// runs, without going through the logging outputs. Updates are
+    /// relaxed atomic operations on the segment.
+    ///
+    /// Without shared memory, metrics are kept in the process memory.
+    /// When the registry is full, or a name is registered with another
+    /// type, a warning is logged and the metric returned is not
+    /// published. An unpublished metric, as a default constructed one,
+    /// has its own slot, kept until exit: do not create them in loops.
+    class HPP_UTIL_DLLAPI Metrics
+    {
+    public:
+      static const std::size_t capacity = 256;
+
+      /// \brief Metric \a name, created on first use.
+      ///
+      /// Looking up takes a lock: call sites should keep the result.
+      static Counter counter (const std::string& name);
+      static Gauge gauge (const std::string& name);
+      static Histogram histogram (const std::string& name);
+
+      /// \brief Name of the segment of process \a pid.
+      static std::string segmentName (int pid);
+
+      /// \brief Whether the metrics of this process are published in
+      /// shared memory.
+      static bool isShared ();
+    };
+
+    /// \brief Read-only view of the metrics segment of a process.
+    class HPP_UTIL_DLLAPI MetricsView
+    {
+    public:
+      /// \brief Attach to the segment of process \a pid.
+      explicit MetricsView (int pid);
+      ~MetricsView ();
+
+      /// \brief Whether the segment was found with a supported layout.
+      bool isAttached () const;
+
+      /// \brief Number of published slots.
+      std::size_t size () const;
+
+      const MetricSlot& slot (std::size_t i) const;
+
+    private:
+      MetricsView (const MetricsView&);
+      MetricsView& operator= (const MetricsView&);
+
+      const MetricsHeader* header_;
+      std::size_t mappedSize_;
+    };
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_METRICS_HH
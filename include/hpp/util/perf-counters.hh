@@ -0,0 +1,91 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_PERF_COUNTERS_HH
+# define HPP_UTIL_PERF_COUNTERS_HH
+# include <iosfwd>
+
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Values of the hardware performance counters of the
+    /// calling thread.
+    ///
+    /// Counters are read with Linux perf_event_open, user space only,
+    /// as a single group opened by each thread on its first read. Each
+    /// event is optional: events the processor, the kernel or its
+    /// perf_event_paranoid setting do not permit are simply not valid,
+    /// and no event is valid on other systems. Values are scaled when
+    /// the kernel multiplexes the counters.
+    ///
+    /// Reading is disabled by default (see setEnabled), so that timers
+    /// do not pay for the read system call unless asked to.
+    class HPP_UTIL_DLLAPI PerfCounters
+    {
+    public:
+      enum Event
+	{
+	  CYCLES,
+	  INSTRUCTIONS,
+	  /// \brief Level 1 data cache read misses.
+	  L1D_MISSES,
+	  /// \brief Last level cache misses.
+	  LLC_MISSES,
+	  BRANCH_MISSES,
+	  EVENT_COUNT
+	};
+
+      /// \brief No valid event.
+      PerfCounters ();
+
+      /// \brief Current values for the calling thread.
+      ///
+      /// No event is valid when reading is disabled.
+      static PerfCounters read ();
+
+      /// \brief Enable or disable reading the counters.
+      static void setEnabled (bool enabled);
+      static bool isEnabled ();
+
+      static char const* name (Event event);
+
+      bool isValid (Event event) const;
+      boost::uint64_t value (Event event) const;
+
+      /// \brief Whether no event is valid.
+      bool empty () const;
+
+      /// \brief Instructions per cycle, 0 if not available.
+      double instructionsPerCycle () const;
+
+      /// \brief Counts between \a start and this value, valid for the
+      /// events valid in both.
+      PerfCounters operator- (const PerfCounters& start) const;
+
+      /// \brief Print the valid events, nothing if empty.
+      std::ostream& print (std::ostream& o) const;
+
+    private:
+      boost::uint64_t values_[EVENT_COUNT];
+      /// \brief Bit mask of the valid events.
+      unsigned int valid_;
+    };
+
+    HPP_UTIL_DLLAPI std::ostream&
+    operator<< (std::ostream& o, const PerfCounters& counters);
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_PERF_COUNTERS_HH
@@ -39,4 +39,27 @@
 #   define HPP_DLLLOCAL
 #  endif // __GNUC__ >= 4
 # endif // defined _WIN32 || defined __CYGWIN__
+
+// Branch prediction hints and attributes of the cold paths, such as
+// the failure of an assertion.
+# ifdef __GNUC__
+#  define HPP_LIKELY(CONDITION) __builtin_expect (!!(CONDITION), 1)
+#  define HPP_UNLIKELY(CONDITION) __builtin_expect (!!(CONDITION), 0)
+#  define HPP_NORETURN __attribute__ ((noreturn))
+#  if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3)
+#   define HPP_COLD __attribute__ ((cold, noinline))
+#  else
+#   define HPP_COLD __attribute__ ((noinline))
+#  endif // __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3)
+# elif defined _MSC_VER
+#  define HPP_LIKELY(CONDITION) (CONDITION)
+#  define HPP_UNLIKELY(CONDITION) (CONDITION)
+#  define HPP_NORETURN __declspec(noreturn)
+#  define HPP_COLD __declspec(noinline)
+# else
+#  define HPP_LIKELY(CONDITION) (CONDITION)
+#  define HPP_UNLIKELY(CONDITION) (CONDITION)
+#  define HPP_NORETURN
+#  define HPP_COLD
+# endif // __GNUC__
 #endif //! HPP_PORTABILITY_HH
@@ -0,0 +1,114 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_PROFILER_HH
+# define HPP_UTIL_PROFILER_HH
+# include <iosfwd>
+
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    struct ProfileNode;
+
+    /// \brief Receive the regions entered and left by ProfileScope.
+    ///
+    /// Observers are called by the thread entering or leaving the
+    /// region, with the steady clock time (see steadyNow) read by the
+    /// scope, so they must be thread-safe. An observer must be
+    /// registered (Profiler::addObserver) before, and removed after,
+    /// the regions it observes.
+    class HPP_UTIL_DLLAPI RegionObserver
+    {
+    public:
+      virtual ~RegionObserver ();
+
+      virtual void regionBegin (char const* name, boost::uint64_t time) = 0;
+      virtual void regionEnd (char const* name,
+			      boost::uint64_t time,
+			      boost::uint64_t duration) = 0;
+    };
+
+    /// \brief Region of code timed by the profiler, from construction
+    /// to destruction (or stop).
+    ///
+    /// Regions entered while another one is active on the same thread
+    /// become its children: each thread builds a call tree whose nodes
+    /// count the calls and the inclusive time of a region in a given
+    /// context. Regions left out of order are removed from the active
+    /// regions without closing the others; regions entered past 64
+    /// active ones are not timed.
+    ///
+    /// Entering and leaving a region do not lock: the tree of a thread
+    /// is only modified by this thread.
+    class HPP_UTIL_DLLAPI ProfileScope
+    {
+    public:
+      /// \param name region name, which must outlive the program
+      /// (typically a string literal)
+      explicit ProfileScope (char const* name);
+      ~ProfileScope ();
+
+      /// \brief Leave the region before destruction.
+      void stop ();
+
+    private:
+      ProfileScope (const ProfileScope&);
+      ProfileScope& operator= (const ProfileScope&);
+
+      ProfileNode* node_;
+      boost::uint64_t start_;
+    };
+
+    /// \brief Report of the regions timed by ProfileScope.
+    ///
+    /// The trees of all the threads, including finished ones, are
+    /// merged by region path. For each region, the report gives the
+    /// number of calls, the inclusive time, the exclusive time (not
+    /// spent in child regions) and the share of the total time.
+    /// Regions still active are not counted.
+    class HPP_UTIL_DLLAPI Profiler
+    {
+    public:
+      /// \brief Print the report.
+      static void print (std::ostream& o);
+
+      /// \brief Log the report to the benchmark channel, if any region
+      /// was timed.
+      ///
+      /// Logging calls it on destruction, unless disabled with
+      /// setReportAtExit.
+      static void logReport ();
+
+      /// \brief Forget the times and counts measured so far.
+      ///
+      /// Regions left concurrently may be partially kept.
+      static void reset ();
+
+      static void setReportAtExit (bool report);
+      static bool reportAtExit ();
+
+      /// \brief Notify \a observer of the regions entered and left.
+      ///
+      /// At most 16 observers can be registered.
+      ///
+      /// \return false if there is no room left
+      static bool addObserver (RegionObserver* observer);
+
+      static void removeObserver (RegionObserver* observer);
+    };
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_PROFILER_HH
@@ -0,0 +1,97 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_RATE_LIMITER_HH
+# define HPP_UTIL_RATE_LIMITER_HH
+# include <boost/atomic.hpp>
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    class Channel;
+
+    /// \brief Per-call-site state of the rate-limited logging macros.
+    ///
+    /// Decides whether a hit of the call site is logged, before any
+    /// formatting: a suppressed hit costs an atomic increment and a
+    /// comparison (plus a clock read for perSecond).
+    ///
+    /// Limiters are static objects of the call sites; they register
+    /// themselves so that logSummary can report, on each site
+    /// channel, how many records were suppressed. Logging calls it on
+    /// destruction; limiters are trivially destructible so that they
+    /// are still valid at that time.
+    class HPP_UTIL_DLLAPI RateLimiter
+    {
+    public:
+      RateLimiter (Channel& channel,
+		   char const* file,
+		   int line,
+		   char const* function);
+
+      /// \brief Accept the 1st, (n+1)th, (2n+1)th... hits.
+      bool everyN (boost::uint64_t n)
+      {
+	return accept (hits_.fetch_add (1, boost::memory_order_relaxed)
+		       % (n ? n : 1) == 0);
+      }
+
+      /// \brief Accept the first \a n hits only.
+      bool firstN (boost::uint64_t n)
+      {
+	return accept (hits_.fetch_add (1, boost::memory_order_relaxed) < n);
+      }
+
+      /// \brief Accept at most \a limit hits per second.
+      bool perSecond (boost::uint64_t limit);
+
+      boost::uint64_t hits () const;
+      boost::uint64_t suppressed () const;
+
+      /// \brief Log the suppressed counts of every call site which
+      /// suppressed records since the last summary.
+      static void logSummary ();
+
+    private:
+      RateLimiter (const RateLimiter&);
+      RateLimiter& operator= (const RateLimiter&);
+
+      bool accept (bool accepted)
+      {
+	if (accepted)
+	  accepted_.fetch_add (1, boost::memory_order_relaxed);
+	return accepted;
+      }
+
+      Channel& channel_;
+      char const* file_;
+      int line_;
+      char const* function_;
+
+      boost::atomic<boost::uint64_t> hits_;
+      boost::atomic<boost::uint64_t> accepted_;
+      /// \brief Suppressed count at the last summary.
+      boost::uint64_t reported_;
+
+      /// \brief Current one second window (perSecond).
+      boost::atomic<boost::uint64_t> window_;
+      boost::atomic<boost::uint64_t> windowHits_;
+
+      /// \brief Next registered limiter.
+      RateLimiter* next_;
+    };
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_RATE_LIMITER_HH
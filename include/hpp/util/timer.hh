@@ -13,18 +13,32 @@
 # define HPP_UTIL_TIMER_HH
 
 # include "boost/date_time/posix_time/posix_time_types.hpp"
+# include <boost/cstdint.hpp>
 
 # ifdef HPP_ENABLE_BENCHMARK
 #  include <boost/date_time/posix_time/posix_time.hpp>
 # endif // HPP_ENABLE_BENCHMARK
 
+# include <hpp/util/clock.hh>
 # include <hpp/util/config.hh>
 # include <hpp/util/debug.hh>
+# include <hpp/util/latency-statistics.hh>
+# include <hpp/util/perf-counters.hh>
+# include <hpp/util/profiler.hh>
+# include <hpp/util/watchdog.hh>
 
 namespace hpp
 {
   namespace debug
   {
+    /// \brief Measure elapsed time.
+    ///
+    /// Timers read one of the clocks of hpp/util/clock.hh (the steady
+    /// clock by default) and keep integer nanoseconds; the
+    /// boost::posix_time accessors are derived from them.
+    ///
+    /// When PerfCounters reading is enabled, timers also read the
+    /// hardware counters of their thread at start and stop.
     class HPP_UTIL_DLLAPI Timer
     {
     public:
@@ -33,6 +47,7 @@ namespace hpp
       typedef boost::posix_time::time_period time_period;
 
       explicit Timer (bool autoStart = false);
+      explicit Timer (ClockSource source, bool autoStart = false);
       Timer (const Timer&);
       Timer& operator= (const Timer&);
       ~Timer ();
@@ -41,34 +56,113 @@ namespace hpp
       const ptime& stop ();
       time_duration duration () const;
 
+      /// \brief Start and stop times, as wall-clock time.
+      ///
+      /// Not a date time for the thread CPU clock.
       const ptime& getStart () const;
       const ptime& getStop () const;
 
+      /// \brief Start time in nanoseconds, on the timer clock scale.
+      boost::uint64_t getStartNs () const;
+      /// \brief Stop time in nanoseconds, on the timer clock scale.
+      boost::uint64_t getStopNs () const;
+      /// \brief Elapsed time in nanoseconds.
+      ///
+      /// When overhead compensation is enabled, the cost of reading
+      /// the clock and of the timers started and stopped by the same
+      /// thread during the measurement is subtracted.
+      boost::uint64_t durationNs () const;
+
+      ClockSource clockSource () const;
+
+      /// \brief Hardware counter counts between start and stop.
+      ///
+      /// Empty if counters were not read (see PerfCounters).
+      PerfCounters counters () const;
+
       std::ostream& print (std::ostream&) const;
+
+      /// \brief Cost of a start/stop pair seen by an enclosing timer,
+      /// in nanoseconds.
+      ///
+      /// Measured by the library the first time it is needed.
+      static boost::uint64_t overhead (ClockSource source);
+
+      /// \brief Enable or disable overhead compensation (disabled by
+      /// default).
+      ///
+      /// Enabling it measures the overhead of every clock: do it
+      /// before, not during, measurements.
+      static void setOverheadCompensation (bool compensate);
+
+      static bool overheadCompensation ();
+
     private:
+      ClockSource source_;
+      boost::uint64_t startNs_;
+      boost::uint64_t stopNs_;
+      /// \brief Timers stopped by this thread, at start and stop.
+      boost::uint64_t nestedAtStart_;
+      boost::uint64_t nestedAtStop_;
       ptime start_;
       ptime end_;
+      PerfCounters countersAtStart_;
+      PerfCounters countersAtStop_;
     };
 
 # ifdef HPP_ENABLE_BENCHMARK
 
-#  define hppStartBenchmark(ID)			\
-    hppDout (benchmark, #ID << ": start");	\
+/// \brief Start timer ID, also a region of the profiler call tree.
+///
+/// Samples are not logged one by one: see
+/// hppDisplayBenchmarkStatistics for their aggregates.
+#  define hppStartBenchmark(ID)				\
+    ::hpp::debug::ProfileScope _##ID##_profile_ (#ID);	\
     ::hpp::debug::Timer _##ID##_timer_ (true)
 
-#  define hppStopBenchmark(ID)			\
-    do {					\
-      _##ID##_timer_.stop ();			\
-      hppDout (benchmark, #ID << ": stop");	\
+/// \brief Stop timer ID and add its duration to the ID statistics.
+#  define hppStopBenchmark(ID)					\
+    do {							\
+      _##ID##_timer_.stop ();					\
+      _##ID##_profile_.stop ();					\
+      static ::hpp::debug::LatencyStatistics& _statistics_ =	\
+	::hpp::debug::LatencyStatistics::get (#ID);		\
+      _statistics_.record (_##ID##_timer_.durationNs ());	\
     } while (0)
 
 #  define hppDisplayBenchmark(ID)					\
-    hppDout (benchmark, #ID << ": "<< _##ID##_timer_.duration ());
+    hppDout (benchmark, #ID << ": "<< _##ID##_timer_.duration ()	\
+	     << (_##ID##_timer_.counters ().empty () ? "" : ", ")	\
+	     << _##ID##_timer_.counters ());
+
+/// \brief Log the statistics of the durations of benchmark ID.
+#  define hppDisplayBenchmarkStatistics(ID)		\
+    ::hpp::debug::LatencyStatistics::get (#ID).log ()
+
+/// \brief Time the rest of the enclosing scope as profiler region ID.
+#  define hppProfileScope(ID)					\
+    ::hpp::debug::ProfileScope _##ID##_profile_ (#ID)
+
+/// \brief Time the rest of the enclosing scope as profiler region ID,
+/// reported by the watchdog if it exceeds BUDGET nanoseconds.
+#  define hppDeadlineScope(ID, BUDGET)					\
+    static ::hpp::debug::Deadline _##ID##_deadline_			\
+      (#ID, BUDGET, __FILE__, __LINE__);				\
+    ::hpp::debug::ProfileScope _##ID##_profile_ (#ID);			\
+    ::hpp::debug::DeadlineScope _##ID##_deadline_scope_ (_##ID##_deadline_)
+
+/// \brief Log the profiler report to the benchmark channel.
+#  define hppDisplayProfile()			\
+    ::hpp::debug::Profiler::logReport ()
 
 # else
 #  define hppStartBenchmark(ID)
 #  define hppStopBenchmark(ID)
 #  define hppDisplayBenchmark(ID)
+#  define hppDisplayBenchmarkStatistics(ID)
+#  define hppProfileScope(ID)
+#  define hppDeadlineScope(ID, BUDGET)
+#  define hppDisplayProfile()
 # endif // HPP_ENABLE_BENCHMARK
 
   } // end of namespace debug
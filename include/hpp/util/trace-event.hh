@@ -0,0 +1,84 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_TRACE_EVENT_HH
+# define HPP_UTIL_TRACE_EVENT_HH
+# include <cstddef>
+# include <fstream>
+# include <string>
+
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+# include <hpp/util/debug.hh>
+# include <hpp/util/profiler.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Write regions and records as Chrome trace events.
+    ///
+    /// The output registers itself as a profiler RegionObserver: each
+    /// region entered and left (hppStartBenchmark, hppProfileScope...)
+    /// becomes a begin and an end event, with the thread identifier
+    /// and the steady clock timestamp, in FILENAME.PID.json in the
+    /// logging directory. Records of the channels the output is
+    /// subscribed to (typically benchmark) become instant events.
+    ///
+    /// Events are queued and written in batches by a background
+    /// thread, as a JSON array closed on destruction. The file can be
+    /// opened in Perfetto or chrome://tracing, which also accept the
+    /// unterminated array left by a crash. Events are only written in
+    /// asynchronous mode: setSynchronous ends the trace.
+    class HPP_UTIL_DLLAPI TraceEventOutput : public Output,
+					     public RegionObserver
+    {
+    public:
+      /// \param filename base name of the trace file
+      /// \param capacity maximum number of queued events
+      /// \param policy behavior when the queue is full
+      explicit TraceEventOutput (std::string filename = "trace",
+				 std::size_t capacity = 4096,
+				 OverflowPolicy policy = BLOCK);
+      ~TraceEventOutput ();
+
+      void write (const Channel& channel,
+		  char const* file,
+		  int line,
+		  char const* function,
+		  boost::string_ref data);
+
+      void regionBegin (char const* name, boost::uint64_t time);
+      void regionEnd (char const* name,
+		      boost::uint64_t time,
+		      boost::uint64_t duration);
+
+      std::string getFilename () const;
+
+    private:
+      /// \brief Queue an event.
+      ///
+      /// \param phase trace event type (B, E, i)
+      void writeEvent (char phase,
+		       boost::string_ref name,
+		       boost::string_ref category,
+		       boost::uint64_t time,
+		       char const* file = 0,
+		       int line = 0);
+
+      std::string filename;
+      std::ofstream stream;
+      int pid_;
+    };
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_TRACE_EVENT_HH
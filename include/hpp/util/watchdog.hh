@@ -0,0 +1,132 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// This software is provided "as is" without warranty of any kind,
+// either expressed or implied, including but not limited to the
+// implied warranties of fitness for a particular purpose.
+//
+// See the COPYING file for more information.
+
+#ifndef HPP_UTIL_WATCHDOG_HH
+# define HPP_UTIL_WATCHDOG_HH
+
+# include <boost/atomic.hpp>
+# include <boost/cstdint.hpp>
+
+# include <hpp/util/config.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    struct WatchedRegion;
+
+    /// \brief Latency budget of a region, see DeadlineScope.
+    ///
+    /// Deadlines are static objects of the call sites, like
+    /// RateLimiter; they register themselves so that logSummary can
+    /// report the regions completed over budget. Logging calls it on
+    /// destruction; deadlines are trivially destructible so that they
+    /// are still valid at that time.
+    class HPP_UTIL_DLLAPI Deadline
+    {
+    public:
+      /// \param name region name, which must outlive the program
+      /// (typically a string literal)
+      /// \param budget in nanoseconds
+      Deadline (char const* name,
+		boost::uint64_t budget,
+		char const* file,
+		int line);
+
+      char const* name () const;
+      boost::uint64_t budget () const;
+
+      /// \brief Number of regions completed.
+      boost::uint64_t completed () const;
+
+      /// \brief Number of regions completed over budget.
+      boost::uint64_t overBudget () const;
+
+      /// \brief Log, on the warning channel, the number of regions
+      /// completed over budget of every deadline exceeded since the
+      /// last summary.
+      static void logSummary ();
+
+    private:
+      Deadline (const Deadline&);
+      Deadline& operator= (const Deadline&);
+
+      friend class DeadlineScope;
+      friend class Watchdog;
+
+      char const* name_;
+      boost::uint64_t budget_;
+      char const* file_;
+      int line_;
+
+      boost::atomic<boost::uint64_t> completed_;
+      boost::atomic<boost::uint64_t> overBudget_;
+      /// \brief Over budget count at the last summary.
+      boost::uint64_t reported_;
+
+      /// \brief Next registered deadline.
+      Deadline* next_;
+    };
+
+    /// \brief Region of code with a latency budget, from construction
+    /// to destruction (or stop).
+    ///
+    /// While the region is open, the watchdog thread reports it once
+    /// on the warning channel if it exceeds its budget, naming the
+    /// region, the thread and the elapsed time. When the region is
+    /// left, it is counted in its deadline, as over budget if it took
+    /// longer than the budget.
+    ///
+    /// Entering and leaving a region do not lock. Regions must be
+    /// properly nested; the watchdog only checks the 16 outermost
+    /// regions of each thread.
+    class HPP_UTIL_DLLAPI DeadlineScope
+    {
+    public:
+      explicit DeadlineScope (Deadline& deadline);
+      ~DeadlineScope ();
+
+      /// \brief Leave the region before destruction.
+      void stop ();
+
+    private:
+      DeadlineScope (const DeadlineScope&);
+      DeadlineScope& operator= (const DeadlineScope&);
+
+      Deadline* deadline_;
+      WatchedRegion* region_;
+      boost::uint64_t start_;
+    };
+
+    /// \brief Thread checking the open DeadlineScope regions.
+    ///
+    /// The thread is started when the first deadline is registered
+    /// and wakes up once per period. Logging stops it on destruction.
+    class HPP_UTIL_DLLAPI Watchdog
+    {
+    public:
+      /// \brief Set the time between two checks, in nanoseconds
+      /// (10 ms by default).
+      static void setPeriod (boost::uint64_t period);
+      static boost::uint64_t period ();
+
+      /// \brief Check the open regions now.
+      static void check ();
+
+      /// \brief Number of open regions reported over budget.
+      static boost::uint64_t reported ();
+
+      /// \brief Stop the thread; open regions are not checked anymore.
+      static void stop ();
+    };
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_WATCHDOG_HH
@@ -0,0 +1,487 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <ostream>
+#include <string>
+
+#include <boost/format.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#if defined HAVE_UNISTD_H && defined __linux__
+# include <fcntl.h>
+# include <unistd.h>
+# define HPP_UTIL_HAVE_PROC_STATM 1
+#endif // HAVE_UNISTD_H && __linux__
+
+#include "hpp/util/allocation-tracker.hh"
+#include "hpp/util/debug.hh"
+#include "hpp/util/format-buffer.hh"
+#include "hpp/util/profiler.hh"
+
+#ifdef __GNUC__
+// Initial-exec: accessing the counters must not allocate.
+# define HPP_UTIL_THREAD_LOCAL \
+  __thread __attribute__ ((tls_model ("initial-exec")))
+#elif defined _MSC_VER
+# define HPP_UTIL_THREAD_LOCAL __declspec (thread)
+#else
+# error "thread-local storage is required by the allocation tracker"
+#endif // __GNUC__
+
+// Exception specifications of the replaced operators: dynamic ones
+// are ill-formed from C++17.
+#if __cplusplus >= 201103L
+# define HPP_UTIL_THROW_BAD_ALLOC
+# define HPP_UTIL_NOTHROW noexcept
+#else
+# define HPP_UTIL_THROW_BAD_ALLOC throw (std::bad_alloc)
+# define HPP_UTIL_NOTHROW throw ()
+#endif // __cplusplus >= 201103L
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      /// \brief Plain data version of AllocationCounters, for thread
+      /// local storage.
+      struct HPP_UTIL_LOCAL Counts
+      {
+	boost::uint64_t allocations;
+	boost::uint64_t deallocations;
+	boost::uint64_t bytes;
+	boost::int64_t live;
+      };
+
+      /// \brief Region entered by a thread.
+      struct HPP_UTIL_LOCAL Frame
+      {
+	char const* name;
+	Counts start;
+	/// \brief Peak of the enclosing region when entered.
+	boost::int64_t peak;
+	/// \brief Resident set size when entered, only read for the
+	/// outermost regions (sampled).
+	boost::uint64_t residentSetSize;
+	bool sampled;
+      };
+
+      const std::size_t maxDepth = 32;
+
+      /// \brief Allocation state of a thread.
+      ///
+      /// Plain data, zero-initialized for each thread without
+      /// allocating.
+      struct HPP_UTIL_LOCAL ThreadState
+      {
+	Counts counters;
+	/// \brief Largest value of counters.live since the innermost
+	/// region was entered.
+	boost::int64_t peak;
+	/// \brief Do not count the allocations of the tracker itself.
+	bool suspended;
+	/// \brief Number of active regions, frames beyond maxDepth are
+	/// not kept.
+	std::size_t depth;
+	Frame frames[maxDepth];
+      };
+
+      HPP_UTIL_THREAD_LOCAL ThreadState state;
+
+      /// \brief Bytes before each block, keeping malloc alignment.
+      const std::size_t headerSize = 16;
+
+      /// \brief Allocations of a region name, summed over calls.
+      struct HPP_UTIL_LOCAL RegionAllocations
+      {
+	RegionAllocations ()
+	  : calls (0),
+	    peak (0),
+	    residentSetSize (0),
+	    sampledCalls (0)
+	{}
+
+	boost::uint64_t calls;
+	AllocationCounters counters;
+	boost::int64_t peak;
+	boost::int64_t residentSetSize;
+	/// \brief Calls contributing to residentSetSize.
+	boost::uint64_t sampledCalls;
+      };
+
+      typedef std::map<std::string, RegionAllocations> regions_t;
+
+      /// \brief Suspend the tracking of the calling thread while
+      /// alive.
+      class HPP_UTIL_LOCAL Suspend
+      {
+      public:
+	Suspend ()
+	  : suspended_ (state.suspended)
+	{
+	  state.suspended = true;
+	}
+
+	~Suspend ()
+	{
+	  state.suspended = suspended_;
+	}
+
+      private:
+	bool suspended_;
+      };
+
+      // Never destroyed: regions may be left during static
+      // destruction.
+      HPP_UTIL_LOCAL boost::mutex&
+      regionsMutex ()
+      {
+	static boost::mutex* mutex = new boost::mutex ();
+	return *mutex;
+      }
+
+      HPP_UTIL_LOCAL regions_t&
+      regions ()
+      {
+	static regions_t* regions = new regions_t ();
+	return *regions;
+      }
+
+      HPP_UTIL_LOCAL void*
+      allocate (std::size_t size)
+      {
+	char* block = static_cast<char*> (std::malloc (size + headerSize));
+	if (!block)
+	  return 0;
+	*reinterpret_cast<std::size_t*> (block) = size;
+	if (!state.suspended)
+	  {
+	    ++state.counters.allocations;
+	    state.counters.bytes += size;
+	    state.counters.live += (boost::int64_t) size;
+	    if (state.counters.live > state.peak)
+	      state.peak = state.counters.live;
+	  }
+	return block + headerSize;
+      }
+
+      /// \brief Allocate as the standard operator new: call the new
+      /// handler until the allocation succeeds.
+      HPP_UTIL_LOCAL void*
+      allocateOrThrow (std::size_t size)
+      {
+	for (;;)
+	  {
+	    void* pointer = allocate (size);
+	    if (pointer)
+	      return pointer;
+	    std::new_handler handler = std::set_new_handler (0);
+	    std::set_new_handler (handler);
+	    if (!handler)
+	      throw std::bad_alloc ();
+	    handler ();
+	  }
+      }
+
+      HPP_UTIL_LOCAL void
+      deallocate (void* pointer)
+      {
+	if (!pointer)
+	  return;
+	char* block = static_cast<char*> (pointer) - headerSize;
+	if (!state.suspended)
+	  {
+	    ++state.counters.deallocations;
+	    state.counters.live -=
+	      (boost::int64_t) *reinterpret_cast<std::size_t*> (block);
+	  }
+	std::free (block);
+      }
+
+      /// \brief Account the regions left by the threads.
+      class HPP_UTIL_LOCAL RegionTracker : public RegionObserver
+      {
+      public:
+	RegionTracker ()
+	{
+	  Profiler::addObserver (this);
+	}
+
+	~RegionTracker ()
+	{
+	  Profiler::removeObserver (this);
+	  AllocationTracker::logReport ();
+	}
+
+	void regionBegin (char const* name, boost::uint64_t)
+	{
+	  if (state.depth < maxDepth)
+	    {
+	      Frame& frame = state.frames[state.depth];
+	      frame.name = name;
+	      frame.start = state.counters;
+	      frame.peak = state.peak;
+	      // Reading the resident set size is a system call: only do
+	      // it around the outermost regions, not the short hot ones.
+	      frame.sampled = state.depth == 0;
+	      frame.residentSetSize = frame.sampled
+		? AllocationTracker::residentSetSize () : 0;
+	      state.peak = state.counters.live;
+	    }
+	  ++state.depth;
+	}
+
+	void regionEnd (char const* name, boost::uint64_t, boost::uint64_t)
+	{
+	  if (!state.depth)
+	    return;
+	  if (state.depth > maxDepth)
+	    {
+	      --state.depth;
+	      return;
+	    }
+	  // Regions may be left out of order: the profiler passes the
+	  // same name pointer to both notifications.
+	  std::size_t i = state.depth - 1;
+	  while (i > 0 && state.frames[i].name != name)
+	    --i;
+	  if (state.frames[i].name != name)
+	    i = state.depth - 1;
+	  const Frame frame = state.frames[i];
+	  boost::int64_t peak = state.peak;
+	  for (std::size_t j = i + 1; j < state.depth; ++j)
+	    peak = std::max (peak, state.frames[j].peak);
+	  boost::uint64_t residentSetSize = frame.sampled
+	    ? AllocationTracker::residentSetSize () : 0;
+
+	  {
+	    Suspend suspend;
+	    boost::lock_guard<boost::mutex> lock (regionsMutex ());
+	    RegionAllocations& region = regions ()[name];
+	    ++region.calls;
+	    region.counters.allocations +=
+	      state.counters.allocations - frame.start.allocations;
+	    region.counters.deallocations +=
+	      state.counters.deallocations - frame.start.deallocations;
+	    region.counters.bytes += state.counters.bytes - frame.start.bytes;
+	    region.counters.live += state.counters.live - frame.start.live;
+	    region.peak = std::max (region.peak, peak - frame.start.live);
+	    if (frame.sampled)
+	      {
+		region.residentSetSize += (boost::int64_t) residentSetSize
+		  - (boost::int64_t) frame.residentSetSize;
+		++region.sampledCalls;
+	      }
+	  }
+
+	  // The enclosing region peak includes this one.
+	  if (i + 1 == state.depth)
+	    state.peak = std::max (state.peak, frame.peak);
+	  else
+	    state.frames[i + 1].peak =
+	      std::max (state.frames[i + 1].peak, frame.peak);
+	  for (; i + 1 < state.depth; ++i)
+	    state.frames[i] = state.frames[i + 1];
+	  --state.depth;
+	}
+      };
+
+      RegionTracker tracker;
+    } // end of anonymous namespace.
+
+    AllocationCounters::AllocationCounters ()
+      : allocations (0),
+	deallocations (0),
+	bytes (0),
+	live (0)
+    {}
+
+    AllocationCounters
+    AllocationTracker::current ()
+    {
+      AllocationCounters counters;
+      counters.allocations = state.counters.allocations;
+      counters.deallocations = state.counters.deallocations;
+      counters.bytes = state.counters.bytes;
+      counters.live = state.counters.live;
+      return counters;
+    }
+
+    boost::uint64_t
+    AllocationTracker::residentSetSize ()
+    {
+#ifdef HPP_UTIL_HAVE_PROC_STATM
+      // Kept open: reading at offset 0 updates the values.
+      static const int fd = open ("/proc/self/statm", O_RDONLY);
+      static const long pageSize = sysconf (_SC_PAGESIZE);
+      if (fd < 0 || pageSize <= 0)
+	return 0;
+      // Size then resident, in pages.
+      char buffer[128];
+      ssize_t size = pread (fd, buffer, sizeof (buffer) - 1, 0);
+      if (size <= 0)
+	return 0;
+      buffer[size] = 0;
+      char* end;
+      std::strtoul (buffer, &end, 10);
+      return (boost::uint64_t) std::strtoul (end, 0, 10)
+	* (boost::uint64_t) pageSize;
+#else
+      return 0;
+#endif // HPP_UTIL_HAVE_PROC_STATM
+    }
+
+    void
+    AllocationTracker::print (std::ostream& o)
+    {
+      regions_t copy;
+      {
+	Suspend suspend;
+	boost::lock_guard<boost::mutex> lock (regionsMutex ());
+	copy = regions ();
+      }
+      o << "allocations per region, sizes in bytes\n"
+	<< boost::format ("%10s %12s %12s %14s %12s %12s  %s")
+	% "calls" % "allocations" % "frees" % "allocated" % "peak" % "RSS"
+	% "region"
+	<< '\n';
+      for (regions_t::const_iterator it = copy.begin (); it != copy.end ();
+	   ++it)
+	{
+	  const RegionAllocations& region = it->second;
+	  std::string residentSetSize = region.sampledCalls
+	    ? (boost::format ("%d") % region.residentSetSize).str ()
+	    : std::string ("-");
+	  o << boost::format ("%10d %12d %12d %14d %12d %12s  %s")
+	    % region.calls % region.counters.allocations
+	    % region.counters.deallocations % region.counters.bytes
+	    % region.peak % residentSetSize % it->first
+	    << '\n';
+	}
+    }
+
+    void
+    AllocationTracker::logReport ()
+    {
+      if (!logging.benchmark.isEnabled ())
+	return;
+      {
+	Suspend suspend;
+	boost::lock_guard<boost::mutex> lock (regionsMutex ());
+	if (regions ().empty ())
+	  return;
+      }
+
+      ScopedFormatStream report;
+      print (report.stream ());
+      logging.benchmark.write (__FILE__, __LINE__, __PRETTY_FUNCTION__,
+			       report.str ());
+    }
+
+    void
+    AllocationTracker::reset ()
+    {
+      Suspend suspend;
+      boost::lock_guard<boost::mutex> lock (regionsMutex ());
+      regions ().clear ();
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
+
+void*
+operator new (std::size_t size) HPP_UTIL_THROW_BAD_ALLOC
+{
+  return hpp::debug::allocateOrThrow (size);
+}
+
+void*
+operator new[] (std::size_t size) HPP_UTIL_THROW_BAD_ALLOC
+{
+  return hpp::debug::allocateOrThrow (size);
+}
+
+void*
+operator new (std::size_t size, const std::nothrow_t&) HPP_UTIL_NOTHROW
+{
+  try
+    {
+      return hpp::debug::allocateOrThrow (size);
+    }
+  catch (const std::bad_alloc&)
+    {
+      return 0;
+    }
+}
+
+void*
+operator new[] (std::size_t size, const std::nothrow_t&) HPP_UTIL_NOTHROW
+{
+  try
+    {
+      return hpp::debug::allocateOrThrow (size);
+    }
+  catch (const std::bad_alloc&)
+    {
+      return 0;
+    }
+}
+
+void
+operator delete (void* pointer) HPP_UTIL_NOTHROW
+{
+  hpp::debug::deallocate (pointer);
+}
+
+void
+operator delete[] (void* pointer) HPP_UTIL_NOTHROW
+{
+  hpp::debug::deallocate (pointer);
+}
+
+void
+operator delete (void* pointer, const std::nothrow_t&) HPP_UTIL_NOTHROW
+{
+  hpp::debug::deallocate (pointer);
+}
+
+void
+operator delete[] (void* pointer, const std::nothrow_t&) HPP_UTIL_NOTHROW
+{
+  hpp::debug::deallocate (pointer);
+}
+
+#ifdef __cpp_sized_deallocation
+void
+operator delete (void* pointer, std::size_t) HPP_UTIL_NOTHROW
+{
+  hpp::debug::deallocate (pointer);
+}
+
+void
+operator delete[] (void* pointer, std::size_t) HPP_UTIL_NOTHROW
+{
+  hpp::debug::deallocate (pointer);
+}
+#endif // __cpp_sized_deallocation
@@ -0,0 +1,190 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "hpp/util/assertion.hh"
+#include "hpp/util/clock.hh"
+#include "hpp/util/debug.hh"
+
+namespace hpp
+{
+  namespace
+  {
+    /// \brief Head of the list of registered sites.
+    ///
+    /// Zero-initialized before any site can be constructed.
+    boost::atomic<AssertionSite*> sites;
+
+    /// \brief Evaluation time of a site, clock bias subtracted.
+    struct HPP_UTIL_LOCAL SiteTime
+    {
+      SiteTime (const AssertionSite* s, boost::uint64_t bias)
+	: site (s),
+	  evaluations (s->evaluations ()),
+	  time (s->time ())
+      {
+	time = time > evaluations * bias ? time - evaluations * bias : 0;
+      }
+
+      /// \brief Order by decreasing time.
+      bool operator< (const SiteTime& other) const
+      {
+	return time > other.time;
+      }
+
+      const AssertionSite* site;
+      boost::uint64_t evaluations;
+      boost::uint64_t time;
+    };
+
+    /// \brief Median time measured around an empty evaluation, in
+    /// nanoseconds.
+    HPP_UTIL_LOCAL boost::uint64_t
+    clockBias ()
+    {
+      std::vector<boost::uint64_t> samples (1001);
+      for (std::size_t i = 0; i < samples.size (); ++i)
+	{
+	  boost::uint64_t start = debug::tscNow ();
+	  samples[i] = debug::tscNow () - start;
+	}
+      std::vector<boost::uint64_t>::iterator median =
+	samples.begin () + samples.size () / 2;
+      std::nth_element (samples.begin (), median, samples.end ());
+      return *median;
+    }
+  } // end of anonymous namespace.
+
+  AssertionSite::AssertionSite (char const* condition,
+				char const* file,
+				unsigned line,
+				int level)
+    : condition_ (condition),
+      file_ (file),
+      line_ (line),
+      level_ (level),
+      evaluations_ (0),
+      time_ (0),
+      next_ (sites.load ())
+  {
+    while (!sites.compare_exchange_weak (next_, this))
+      {}
+  }
+
+  char const*
+  AssertionSite::condition () const
+  {
+    return condition_;
+  }
+
+  char const*
+  AssertionSite::file () const
+  {
+    return file_;
+  }
+
+  unsigned
+  AssertionSite::line () const
+  {
+    return line_;
+  }
+
+  int
+  AssertionSite::level () const
+  {
+    return level_;
+  }
+
+  boost::uint64_t
+  AssertionSite::evaluations () const
+  {
+    return evaluations_.load ();
+  }
+
+  boost::uint64_t
+  AssertionSite::time () const
+  {
+    return time_.load ();
+  }
+
+  boost::atomic<int> Assertion::lowered_;
+
+  void
+  Assertion::setLevel (AssertionLevel level)
+  {
+    lowered_.store (ASSERTION_AUDIT - level);
+  }
+
+  AssertionLevel
+  Assertion::level ()
+  {
+    return (AssertionLevel) (ASSERTION_AUDIT - lowered_.load ());
+  }
+
+  void
+  Assertion::printProfile (std::ostream& o, std::size_t count)
+  {
+    // Subtract the cost of reading the clock from every evaluation.
+    boost::uint64_t bias = clockBias ();
+    std::vector<SiteTime> profiled;
+    for (const AssertionSite* site = sites.load (); site; site = site->next_)
+      profiled.push_back (SiteTime (site, bias));
+    std::sort (profiled.begin (), profiled.end ());
+    if (profiled.size () > count)
+      profiled.erase (profiled.begin () + count, profiled.end ());
+
+    o << "assertion profile, clock bias of " << bias << " ns subtracted\n"
+      << boost::format ("%12s %12s %10s %6s  %s")
+      % "evaluations" % "total ms" % "mean ns" % "level" % "site"
+      << '\n';
+    for (std::size_t i = 0; i < profiled.size (); ++i)
+      {
+	const SiteTime& p = profiled[i];
+	o << boost::format ("%12u %12.3f %10.1f %6d  %s:%u: %s")
+	  % p.evaluations % ((double) p.time / 1e6)
+	  % (p.evaluations ? (double) p.time / (double) p.evaluations : 0.)
+	  % p.site->level () % p.site->file () % p.site->line ()
+	  % p.site->condition ()
+	  << '\n';
+      }
+  }
+
+  void
+  Assertion::logProfile ()
+  {
+    if (!sites.load () || !debug::logging.benchmark.isEnabled ())
+      return;
+    debug::ScopedFormatStream report;
+    printProfile (report.stream ());
+    debug::logging.benchmark.write (__FILE__, __LINE__, __PRETTY_FUNCTION__,
+				    report.str ());
+  }
+
+  void
+  Assertion::fail (char const* condition, char const* file, unsigned line)
+  {
+    throw AssertionError (std::string (condition) + " evaluates to false",
+			  file, line);
+  }
+
+} // end of namespace hpp.
@@ -0,0 +1,255 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "async-writer.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      HPP_UTIL_LOCAL std::size_t
+      roundCapacity (std::size_t capacity)
+      {
+	std::size_t res = 2;
+	while (res < capacity)
+	  res *= 2;
+	return res;
+      }
+    } // end of anonymous namespace.
+
+    RecordQueue::RecordQueue (std::size_t capacity)
+      : slots_ (new Slot[roundCapacity (capacity)]),
+	mask_ (roundCapacity (capacity) - 1),
+	enqueuePosition_ (0),
+	dequeuePosition_ (0)
+    {
+      for (std::size_t i = 0; i <= mask_; ++i)
+	slots_[i].sequence.store (i, boost::memory_order_relaxed);
+    }
+
+    bool
+    RecordQueue::tryPush (boost::string_ref text, boost::uint64_t timestamp)
+    {
+      std::size_t position =
+	enqueuePosition_.load (boost::memory_order_relaxed);
+      Slot* slot;
+      for (;;)
+	{
+	  slot = &slots_[position & mask_];
+	  std::size_t sequence =
+	    slot->sequence.load (boost::memory_order_acquire);
+	  std::ptrdiff_t diff =
+	    (std::ptrdiff_t) sequence - (std::ptrdiff_t) position;
+	  if (diff == 0)
+	    {
+	      if (enqueuePosition_.compare_exchange_weak
+		  (position, position + 1, boost::memory_order_relaxed))
+		break;
+	    }
+	  else if (diff < 0)
+	    return false;
+	  else
+	    position = enqueuePosition_.load (boost::memory_order_relaxed);
+	}
+      slot->record.timestamp = timestamp;
+      slot->record.text.assign (text.data (), text.size ());
+      slot->sequence.store (position + 1, boost::memory_order_release);
+      return true;
+    }
+
+    bool
+    RecordQueue::tryPop (Record& record)
+    {
+      std::size_t position =
+	dequeuePosition_.load (boost::memory_order_relaxed);
+      Slot* slot;
+      for (;;)
+	{
+	  slot = &slots_[position & mask_];
+	  std::size_t sequence =
+	    slot->sequence.load (boost::memory_order_acquire);
+	  std::ptrdiff_t diff =
+	    (std::ptrdiff_t) sequence - (std::ptrdiff_t) (position + 1);
+	  if (diff == 0)
+	    {
+	      if (dequeuePosition_.compare_exchange_weak
+		  (position, position + 1, boost::memory_order_relaxed))
+		break;
+	    }
+	  else if (diff < 0)
+	    return false;
+	  else
+	    position = dequeuePosition_.load (boost::memory_order_relaxed);
+	}
+      record.swap (slot->record);
+      slot->sequence.store (position + mask_ + 1,
+			    boost::memory_order_release);
+      return true;
+    }
+
+    bool
+    RecordQueue::empty () const
+    {
+      return dequeuePosition_.load (boost::memory_order_relaxed)
+	== enqueuePosition_.load (boost::memory_order_relaxed);
+    }
+
+    std::size_t
+    RecordQueue::enqueuePosition () const
+    {
+      return enqueuePosition_.load (boost::memory_order_relaxed);
+    }
+
+    std::size_t
+    RecordQueue::dequeuePosition () const
+    {
+      return dequeuePosition_.load (boost::memory_order_relaxed);
+    }
+
+
+    AsyncWriter::AsyncWriter (std::ostream& stream,
+			      std::size_t capacity,
+			      Output::OverflowPolicy policy)
+      : stream_ (stream),
+	queue_ (capacity),
+	policy_ (policy),
+	dropped_ (0),
+	sleeping_ (false),
+	stopping_ (false),
+	flushed_ (0),
+	mutex_ (),
+	wakeUpCondition_ (),
+	flushedCondition_ (),
+	thread_ (boost::bind (&AsyncWriter::run, this))
+    {}
+
+    AsyncWriter::~AsyncWriter ()
+    {
+      stopping_.store (true);
+      {
+	boost::lock_guard<boost::mutex> lock (mutex_);
+	wakeUpCondition_.notify_one ();
+      }
+      thread_.join ();
+    }
+
+    void
+    AsyncWriter::push (boost::string_ref record)
+    {
+      Record discarded;
+      while (!queue_.tryPush (record))
+	switch (policy_)
+	  {
+	  case Output::DROP_NEWEST:
+	    ++dropped_;
+	    return;
+	  case Output::DROP_OLDEST:
+	    if (queue_.tryPop (discarded))
+	      ++dropped_;
+	    break;
+	  case Output::BLOCK:
+	    wakeUp ();
+	    boost::this_thread::yield ();
+	    break;
+	  }
+      wakeUp ();
+    }
+
+    void
+    AsyncWriter::flush ()
+    {
+      // Records are written in queue order, whatever the order in
+      // which producers finish pushing them: wait for the position
+      // rather than for a number of records.
+      std::size_t target = queue_.enqueuePosition ();
+      boost::unique_lock<boost::mutex> lock (mutex_);
+      while ((std::ptrdiff_t) (flushed_ - target) < 0)
+	{
+	  wakeUpCondition_.notify_one ();
+	  flushedCondition_.wait (lock);
+	}
+    }
+
+    boost::uint64_t
+    AsyncWriter::dropped () const
+    {
+      return dropped_.load (boost::memory_order_relaxed);
+    }
+
+    void
+    AsyncWriter::wakeUp ()
+    {
+      // Only take the lock when the writer is waiting. The queue is
+      // read with relaxed loads, so the writer may go to sleep right
+      // after a push without being notified: its timed wait bounds the
+      // latency of such a record.
+      if (sleeping_.load ())
+	{
+	  boost::lock_guard<boost::mutex> lock (mutex_);
+	  wakeUpCondition_.notify_one ();
+	}
+    }
+
+    void
+    AsyncWriter::run ()
+    {
+      Record record;
+      // Records of a batch, written at once: unbuffered streams such
+      // as std::cerr would otherwise make a system call per record.
+      std::string batch;
+      for (;;)
+	{
+	  std::size_t count = 0;
+	  while (count < batchSize && queue_.tryPop (record))
+	    {
+	      batch.append (record.text);
+	      ++count;
+	    }
+	  if (!batch.empty ())
+	    {
+	      stream_.write (batch.data (), (std::streamsize) batch.size ());
+	      batch.clear ();
+	    }
+	  if (count == batchSize)
+	    continue;
+
+	  // The queue has been drained: make the batch visible.
+	  stream_.flush ();
+	  boost::unique_lock<boost::mutex> lock (mutex_);
+	  flushed_ = queue_.dequeuePosition ();
+	  flushedCondition_.notify_all ();
+
+	  sleeping_.store (true);
+	  if (queue_.empty ())
+	    {
+	      if (stopping_.load ())
+		break;
+	      // The timeout bounds the latency of a missed notification.
+	      wakeUpCondition_.timed_wait
+		(lock, boost::posix_time::milliseconds (10));
+	    }
+	  sleeping_.store (false);
+	}
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
@@ -0,0 +1,162 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_UTIL_SRC_ASYNC_WRITER_HH
+# define HPP_UTIL_SRC_ASYNC_WRITER_HH
+# include <cstddef>
+# include <ostream>
+# include <string>
+# include <utility>
+
+# include <boost/atomic.hpp>
+# include <boost/cstdint.hpp>
+# include <boost/scoped_array.hpp>
+# include <boost/thread/condition_variable.hpp>
+# include <boost/thread/mutex.hpp>
+# include <boost/thread/thread.hpp>
+# include <boost/utility/string_ref.hpp>
+
+# include <hpp/util/config.hh>
+# include <hpp/util/debug.hh>
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Formatted record and the time it was emitted at.
+    struct HPP_UTIL_LOCAL Record
+    {
+      Record ()
+	: timestamp (0),
+	  text ()
+      {}
+
+      void swap (Record& other)
+      {
+	std::swap (timestamp, other.timestamp);
+	text.swap (other.text);
+      }
+
+      /// \brief Monotonic time in nanoseconds, zero if unused.
+      boost::uint64_t timestamp;
+      std::string text;
+    };
+
+    /// \brief Bounded lock-free queue of formatted records.
+    ///
+    /// Multi-producer/multi-consumer ring (D. Vyukov's algorithm).
+    /// The writer thread is the regular consumer; producers only
+    /// consume when discarding the oldest record on overflow.
+    ///
+    /// Slots keep their string storage between uses so that, once
+    /// the ring is warm, pushing a record does not allocate.
+    class HPP_UTIL_LOCAL RecordQueue
+    {
+    public:
+      /// \param capacity number of slots, rounded up to a power of two.
+      explicit RecordQueue (std::size_t capacity);
+
+      /// \brief Copy a record into the queue.
+      /// \return false if the queue is full.
+      bool tryPush (boost::string_ref text, boost::uint64_t timestamp = 0);
+
+      /// \brief Extract the oldest record.
+      ///
+      /// The record is swapped with \a record, so that the previous
+      /// content of \a record is recycled as slot storage.
+      /// \return false if the queue is empty.
+      bool tryPop (Record& record);
+
+      /// \brief Approximate emptiness test.
+      bool empty () const;
+
+      /// \brief Position of the next record pushed.
+      ///
+      /// Every record pushed before the call is at a lower position.
+      std::size_t enqueuePosition () const;
+
+      /// \brief Position of the next record popped.
+      ///
+      /// Records are popped in position order: every record at a lower
+      /// position has been popped.
+      std::size_t dequeuePosition () const;
+
+    private:
+      struct Slot
+      {
+	boost::atomic<std::size_t> sequence;
+	Record record;
+      };
+
+      boost::scoped_array<Slot> slots_;
+      std::size_t mask_;
+      boost::atomic<std::size_t> enqueuePosition_;
+      boost::atomic<std::size_t> dequeuePosition_;
+    };
+
+    /// \brief Background writer draining a RecordQueue into a stream.
+    ///
+    /// The records popped together are gathered and written with a
+    /// single write to the stream.
+    class HPP_UTIL_LOCAL AsyncWriter
+    {
+    public:
+      AsyncWriter (std::ostream& stream,
+		   std::size_t capacity,
+		   Output::OverflowPolicy policy);
+
+      /// \brief Stop the writer thread after having drained the queue.
+      ~AsyncWriter ();
+
+      /// \brief Queue a record, applying the overflow policy if needed.
+      void push (boost::string_ref record);
+
+      /// \brief Wait until every record pushed so far is written
+      /// and the stream flushed.
+      void flush ();
+
+      boost::uint64_t dropped () const;
+
+    private:
+      void run ();
+      void wakeUp ();
+
+      /// \brief Maximum number of records written between two flushes.
+      static const std::size_t batchSize = 1024;
+
+      std::ostream& stream_;
+      RecordQueue queue_;
+      Output::OverflowPolicy policy_;
+
+      boost::atomic<boost::uint64_t> dropped_;
+      boost::atomic<bool> sleeping_;
+      boost::atomic<bool> stopping_;
+
+      /// \brief Queue position up to which records are known to be
+      /// written and flushed, or discarded (mutex_).
+      std::size_t flushed_;
+      boost::mutex mutex_;
+      boost::condition_variable wakeUpCondition_;
+      boost::condition_variable flushedCondition_;
+
+      boost::thread thread_;
+    };
+
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_SRC_ASYNC_WRITER_HH
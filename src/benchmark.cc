@@ -0,0 +1,480 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "hpp/util/benchmark.hh"
+#include "hpp/util/clock.hh"
+
+namespace hpp
+{
+  namespace benchmark
+  {
+    namespace
+    {
+      typedef std::vector<std::pair<std::string, function_t> > benchmarks_t;
+
+      HPP_UTIL_LOCAL benchmarks_t&
+      benchmarks ()
+      {
+	static benchmarks_t benchmarks;
+	return benchmarks;
+      }
+
+      const double nanosecondsPerSecond = 1e9;
+
+      /// \brief Duration of \a iterations iterations, in nanoseconds.
+      HPP_UTIL_LOCAL double
+      timeRun (function_t function, boost::uint64_t iterations)
+      {
+	State state (iterations);
+	boost::uint64_t start = debug::steadyNow ();
+	function (state);
+	return (double) (debug::steadyNow () - start);
+      }
+
+      /// \brief Smallest iteration count whose runs last \a minTime,
+      /// confirmed by two consecutive runs, at most \a maxIterations.
+      ///
+      /// \param tooFast set if runs of \a maxIterations are shorter
+      HPP_UTIL_LOCAL boost::uint64_t
+      iterationCount (function_t function, double minTime,
+		      boost::uint64_t maxIterations, bool& tooFast)
+      {
+	const double target = minTime * nanosecondsPerSecond;
+	boost::uint64_t iterations = 1;
+	tooFast = false;
+	for (;;)
+	  {
+	    double time = timeRun (function, iterations);
+	    if (time >= target)
+	      {
+		// Confirm the count: a single run slowed down by noise
+		// must not fix a count whose runs are much shorter.
+		time = std::min (time, timeRun (function, iterations));
+		if (time >= target)
+		  return iterations;
+	      }
+	    // A body optimized away, or below the clock resolution,
+	    // never reaches the target.
+	    if (iterations >= maxIterations)
+	      {
+		tooFast = true;
+		return iterations;
+	      }
+	    // Aim slightly above the target, grow at most tenfold.
+	    double factor = time > 0 ? 1.2 * target / time : 10.;
+	    factor = std::min (std::max (factor, 1.5), 10.);
+	    double next = std::ceil ((double) iterations * factor);
+	    iterations = next < (double) maxIterations
+	      ? (boost::uint64_t) next : maxIterations;
+	  }
+      }
+
+      HPP_UTIL_LOCAL Result
+      runBenchmark (const std::string& name, function_t function,
+		    const Options& options)
+      {
+	// Warm caches, branch predictors and frequency up.
+	boost::uint64_t start = debug::steadyNow ();
+	const double warmup = options.warmupTime * nanosecondsPerSecond;
+	for (boost::uint64_t iterations = 1;
+	     (double) (debug::steadyNow () - start) < warmup;
+	     iterations *= 2)
+	  timeRun (function, iterations);
+
+	Result result;
+	result.name = name;
+	result.iterations = iterationCount (function, options.minTime,
+					    options.maxIterations,
+					    result.tooFast);
+	result.repetitions = std::max (options.repetitions, 1u);
+
+	std::vector<double> times;
+	for (unsigned int i = 0; i < result.repetitions; ++i)
+	  times.push_back (timeRun (function, result.iterations)
+			   / (double) result.iterations);
+	std::sort (times.begin (), times.end ());
+
+	double sum = 0, sumOfSquares = 0;
+	for (std::size_t i = 0; i < times.size (); ++i)
+	  {
+	    sum += times[i];
+	    sumOfSquares += times[i] * times[i];
+	  }
+	std::size_t n = times.size ();
+	result.min = times.front ();
+	result.median = n % 2 ? times[n / 2]
+	  : (times[n / 2 - 1] + times[n / 2]) / 2;
+	result.mean = sum / (double) n;
+	double variance = sumOfSquares / (double) n - result.mean * result.mean;
+	result.stddev = variance > 0 ? std::sqrt (variance) : 0;
+	return result;
+      }
+
+      HPP_UTIL_LOCAL std::string
+      readFirstLine (const std::string& filename)
+      {
+	std::ifstream file (filename.c_str ());
+	std::string line;
+	std::getline (file, line);
+	return line;
+      }
+
+      HPP_UTIL_LOCAL std::string
+      escape (const std::string& text)
+      {
+	std::string escaped;
+	for (std::size_t i = 0; i < text.size (); ++i)
+	  {
+	    if (text[i] == '"' || text[i] == '\\')
+	      escaped += '\\';
+	    escaped += text[i];
+	  }
+	return escaped;
+      }
+
+      HPP_UTIL_LOCAL const Result*
+      find (const results_t& results, const std::string& name)
+      {
+	for (std::size_t i = 0; i < results.size (); ++i)
+	  if (results[i].name == name)
+	    return &results[i];
+	return 0;
+      }
+    } // end of anonymous namespace.
+
+    State::State (boost::uint64_t iterations)
+      : iterations_ (iterations),
+	remaining_ (iterations)
+    {}
+
+    boost::uint64_t
+    State::iterations () const
+    {
+      return iterations_;
+    }
+
+    Registrar::Registrar (char const* name, function_t function)
+    {
+      benchmarks ().push_back (std::make_pair (std::string (name), function));
+    }
+
+    Options::Options ()
+      : filter (),
+	repetitions (5),
+	minTime (.1),
+	maxIterations (1000000000),
+	warmupTime (.05),
+	json (false),
+	output (),
+	baseline (),
+	threshold (.1)
+    {}
+
+    bool
+    Options::parse (int argc, char** argv, std::ostream& o)
+    {
+      for (int i = 1; i < argc; ++i)
+	{
+	  std::string argument (argv[i]);
+	  std::string::size_type equal = argument.find ('=');
+	  std::string name = argument.substr (0, equal);
+	  std::string value = equal == std::string::npos
+	    ? std::string () : argument.substr (equal + 1);
+	  std::istringstream stream (value);
+
+	  bool valid = true;
+	  if (name == "--filter")
+	    filter = value;
+	  else if (name == "--repetitions")
+	    valid = (stream >> repetitions) && repetitions > 0;
+	  else if (name == "--min-time")
+	    valid = (stream >> minTime) && minTime > 0;
+	  else if (name == "--max-iterations")
+	    valid = (stream >> maxIterations) && maxIterations > 0;
+	  else if (name == "--warmup")
+	    valid = (stream >> warmupTime) && warmupTime >= 0;
+	  else if (name == "--format")
+	    {
+	      valid = value == "text" || value == "json";
+	      json = value == "json";
+	    }
+	  else if (name == "--output")
+	    output = value;
+	  else if (name == "--baseline")
+	    baseline = value;
+	  else if (name == "--threshold")
+	    valid = (stream >> threshold) && threshold >= 0;
+	  else
+	    {
+	      o << "usage: " << argv[0] << " [OPTION]...\n"
+		<< "  --filter=TEXT       only run benchmarks containing TEXT\n"
+		<< "  --repetitions=N     timed runs per benchmark ("
+		<< repetitions << ")\n"
+		<< "  --min-time=SECONDS  minimum duration of a run ("
+		<< minTime << ")\n"
+		<< "  --max-iterations=N  maximum iterations of a run ("
+		<< maxIterations << ")\n"
+		<< "  --warmup=SECONDS    warmup duration (" << warmupTime
+		<< ")\n"
+		<< "  --format=text|json  output format\n"
+		<< "  --output=FILE       also write JSON results to FILE\n"
+		<< "  --baseline=FILE     compare with JSON results in FILE\n"
+		<< "  --threshold=RATIO   median slowdown flagged as a "
+		<< "regression (" << threshold << ")" << std::endl;
+	      return false;
+	    }
+	  if (!valid)
+	    {
+	      o << "invalid value in " << argument << std::endl;
+	      return false;
+	    }
+	}
+      return true;
+    }
+
+    Result::Result ()
+      : name (),
+	iterations (0),
+	repetitions (0),
+	min (0),
+	median (0),
+	mean (0),
+	stddev (0),
+	tooFast (false)
+    {}
+
+    results_t
+    run (const Options& options)
+    {
+      results_t results;
+      const benchmarks_t& registered = benchmarks ();
+      for (std::size_t i = 0; i < registered.size (); ++i)
+	if (registered[i].first.find (options.filter) != std::string::npos)
+	  results.push_back (runBenchmark (registered[i].first,
+					   registered[i].second, options));
+      return results;
+    }
+
+    bool
+    checkEnvironment (std::ostream& o)
+    {
+      bool warned = false;
+      std::string governor = readFirstLine
+	("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor");
+      if (!governor.empty () && governor != "performance")
+	{
+	  o << "warning: CPU frequency scaling is enabled (governor "
+	    << governor << "), timings may vary" << std::endl;
+	  warned = true;
+	}
+      if (readFirstLine ("/sys/devices/system/cpu/cpufreq/boost") == "1"
+	  || readFirstLine
+	  ("/sys/devices/system/cpu/intel_pstate/no_turbo") == "0")
+	{
+	  o << "warning: CPU frequency boost is enabled, timings may vary"
+	    << std::endl;
+	  warned = true;
+	}
+#ifdef HPP_DEBUG
+      o << "warning: hpp-util was built with HPP_DEBUG" << std::endl;
+      warned = true;
+#endif // HPP_DEBUG
+      return warned;
+    }
+
+    void
+    printText (std::ostream& o, const results_t& results)
+    {
+      o << boost::format ("%-40s %12s %12s %12s %12s %12s\n")
+	% "benchmark" % "iterations" % "min ns" % "median ns" % "mean ns"
+	% "stddev ns";
+      for (std::size_t i = 0; i < results.size (); ++i)
+	{
+	  const Result& r = results[i];
+	  o << boost::format ("%-40s %12d %12.2f %12.2f %12.2f %12.2f%s\n")
+	    % r.name % r.iterations % r.min % r.median % r.mean % r.stddev
+	    % (r.tooFast ? "  too fast to measure" : "");
+	}
+      o.flush ();
+    }
+
+    void
+    printJson (std::ostream& o, const results_t& results)
+    {
+      o << "{\n  \"context\": {\"cpus\": "
+	<< boost::thread::hardware_concurrency ()
+	<< ", \"tsc_hz\": " << (boost::uint64_t) debug::calibrateTsc ()
+	<< "},\n  \"benchmarks\": [\n";
+      for (std::size_t i = 0; i < results.size (); ++i)
+	{
+	  const Result& r = results[i];
+	  o << boost::format
+	    ("    {\"name\": \"%1%\", \"iterations\": %2%, "
+	     "\"repetitions\": %3%, \"min_ns\": %4$.3f, "
+	     "\"median_ns\": %5$.3f, \"mean_ns\": %6$.3f, "
+	     "\"stddev_ns\": %7$.3f, \"too_fast\": %8%}")
+	    % escape (r.name) % r.iterations % r.repetitions
+	    % r.min % r.median % r.mean % r.stddev
+	    % (r.tooFast ? "true" : "false")
+	    << (i + 1 < results.size () ? ",\n" : "\n");
+	}
+      o << "  ]\n}" << std::endl;
+    }
+
+    results_t
+    readJson (std::istream& i)
+    {
+      using boost::property_tree::ptree;
+      results_t results;
+      try
+	{
+	  ptree tree;
+	  boost::property_tree::read_json (i, tree);
+	  BOOST_FOREACH (const ptree::value_type& benchmark,
+			 tree.get_child ("benchmarks"))
+	    {
+	      const ptree& b = benchmark.second;
+	      Result r;
+	      r.name = b.get<std::string> ("name");
+	      r.iterations = b.get<boost::uint64_t> ("iterations");
+	      r.repetitions = b.get<unsigned int> ("repetitions");
+	      r.min = b.get<double> ("min_ns");
+	      r.median = b.get<double> ("median_ns");
+	      r.mean = b.get<double> ("mean_ns");
+	      r.stddev = b.get<double> ("stddev_ns");
+	      r.tooFast = b.get<bool> ("too_fast", false);
+	      results.push_back (r);
+	    }
+	}
+      catch (const boost::property_tree::ptree_error& error)
+	{
+	  throw std::runtime_error
+	    (std::string ("invalid benchmark results: ") + error.what ());
+	}
+      return results;
+    }
+
+    std::size_t
+    compare (std::ostream& o,
+	     const results_t& results,
+	     const results_t& baseline,
+	     double threshold)
+    {
+      std::size_t regressions = 0;
+      o << boost::format ("%-40s %12s %12s %8s\n")
+	% "benchmark" % "baseline ns" % "median ns" % "change";
+      for (std::size_t i = 0; i < results.size (); ++i)
+	{
+	  const Result& r = results[i];
+	  const Result* base = find (baseline, r.name);
+	  if (!base || base->median <= 0)
+	    {
+	      o << boost::format ("%-40s %12s %12.2f %8s  new\n")
+		% r.name % "-" % r.median % "-";
+	      continue;
+	    }
+	  // Timings below the clock resolution are not compared.
+	  if (r.tooFast || base->tooFast)
+	    {
+	      o << boost::format ("%-40s %12.2f %12.2f %8s  too fast to "
+				  "measure\n")
+		% r.name % base->median % r.median % "-";
+	      continue;
+	    }
+	  double change = r.median / base->median - 1;
+	  const char* status = "";
+	  if (change > threshold)
+	    {
+	      status = "  REGRESSION";
+	      ++regressions;
+	    }
+	  else if (change < -threshold)
+	    status = "  improvement";
+	  o << boost::format ("%-40s %12.2f %12.2f %+7.1f%%%s\n")
+	    % r.name % base->median % r.median % (100 * change) % status;
+	}
+      o.flush ();
+      return regressions;
+    }
+
+    int
+    main (int argc, char** argv)
+    {
+      Options options;
+      if (!options.parse (argc, argv, std::cerr))
+	return EXIT_FAILURE;
+      checkEnvironment (std::cerr);
+
+      results_t results = run (options);
+      if (options.json)
+	printJson (std::cout, results);
+      else
+	printText (std::cout, results);
+
+      if (!options.output.empty ())
+	{
+	  std::ofstream output (options.output.c_str ());
+	  printJson (output, results);
+	  if (!output)
+	    {
+	      std::cerr << "cannot write " << options.output << std::endl;
+	      return EXIT_FAILURE;
+	    }
+	}
+
+      if (options.baseline.empty ())
+	return EXIT_SUCCESS;
+      std::ifstream file (options.baseline.c_str ());
+      if (!file)
+	{
+	  std::cerr << "cannot read " << options.baseline << std::endl;
+	  return EXIT_FAILURE;
+	}
+      // Keep stdout parsable in JSON mode.
+      std::ostream& o = options.json ? std::cerr : std::cout;
+      results_t baseline;
+      try
+	{
+	  baseline = readJson (file);
+	}
+      catch (const std::runtime_error& error)
+	{
+	  std::cerr << options.baseline << ": " << error.what () << std::endl;
+	  return EXIT_FAILURE;
+	}
+      std::size_t regressions =
+	compare (o, results, baseline, options.threshold);
+      return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+  } // end of namespace benchmark
+} // end of namespace hpp
@@ -0,0 +1,443 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+
+#include <boost/atomic.hpp>
+
+#include "hpp/util/binary-record.hh"
+#include "hpp/util/indent.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      HPP_UTIL_LOCAL boost::uint32_t
+      nextCallSiteId ()
+      {
+	static boost::atomic<boost::uint32_t> id (0);
+	return ++id;
+      }
+
+      template <typename T>
+      HPP_UTIL_LOCAL bool
+      read (const char*& data, const char* end, T& value)
+      {
+	if ((std::size_t) (end - data) < sizeof (T))
+	  return false;
+	std::memcpy (&value, data, sizeof (T));
+	data += sizeof (T);
+	return true;
+      }
+    } // end of anonymous namespace.
+
+    CallSite::CallSite (char const* file,
+			int line,
+			char const* function,
+			char const* format)
+      : id_ (nextCallSiteId ()),
+	file_ (file),
+	line_ (line),
+	function_ (function),
+	format_ (format)
+    {}
+
+    BinaryRecord::BinaryRecord ()
+      : overflow_ (),
+	size_ (0),
+	flags_ (std::ios_base::dec | std::ios_base::skipws),
+	precision_ (6),
+	width_ (0)
+    {}
+
+    void
+    BinaryRecord::append (const void* value, std::size_t size)
+    {
+      if (!size)
+	return;
+      if (overflow_.empty () && size_ + size <= inlineCapacity)
+	std::memcpy (inline_ + size_, value, size);
+      else
+	{
+	  if (overflow_.empty ())
+	    overflow_.assign (inline_, size_);
+	  overflow_.append (static_cast<const char*> (value), size);
+	}
+      size_ += size;
+    }
+
+    void
+    BinaryRecord::append (char tag, const void* value, std::size_t size)
+    {
+      append (&tag, 1);
+      append (value, size);
+      // Writing a value resets the width, as in ostream.
+      if (tag == TAG_BOOL || tag == TAG_CHAR || tag == TAG_SIGNED
+	  || tag == TAG_UNSIGNED || tag == TAG_DOUBLE || tag == TAG_POINTER
+	  || tag == TAG_STRING)
+	width_ = 0;
+    }
+
+    BinaryRecord&
+    BinaryRecord::append (const std::ostringstream& stream)
+    {
+      if (stream.flags () != flags_)
+	{
+	  flags_ = stream.flags ();
+	  boost::uint32_t v = (boost::uint32_t) flags_;
+	  append (TAG_FLAGS, &v, sizeof (v));
+	}
+      if (stream.precision () != precision_)
+	{
+	  precision_ = stream.precision ();
+	  boost::int64_t v = precision_;
+	  append (TAG_PRECISION, &v, sizeof (v));
+	}
+      std::string text = stream.str ();
+      // The width is either set by a manipulator, or consumed by the
+      // value: the text is already padded.
+      if (text.empty ())
+	{
+	  if (stream.width () != width_)
+	    {
+	      width_ = stream.width ();
+	      boost::int64_t v = width_;
+	      append (TAG_WIDTH, &v, sizeof (v));
+	    }
+	  return *this;
+	}
+      return *this << text;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (bool value)
+    {
+      char v = value;
+      append (TAG_BOOL, &v, sizeof (v));
+      return *this;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (char value)
+    {
+      append (TAG_CHAR, &value, sizeof (value));
+      return *this;
+    }
+
+    // Signed and unsigned chars are displayed as characters by
+    // iostreams.
+    BinaryRecord&
+    BinaryRecord::operator<< (signed char value)
+    {
+      return *this << (char) value;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (unsigned char value)
+    {
+      return *this << (char) value;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (short value)
+    {
+      return *this << (long long) value;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (unsigned short value)
+    {
+      return *this << (unsigned long long) value;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (int value)
+    {
+      return *this << (long long) value;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (unsigned int value)
+    {
+      return *this << (unsigned long long) value;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (long value)
+    {
+      return *this << (long long) value;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (unsigned long value)
+    {
+      return *this << (unsigned long long) value;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (long long value)
+    {
+      boost::int64_t v = value;
+      append (TAG_SIGNED, &v, sizeof (v));
+      return *this;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (unsigned long long value)
+    {
+      boost::uint64_t v = value;
+      append (TAG_UNSIGNED, &v, sizeof (v));
+      return *this;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (float value)
+    {
+      return *this << (double) value;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (double value)
+    {
+      append (TAG_DOUBLE, &value, sizeof (value));
+      return *this;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (const void* value)
+    {
+      boost::uint64_t v = (boost::uint64_t) (std::size_t) value;
+      append (TAG_POINTER, &v, sizeof (v));
+      return *this;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (const char* value)
+    {
+      if (!value)
+	return *this << "(null)";
+      return *this << boost::string_ref (value);
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (char* value)
+    {
+      return *this << (const char*) value;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (const std::string& value)
+    {
+      return *this << boost::string_ref (value);
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (boost::string_ref value)
+    {
+      boost::uint32_t length = (boost::uint32_t) value.size ();
+      append (TAG_STRING, &length, sizeof (length));
+      append (value.data (), length);
+      return *this;
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (std::ostream& (*manipulator) (std::ostream&))
+    {
+      char tag = 0;
+      // Flushing is meaningless for deferred formatting: flushing and
+      // non-flushing newlines are stored alike.
+      if (manipulator == &iendl || manipulator == &inl
+	  || manipulator
+	  == static_cast<std::ostream& (*) (std::ostream&)> (&std::endl))
+	tag = TAG_IENDL;
+      else if (manipulator == &incendl || manipulator == &incnl)
+	tag = TAG_INCENDL;
+      else if (manipulator == &decendl || manipulator == &decnl)
+	tag = TAG_DECENDL;
+      else if (manipulator == &incindent)
+	tag = TAG_INCINDENT;
+      else if (manipulator == &decindent)
+	tag = TAG_DECINDENT;
+      else if (manipulator == &resetindent)
+	tag = TAG_RESETINDENT;
+
+      if (tag)
+	{
+	  append (tag, 0, 0);
+	  return *this;
+	}
+
+      // Unknown manipulator: keep whatever it prints.
+      std::ostringstream stream;
+      stream << manipulator;
+      return *this << stream.str ();
+    }
+
+    BinaryRecord&
+    BinaryRecord::operator<< (std::ios_base& (*manipulator) (std::ios_base&))
+    {
+      std::ostringstream stream;
+      stream.flags (flags_);
+      manipulator (stream);
+      flags_ = stream.flags ();
+      boost::uint32_t v = (boost::uint32_t) flags_;
+      append (TAG_FLAGS, &v, sizeof (v));
+      return *this;
+    }
+
+    const char*
+    BinaryRecord::data () const
+    {
+      return overflow_.empty () ? inline_ : overflow_.data ();
+    }
+
+    std::size_t
+    BinaryRecord::size () const
+    {
+      return size_;
+    }
+
+    void
+    BinaryRecord::print (std::ostream& o) const
+    {
+      print (o, data (), size ());
+    }
+
+    bool
+    BinaryRecord::print (std::ostream& o, const char* data, std::size_t size)
+    {
+      const char* end = data + size;
+      while (data < end)
+	{
+	  char tag = *data++;
+	  switch (tag)
+	    {
+	    case TAG_BOOL:
+	      {
+		char v;
+		if (!read (data, end, v))
+		  return false;
+		o << (bool) v;
+		break;
+	      }
+	    case TAG_CHAR:
+	      {
+		char v;
+		if (!read (data, end, v))
+		  return false;
+		o << v;
+		break;
+	      }
+	    case TAG_SIGNED:
+	      {
+		boost::int64_t v;
+		if (!read (data, end, v))
+		  return false;
+		o << (long long) v;
+		break;
+	      }
+	    case TAG_UNSIGNED:
+	      {
+		boost::uint64_t v;
+		if (!read (data, end, v))
+		  return false;
+		o << (unsigned long long) v;
+		break;
+	      }
+	    case TAG_DOUBLE:
+	      {
+		double v;
+		if (!read (data, end, v))
+		  return false;
+		o << v;
+		break;
+	      }
+	    case TAG_POINTER:
+	      {
+		boost::uint64_t v;
+		if (!read (data, end, v))
+		  return false;
+		o << (const void*) (std::size_t) v;
+		break;
+	      }
+	    case TAG_STRING:
+	      {
+		boost::uint32_t length;
+		if (!read (data, end, length)
+		    || (std::size_t) (end - data) < length)
+		  return false;
+		// Padded to the field width, if any.
+		if (o.width ())
+		  o << std::string (data, length);
+		else
+		  o.write (data, length);
+		data += length;
+		break;
+	      }
+	    case TAG_FLAGS:
+	      {
+		boost::uint32_t v;
+		if (!read (data, end, v))
+		  return false;
+		o.flags ((std::ios_base::fmtflags) v);
+		break;
+	      }
+	    case TAG_PRECISION:
+	      {
+		boost::int64_t v;
+		if (!read (data, end, v))
+		  return false;
+		o.precision ((std::streamsize) v);
+		break;
+	      }
+	    case TAG_WIDTH:
+	      {
+		boost::int64_t v;
+		if (!read (data, end, v))
+		  return false;
+		o.width ((std::streamsize) v);
+		break;
+	      }
+	    case TAG_IENDL:
+	      o << inl;
+	      break;
+	    case TAG_INCENDL:
+	      o << incnl;
+	      break;
+	    case TAG_DECENDL:
+	      o << decnl;
+	      break;
+	    case TAG_INCINDENT:
+	      o << incindent;
+	      break;
+	    case TAG_DECINDENT:
+	      o << decindent;
+	      break;
+	    case TAG_RESETINDENT:
+	      o << resetindent;
+	      break;
+	    default:
+	      return false;
+	    }
+	}
+      return true;
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
@@ -0,0 +1,168 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <ctime>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/once.hpp>
+
+#ifdef HAVE_UNISTD_H
+# include <time.h>
+# include <unistd.h>
+#endif // HAVE_UNISTD_H
+
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+# include <cpuid.h>
+# include <x86intrin.h>
+# define HPP_UTIL_HAVE_TSC 1
+#endif // __GNUC__ && (__x86_64__ || __i386__)
+
+#include "hpp/util/clock.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      /// \brief Time stamp counter calibration.
+      struct HPP_UTIL_LOCAL TscCalibration
+      {
+	bool available;
+	/// \brief Counter value and steady time at calibration.
+	boost::uint64_t baseTicks;
+	boost::uint64_t baseTime;
+	double nanosecondsPerTick;
+      };
+
+      TscCalibration tsc;
+      boost::once_flag tscOnce = BOOST_ONCE_INIT;
+
+      /// \brief Duration of the calibration, in nanoseconds.
+      const boost::uint64_t calibrationTime = 10000000;
+
+      HPP_UTIL_LOCAL void
+      calibrate ()
+      {
+	tsc.available = false;
+	tsc.baseTicks = 0;
+	tsc.baseTime = 0;
+	tsc.nanosecondsPerTick = 0;
+#ifdef HPP_UTIL_HAVE_TSC
+	// Only use counters ticking at a constant rate whatever the
+	// frequency scaling and sleep states (invariant TSC).
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx)
+	    || !(edx & (1u << 8)))
+	  return;
+
+	boost::uint64_t startTime = steadyNow ();
+	boost::uint64_t startTicks = __rdtsc ();
+	boost::uint64_t time, ticks;
+	do
+	  {
+	    time = steadyNow ();
+	    ticks = __rdtsc ();
+	  }
+	while (time - startTime < calibrationTime);
+	if (ticks <= startTicks)
+	  return;
+
+	tsc.baseTicks = startTicks;
+	tsc.baseTime = startTime;
+	tsc.nanosecondsPerTick =
+	  (double) (time - startTime) / (double) (ticks - startTicks);
+	tsc.available = true;
+#endif // HPP_UTIL_HAVE_TSC
+      }
+    } // end of anonymous namespace.
+
+    boost::uint64_t
+    steadyNow ()
+    {
+#if defined HAVE_UNISTD_H && defined CLOCK_MONOTONIC
+      timespec ts;
+      clock_gettime (CLOCK_MONOTONIC, &ts);
+      return (boost::uint64_t) ts.tv_sec * 1000000000u
+	+ (boost::uint64_t) ts.tv_nsec;
+#else
+      using namespace boost::posix_time;
+      static const ptime epoch = microsec_clock::universal_time ();
+      return (boost::uint64_t)
+	(microsec_clock::universal_time () - epoch).total_microseconds ()
+	* 1000u;
+#endif // HAVE_UNISTD_H && CLOCK_MONOTONIC
+    }
+
+    boost::uint64_t
+    tscNow ()
+    {
+#ifdef HPP_UTIL_HAVE_TSC
+      boost::call_once (tscOnce, &calibrate);
+      if (tsc.available)
+	return tsc.baseTime + (boost::uint64_t)
+	  ((double) (__rdtsc () - tsc.baseTicks) * tsc.nanosecondsPerTick);
+#endif // HPP_UTIL_HAVE_TSC
+      return steadyNow ();
+    }
+
+    boost::uint64_t
+    threadCpuNow ()
+    {
+#if defined HAVE_UNISTD_H && defined CLOCK_THREAD_CPUTIME_ID
+      timespec ts;
+      clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+      return (boost::uint64_t) ts.tv_sec * 1000000000u
+	+ (boost::uint64_t) ts.tv_nsec;
+#else
+      // Process CPU time is the best approximation available.
+      return (boost::uint64_t) std::clock ()
+	* (1000000000u / CLOCKS_PER_SEC);
+#endif // HAVE_UNISTD_H && CLOCK_THREAD_CPUTIME_ID
+    }
+
+    boost::uint64_t
+    clockNow (ClockSource source)
+    {
+      switch (source)
+	{
+	case TSC_CLOCK:
+	  return tscNow ();
+	case THREAD_CPU_CLOCK:
+	  return threadCpuNow ();
+	case STEADY_CLOCK:
+	  break;
+	}
+      return steadyNow ();
+    }
+
+    bool
+    isTscAvailable ()
+    {
+      boost::call_once (tscOnce, &calibrate);
+      return tsc.available;
+    }
+
+    double
+    calibrateTsc ()
+    {
+      if (!isTscAvailable ())
+	return 0;
+      return 1e9 / tsc.nanosecondsPerTick;
+    }
+  } // end of namespace debug
+} // end of namespace hpp
@@ -17,7 +17,10 @@
 
 #include "config.h"
 
+#include <algorithm>
+#include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -27,8 +30,18 @@
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
 
+#include "hpp/util/assertion.hh"
+#include "hpp/util/clock.hh"
 #include "hpp/util/indent.hh"
 #include "hpp/util/debug.hh"
+#include "hpp/util/exception-telemetry.hh"
+#include "hpp/util/flight-recorder.hh"
+#include "hpp/util/latency-statistics.hh"
+#include "hpp/util/profiler.hh"
+#include "hpp/util/watchdog.hh"
+
+#include "async-writer.hh"
+#include "threaded-writer.hh"
 
 #ifndef HPP_LOGGINGDIR
 # error "Please define HPP_LOGGINGDIR to the default logging prefix."
@@ -104,10 +117,148 @@ namespace hpp
     }
 
     Output::Output ()
+      : asyncWriter_ (0),
+	enabled_ (true),
+	flushPolicy_ (FLUSH_ALWAYS),
+	flushThreshold_ (0),
+	unflushedSize_ (0),
+	lastFlush_ (0),
+	urgentChannels_ (),
+	channels_ ()
     {}
 
     Output::~Output ()
-    {}
+    {
+      setSynchronous ();
+      while (!channels_.empty ())
+	channels_.back ()->unsubscribe (this);
+    }
+
+    void
+    Output::setEnabled (bool enabled)
+    {
+      enabled_.store (enabled);
+      BOOST_FOREACH (Channel* c, channels_)
+	c->update ();
+    }
+
+    bool
+    Output::isEnabled () const
+    {
+      return enabled_.load (boost::memory_order_relaxed);
+    }
+
+    void
+    Output::writeBinary (const Channel& channel,
+			 const CallSite& site,
+			 const BinaryRecord& record)
+    {
+      ScopedFormatStream data;
+      record.print (data.stream ());
+      write (channel, site.file (), site.line (), site.function (),
+	     data.str ());
+    }
+
+    void
+    Output::flush ()
+    {
+      if (asyncWriter_)
+	asyncWriter_->flush ();
+    }
+
+    void
+    Output::setSynchronous ()
+    {
+      delete asyncWriter_;
+      asyncWriter_ = 0;
+    }
+
+    bool
+    Output::isAsynchronous () const
+    {
+      return asyncWriter_;
+    }
+
+    unsigned long long
+    Output::droppedRecords () const
+    {
+      return asyncWriter_ ? asyncWriter_->dropped () : 0;
+    }
+
+    void
+    Output::setFlushPolicy (FlushPolicy policy, boost::uint64_t threshold)
+    {
+      flushPolicy_ = policy;
+      flushThreshold_ = threshold;
+      unflushedSize_ = 0;
+      lastFlush_ = steadyNow ();
+    }
+
+    Output::FlushPolicy
+    Output::flushPolicy () const
+    {
+      return flushPolicy_;
+    }
+
+    void
+    Output::setUrgent (const Channel& channel, bool urgent)
+    {
+      urgentChannels_.erase
+	(std::remove (urgentChannels_.begin (), urgentChannels_.end (),
+		      &channel),
+	 urgentChannels_.end ());
+      if (urgent)
+	urgentChannels_.push_back (&channel);
+    }
+
+    bool
+    Output::shouldFlush (const Channel& channel, std::size_t size)
+    {
+      unflushedSize_ += size;
+      bool flush = false;
+      switch (flushPolicy_)
+	{
+	case FLUSH_ALWAYS:
+	  flush = true;
+	  break;
+	case FLUSH_ON_SIZE:
+	  flush = unflushedSize_ >= flushThreshold_;
+	  break;
+	case FLUSH_ON_INTERVAL:
+	  flush = steadyNow () - lastFlush_ >= flushThreshold_ * 1000000;
+	  break;
+	case FLUSH_ON_SEVERITY:
+	  break;
+	}
+      flush = flush
+	|| std::find (urgentChannels_.begin (), urgentChannels_.end (),
+		      &channel) != urgentChannels_.end ();
+
+      if (flush)
+	{
+	  unflushedSize_ = 0;
+	  if (flushPolicy_ == FLUSH_ON_INTERVAL)
+	    lastFlush_ = steadyNow ();
+	}
+      return flush;
+    }
+
+    void
+    Output::startAsynchronous (std::ostream& stream,
+			       std::size_t capacity,
+			       OverflowPolicy policy)
+    {
+      setSynchronous ();
+      stream.flush ();
+      asyncWriter_ = new AsyncWriter (stream, capacity, policy);
+    }
+
+    void
+    Output::push (boost::string_ref record)
+    {
+      assert (asyncWriter_);
+      asyncWriter_->push (record);
+    }
 
     std::ostream&
     Output::writePrefix (std::ostream& stream,
@@ -127,11 +278,73 @@ namespace hpp
     Channel::Channel (const char* label,
 		      const subscribers_t& subscribers)
       : label_ (label),
-	subscribers_ (subscribers)
-    {}
+	subscribers_ (),
+	userEnabled_ (true),
+	enabled_ (false)
+    {
+      BOOST_FOREACH (Output* o, subscribers)
+	subscribe (o);
+      update ();
+    }
 
     Channel::~Channel ()
-    {}
+    {
+      while (!subscribers_.empty ())
+	unsubscribe (subscribers_.back ());
+    }
+
+    void
+    Channel::subscribe (Output* output)
+    {
+      if (!output
+	  || std::find (subscribers_.begin (), subscribers_.end (), output)
+	  != subscribers_.end ())
+	return;
+      subscribers_.push_back (output);
+      output->channels_.push_back (this);
+      update ();
+    }
+
+    void
+    Channel::unsubscribe (Output* output)
+    {
+      subscribers_.erase
+	(std::remove (subscribers_.begin (), subscribers_.end (), output),
+	 subscribers_.end ());
+      if (output)
+	output->channels_.erase
+	  (std::remove (output->channels_.begin (),
+			output->channels_.end (), this),
+	   output->channels_.end ());
+      update ();
+    }
+
+    void
+    Channel::setEnabled (bool enabled)
+    {
+      userEnabled_ = enabled;
+      update ();
+    }
+
+    void
+    Channel::update ()
+    {
+      bool enabled = false;
+      if (userEnabled_)
+	{
+	  BOOST_FOREACH (Output* o, subscribers_)
+	    enabled = enabled || o->isEnabled ();
+	}
+      enabled_.store (enabled);
+    }
+
+    void
+    Channel::write (const CallSite& site, const BinaryRecord& record)
+    {
+      BOOST_FOREACH (Output* o, subscribers_)
+	if (o->isEnabled ())
+	  o->writeBinary (*this, site, record);
+    }
 
     const char*
     Channel::label () const
@@ -139,33 +352,90 @@ namespace hpp
       return label_;
     }
 
+    const Channel::subscribers_t&
+    Channel::subscribers () const
+    {
+      return subscribers_;
+    }
+
     void
     Channel::write (char const* file,
 		    int line,
 		    char const* function,
-		    const std::string& data)
+		    boost::string_ref data)
     {
       BOOST_FOREACH (Output* o, subscribers_)
-	if (o)
+	if (o->isEnabled ())
 	  o->write (*this, file, line, function, data);
     }
 
 
     ConsoleOutput::ConsoleOutput ()
+      : pending_ (),
+	mutex_ ()
     {}
 
     ConsoleOutput::~ConsoleOutput ()
-    {}
+    {
+      setSynchronous ();
+      flush ();
+    }
 
     void
     ConsoleOutput::write (const Channel& channel,
 			  char const* file,
 			  int line,
 			  char const* function,
-			  const std::string& data)
+			  boost::string_ref data)
+    {
+      ScopedFormatStream record;
+      writePrefix (record.stream (), channel, file, line, function);
+      record.stream () << data;
+      boost::string_ref text = record.str ();
+      if (isAsynchronous ())
+	{
+	  push (text);
+	  return;
+	}
+
+      boost::lock_guard<boost::mutex> lock (mutex_);
+      if (pending_.empty () && flushPolicy () == FLUSH_ALWAYS)
+	{
+	  // Nothing to gather, write the record directly.
+	  std::cerr.write (text.data (), (std::streamsize) text.size ());
+	  return;
+	}
+
+      // Gather records so that a flush is a single write.
+      pending_.append (text.data (), text.size ());
+      if (shouldFlush (channel, text.size ()))
+	writePending ();
+    }
+
+    void
+    ConsoleOutput::setAsynchronous (std::size_t capacity,
+				    OverflowPolicy policy)
     {
-      writePrefix (std::cerr, channel, file, line, function);
-      std::cerr << incindent << data << decindent << std::flush;
+      flush ();
+      startAsynchronous (std::cerr, capacity, policy);
+    }
+
+    void
+    ConsoleOutput::flush ()
+    {
+      Output::flush ();
+      boost::lock_guard<boost::mutex> lock (mutex_);
+      writePending ();
+    }
+
+    void
+    ConsoleOutput::writePending ()
+    {
+      if (pending_.empty ())
+	return;
+      std::cerr.write (pending_.data (), (std::streamsize) pending_.size ());
+      std::cerr.flush ();
+      pending_.clear ();
     }
 
     namespace
@@ -182,14 +452,18 @@ namespace hpp
       : filename (filename),
 	lastFunction (),
 #ifdef HPP_DEBUG
-      stream (makeLogFile (*this).c_str ())
+      stream (makeLogFile (*this).c_str ()),
 #else
-      stream ()
+      stream (),
 #endif
+      threadedWriter_ (0)
     {}
 
     JournalOutput::~JournalOutput ()
-    {}
+    {
+      // The writer thread must be stopped before the stream is closed.
+      setSynchronous ();
+    }
 
     // package name is set to ``hpp'' here so that
     // the journal can be shared between all hpp packages.
@@ -205,34 +479,254 @@ namespace hpp
       return debug::getFilename (fmter.str (), packageName);
     }
 
+    void
+    JournalOutput::setAsynchronous (std::size_t capacity,
+				    OverflowPolicy policy)
+    {
+      setSynchronous ();
+      open ();
+      startAsynchronous (stream, capacity, policy);
+    }
+
+    void
+    JournalOutput::setThreadAware (ThreadLayout layout,
+				   std::size_t capacity)
+    {
+      setSynchronous ();
+      open ();
+      stream.flush ();
+      threadedWriter_ = new ThreadedWriter
+	(stream, getFilename (), layout == SHARDED, capacity);
+    }
+
+    bool
+    JournalOutput::isThreadAware () const
+    {
+      return threadedWriter_;
+    }
+
+    void
+    JournalOutput::setSynchronous ()
+    {
+      delete threadedWriter_;
+      threadedWriter_ = 0;
+      Output::setSynchronous ();
+    }
+
+    void
+    JournalOutput::open ()
+    {
+      if (!stream.is_open ())
+	stream.open (makeLogFile (*this).c_str ());
+    }
+
+    void
+    JournalOutput::flush ()
+    {
+      if (threadedWriter_)
+	threadedWriter_->flush ();
+      else if (!isAsynchronous ())
+	stream.flush ();
+      Output::flush ();
+    }
+
     void
     JournalOutput::write (const Channel& channel,
 			  char const* file,
 			  int line,
 			  char const* function,
-			  const std::string& data)
+			  boost::string_ref data)
     {
-      if (lastFunction != function)
+      if (threadedWriter_)
+	{
+	  ThreadedWriter::ThreadState& state = threadedWriter_->local ();
+	  state.buffer.clear ();
+	  writeRecord (state.stream, state.lastFunction,
+		       channel, file, line, function, data);
+	  threadedWriter_->push (state);
+	  return;
+	}
+      if (isAsynchronous ())
 	{
-	  if (!lastFunction.empty ())
+	  // Build the whole record, entering/exiting lines included,
+	  // so that it is queued atomically.
+	  ScopedFormatStream record;
+	  writeRecord (record.stream (), lastFunction,
+		       channel, file, line, function, data);
+	  push (record.str ());
+	  return;
+	}
+      open ();
+      // Format the record first: the flush policy counts all the
+      // bytes written, prefix and entering/exiting lines included.
+      ScopedFormatStream record;
+      writeRecord (record.stream (), lastFunction,
+		   channel, file, line, function, data);
+      boost::string_ref text = record.str ();
+      stream.write (text.data (), (std::streamsize) text.size ());
+      if (shouldFlush (channel, text.size ()))
+	stream.flush ();
+    }
+
+    void
+    JournalOutput::writeRecord (std::ostream& out,
+				std::string& previousFunction,
+				const Channel& channel,
+				char const* file,
+				int line,
+				char const* function,
+				boost::string_ref data)
+    {
+      if (previousFunction != function)
+	{
+	  if (!previousFunction.empty ())
 	    {
-	      writePrefix (stream, channel, file, line, function);
-	      stream << "exiting " << lastFunction << iendl;
+	      writePrefix (out, channel, file, line, function);
+	      out << "exiting " << previousFunction << inl;
 	    }
 
-	  writePrefix (stream, channel, file, line, function);
-	  stream << "entering " << function << iendl;
-	  lastFunction = function;
+	  writePrefix (out, channel, file, line, function);
+	  out << "entering " << function << inl;
+	  previousFunction = function;
+	}
+
+      writePrefix (out, channel, file, line, function);
+      out << incindent << data << decindent;
+    }
+
+    bool
+    BinaryJournalOutput::SiteKey::operator< (const SiteKey& other) const
+    {
+      if (channel != other.channel)
+	return channel < other.channel;
+      if (file != other.file)
+	return file < other.file;
+      if (line != other.line)
+	return line < other.line;
+      return function < other.function;
+    }
+
+    BinaryJournalOutput::BinaryJournalOutput (std::string filename)
+      : filename (filename),
+	stream (),
+	mutex_ (),
+	defined_ (),
+	textSites_ ()
+    {}
+
+    BinaryJournalOutput::~BinaryJournalOutput ()
+    {
+      BOOST_FOREACH (textSites_t::value_type& site, textSites_)
+	delete site.second;
+    }
+
+    std::string
+    BinaryJournalOutput::getFilename () const
+    {
+      static const std::string packageName = "hpp";
+
+      boost::format fmter ("%1%.%2%.bin");
+      fmter % filename % getpid ();
+      return debug::getFilename (fmter.str (), packageName);
+    }
+
+    void
+    BinaryJournalOutput::write (const Channel& channel,
+				char const* file,
+				int line,
+				char const* function,
+				boost::string_ref data)
+    {
+      BinaryRecord record;
+      record << data;
+
+      boost::lock_guard<boost::mutex> lock (mutex_);
+      SiteKey key = { &channel, file, line, function };
+      textSites_t::iterator it = textSites_.find (key);
+      if (it == textSites_.end ())
+	it = textSites_.insert
+	  (std::make_pair (key, new CallSite (file, line, function, "")))
+	  .first;
+      writeMessage (channel, *it->second, record.data (), record.size ());
+    }
+
+    void
+    BinaryJournalOutput::writeBinary (const Channel& channel,
+				      const CallSite& site,
+				      const BinaryRecord& record)
+    {
+      boost::lock_guard<boost::mutex> lock (mutex_);
+      writeMessage (channel, site, record.data (), record.size ());
+    }
+
+    namespace
+    {
+      template <typename T>
+      HPP_UTIL_LOCAL void
+      writeValue (std::ostream& stream, const T& value)
+      {
+	stream.write (reinterpret_cast<const char*> (&value), sizeof (T));
+      }
+
+      HPP_UTIL_LOCAL void
+      writeString (std::ostream& stream, const char* value)
+      {
+	boost::uint32_t length = (boost::uint32_t) std::strlen (value);
+	writeValue (stream, length);
+	stream.write (value, length);
+      }
+    } // end of anonymous namespace.
+
+    void
+    BinaryJournalOutput::writeMessage (const Channel& channel,
+				       const CallSite& site,
+				       const char* data,
+				       std::size_t size)
+    {
+      if (!stream.is_open ())
+	{
+	  stream.open (getFilename ().c_str (),
+		       std::ios_base::out | std::ios_base::binary);
+	  stream << HPP_UTIL_BINARY_JOURNAL_MAGIC;
 	}
 
-      writePrefix (stream, channel, file, line, function);
-      stream << incindent << data << decindent << std::flush;
+      boost::uint32_t id = site.id ();
+      if (defined_.size () <= id)
+	defined_.resize (id + 1, false);
+      if (!defined_[id])
+	{
+	  boost::int32_t line = site.line ();
+	  stream.put (ENTRY_SITE);
+	  writeValue (stream, id);
+	  writeValue (stream, line);
+	  writeString (stream, channel.label ());
+	  writeString (stream, site.file ());
+	  writeString (stream, site.function ());
+	  writeString (stream, site.format ());
+	  defined_[id] = true;
+	}
+
+      boost::uint64_t timestamp = steadyNow ();
+      boost::uint32_t length = (boost::uint32_t) size;
+      stream.put (ENTRY_MESSAGE);
+      writeValue (stream, id);
+      writeValue (stream, timestamp);
+      writeValue (stream, length);
+      stream.write (data, (std::streamsize) size);
+    }
+
+    void
+    BinaryJournalOutput::flush ()
+    {
+      boost::lock_guard<boost::mutex> lock (mutex_);
+      stream.flush ();
     }
 
     Logging::Logging ()
       : console (),
 	journal ("journal"),
 	benchmarkJournal ("benchmark"),
+	binaryJournal ("journal"),
 	error
 	("ERROR", boost::assign::list_of<Output*> (&journal) (&console)),
 	warning
@@ -243,10 +737,59 @@ namespace hpp
 	("INFO", boost::assign::list_of<Output*> (&journal)),
 	benchmark
 	("BENCHMARK", boost::assign::list_of<Output*> (&benchmarkJournal))
-    {}
+    {
+      console.setUrgent (error);
+      journal.setUrgent (error);
+    }
 
     Logging::~Logging ()
-    {}
+    {
+      Watchdog::stop ();
+      Deadline::logSummary ();
+      RateLimiter::logSummary ();
+      ExceptionTelemetry::logSummary ();
+      LatencyStatistics::logAll ();
+      if (Profiler::reportAtExit ())
+	Profiler::logReport ();
+      Assertion::logProfile ();
+      flush ();
+    }
+
+    void
+    Logging::flush ()
+    {
+      console.flush ();
+      journal.flush ();
+      benchmarkJournal.flush ();
+      binaryJournal.flush ();
+    }
+
+    void
+    Logging::fatal ()
+    {
+      flush ();
+      FlightRecorderOutput::dumpAll ();
+    }
+
+    void
+    Logging::setBinaryJournal (bool binary)
+    {
+      Output* from = &journal;
+      Output* to = &binaryJournal;
+      if (!binary)
+	std::swap (from, to);
+
+      Channel* channels[] = { &error, &warning, &notice, &info };
+      BOOST_FOREACH (Channel* channel, channels)
+	{
+	  const Channel::subscribers_t& subscribers = channel->subscribers ();
+	  if (std::find (subscribers.begin (), subscribers.end (), from)
+	      == subscribers.end ())
+	    continue;
+	  channel->unsubscribe (from);
+	  channel->subscribe (to);
+	}
+    }
 
   } // end of namespace debug.
 
@@ -0,0 +1,304 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+#include <boost/atomic.hpp>
+#include <boost/format.hpp>
+
+#include "hpp/util/clock.hh"
+#include "hpp/util/debug.hh"
+#include "hpp/util/exception.hh"
+#include "hpp/util/exception-telemetry.hh"
+#include "hpp/util/indent.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      /// \brief Exceptions of a throw site.
+      ///
+      /// A site is claimed by setting its key, then published by
+      /// setting ready; it is never released.
+      struct HPP_UTIL_LOCAL Site
+      {
+	static const std::size_t fileSize = 128;
+
+	/// \brief Hash of the file, line and type, 0 if free.
+	boost::atomic<boost::uint64_t> key;
+	boost::atomic<bool> ready;
+	/// \brief End of the file name, which may not be static.
+	char file[fileSize];
+	unsigned line;
+	char const* type;
+
+	boost::atomic<boost::uint64_t> count;
+	/// \brief Count at the last report.
+	boost::atomic<boost::uint64_t> reported;
+	/// \brief Time of the last report, 0 until the first exception
+	/// is logged.
+	boost::atomic<boost::uint64_t> reportTime;
+      };
+
+      /// \brief Open addressing table of the sites.
+      ///
+      /// Zero-initialized before any exception can be constructed.
+      Site throwSites[ExceptionTelemetry::capacity];
+      boost::atomic<boost::uint64_t> overflowCount;
+
+#ifdef HPP_LOG_EXCEPTION
+      const bool enabledByDefault = true;
+#else
+      const bool enabledByDefault = false;
+#endif // HPP_LOG_EXCEPTION
+      boost::atomic<bool> toggled;
+
+      /// \brief Summary interval, plus one so that zero is the default.
+      boost::atomic<boost::uint64_t> interval;
+      const boost::uint64_t defaultInterval = 10000000000ull;
+
+      HPP_UTIL_LOCAL void
+      hash (boost::uint64_t& h, char const* s)
+      {
+	for (; *s; ++s)
+	  h = (h ^ (unsigned char) *s) * 1099511628211ull;
+      }
+
+      /// \brief Hash of a throw site, never 0.
+      ///
+      /// Sites are told apart by their hash only.
+      HPP_UTIL_LOCAL boost::uint64_t
+      siteKey (char const* file, unsigned line, char const* type)
+      {
+	boost::uint64_t h = 14695981039346656037ull;
+	hash (h, file);
+	h = (h ^ line) * 1099511628211ull;
+	hash (h, type);
+	return h ? h : 1;
+      }
+
+      /// \brief Find or claim the site of \a key, null if the table
+      /// is full.
+      HPP_UTIL_LOCAL Site*
+      findSite (boost::uint64_t key, const Exception& exception)
+      {
+	for (std::size_t i = 0; i < ExceptionTelemetry::capacity; ++i)
+	  {
+	    Site& site = throwSites[(key + i) % ExceptionTelemetry::capacity];
+	    boost::uint64_t current =
+	      site.key.load (boost::memory_order_relaxed);
+	    if (!current && site.key.compare_exchange_strong (current, key))
+	      {
+		char const* file = exception.file ();
+		std::size_t size = std::strlen (file);
+		if (size >= Site::fileSize)
+		  file += size - Site::fileSize + 1;
+		std::strncpy (site.file, file, Site::fileSize - 1);
+		site.line = exception.line ();
+		site.type = exception.type ();
+		site.ready.store (true, boost::memory_order_release);
+		return &site;
+	      }
+	    if (current == key)
+	      {
+		// Claimed by another thread, wait until it is filled.
+		while (!site.ready.load (boost::memory_order_acquire))
+		  {}
+		return &site;
+	      }
+	  }
+	return 0;
+      }
+
+      /// \brief Log \a exception in full, the \a count th of its site.
+      HPP_UTIL_LOCAL void
+      logException (Site& site, const Exception& exception,
+		    boost::uint64_t count)
+      {
+	if (!logging.info.isEnabled ())
+	  return;
+	ScopedFormatStream record;
+	std::ostream& o = record.stream ();
+	o << site.type;
+	if (count == 1)
+	  o << ", first at this site";
+	o << ": " << exception.message ();
+	if (exception.stackDepth ())
+	  exception.printStackTrace (o << '\n');
+	o << inl;
+	logging.info.write (exception.file (), (int) exception.line (),
+			    __PRETTY_FUNCTION__, record.str ());
+      }
+
+      /// \brief Log the exceptions of \a site since its last report,
+      /// \a elapsed nanoseconds ago.
+      HPP_UTIL_LOCAL void
+      logCount (Site& site, boost::uint64_t elapsed)
+      {
+	boost::uint64_t count = site.count.load ();
+	boost::uint64_t reported = site.reported.exchange (count);
+	if (count <= reported || !logging.info.isEnabled ())
+	  return;
+	ScopedFormatStream record;
+	record.stream ()
+	  << count - reported << ' ' << site.type << " thrown in "
+	  << boost::format ("%.1f") % ((double) elapsed / 1e9) << " s, "
+	  << count << " in total" << inl;
+	logging.info.write (site.file, (int) site.line, __PRETTY_FUNCTION__,
+			    record.str ());
+      }
+
+      struct HPP_UTIL_LOCAL CompareCount
+      {
+	bool operator() (const ExceptionSiteCount& a,
+			 const ExceptionSiteCount& b) const
+	{
+	  return a.count > b.count;
+	}
+      };
+    } // end of anonymous namespace.
+
+    const std::size_t ExceptionTelemetry::capacity;
+
+    void
+    ExceptionTelemetry::setEnabled (bool enabled)
+    {
+      toggled.store (enabled != enabledByDefault);
+    }
+
+    bool
+    ExceptionTelemetry::isEnabled ()
+    {
+      return toggled.load (boost::memory_order_relaxed) != enabledByDefault;
+    }
+
+    void
+    ExceptionTelemetry::setSummaryInterval (boost::uint64_t period)
+    {
+      interval.store (period + 1);
+    }
+
+    boost::uint64_t
+    ExceptionTelemetry::summaryInterval ()
+    {
+      boost::uint64_t period = interval.load (boost::memory_order_relaxed);
+      return period ? period - 1 : defaultInterval;
+    }
+
+    void
+    ExceptionTelemetry::record (const Exception& exception) throw ()
+    {
+      if (!isEnabled ())
+	return;
+      try
+	{
+	  Site* site = findSite (siteKey (exception.file (), exception.line (),
+					  exception.type ()), exception);
+	  if (!site)
+	    {
+	      overflowCount.fetch_add (1, boost::memory_order_relaxed);
+	      return;
+	    }
+	  boost::uint64_t count =
+	    site->count.fetch_add (1, boost::memory_order_relaxed) + 1;
+	  boost::uint64_t period = summaryInterval ();
+	  if (count == 1 || !period)
+	    {
+	      // The first exception opens the first summary interval.
+	      logException (*site, exception, count);
+	      site->reported.store (count);
+	      site->reportTime.store (steadyNow ());
+	      return;
+	    }
+
+	  // The summary is written by the thread switching the interval.
+	  boost::uint64_t last = site->reportTime.load ();
+	  if (!last)
+	    return;
+	  boost::uint64_t now = steadyNow ();
+	  if (now - last >= period
+	      && site->reportTime.compare_exchange_strong (last, now))
+	    logCount (*site, now - last);
+	}
+      catch (...)
+	{}
+    }
+
+    exceptionSiteCounts_t
+    ExceptionTelemetry::sites ()
+    {
+      exceptionSiteCounts_t counts;
+      for (std::size_t i = 0; i < capacity; ++i)
+	{
+	  Site& site = throwSites[i];
+	  if (!site.ready.load (boost::memory_order_acquire))
+	    continue;
+	  ExceptionSiteCount count;
+	  count.file = site.file;
+	  count.line = site.line;
+	  count.type = site.type;
+	  count.count = site.count.load ();
+	  counts.push_back (count);
+	}
+      std::stable_sort (counts.begin (), counts.end (), CompareCount ());
+      return counts;
+    }
+
+    boost::uint64_t
+    ExceptionTelemetry::overflow ()
+    {
+      return overflowCount.load ();
+    }
+
+    std::ostream&
+    ExceptionTelemetry::print (std::ostream& o)
+    {
+      exceptionSiteCounts_t counts = sites ();
+      o << "exceptions by throw site\n"
+	<< boost::format ("%12s  %s") % "count" % "site" << '\n';
+      for (std::size_t i = 0; i < counts.size (); ++i)
+	o << boost::format ("%12u  %s at %s:%u")
+	  % counts[i].count % counts[i].type % counts[i].file % counts[i].line
+	  << '\n';
+      boost::uint64_t overflow = ExceptionTelemetry::overflow ();
+      if (overflow)
+	o << boost::format ("%12u  %s") % overflow % "in other sites" << '\n';
+      return o;
+    }
+
+    void
+    ExceptionTelemetry::logSummary ()
+    {
+      boost::uint64_t now = steadyNow ();
+      for (std::size_t i = 0; i < capacity; ++i)
+	{
+	  Site& site = throwSites[i];
+	  if (!site.ready.load (boost::memory_order_acquire))
+	    continue;
+	  boost::uint64_t last = site.reportTime.exchange (now);
+	  if (last)
+	    logCount (site, now - last);
+	}
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
@@ -8,65 +8,384 @@
 //
 // See the COPYING file for more information.
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <new>
+#include <string>
+
+#include <boost/atomic.hpp>
 #include <boost/format.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#if defined HAVE_EXECINFO_H && defined HAVE_DLFCN_H
+# include <dlfcn.h>
+# include <execinfo.h>
+# define HPP_UTIL_STACK_TRACE 1
+#endif // HAVE_EXECINFO_H && HAVE_DLFCN_H
 
-#ifdef HPP_LOG_EXCEPTION
-# include "hpp/util/debug.hh"
-#endif // HPP_LOG_EXCEPTION
+#ifdef __GNUC__
+# include <cxxabi.h>
+#endif // __GNUC__
 
 #include "hpp/util/exception.hh"
+#include "hpp/util/exception-telemetry.hh"
 
 namespace hpp
 {
+  /// \brief Immutable message shared by the copies of an exception.
+  ///
+  /// Allocated with malloc, so that failures do not throw, along with
+  /// the stack frames, the message text and the copied file name if
+  /// any.
+  struct Exception::Message
+  {
+    boost::atomic<std::size_t> references;
+    /// \brief Formatted by the first call to what ().
+    boost::atomic<char*> what;
+    std::size_t depth;
+    std::size_t size;
+
+    void** frames ()
+    {
+      return reinterpret_cast<void**> (this + 1);
+    }
+
+    char* text ()
+    {
+      return reinterpret_cast<char*> (frames () + depth);
+    }
+
+    void acquire ()
+    {
+      references.fetch_add (1, boost::memory_order_relaxed);
+    }
+
+    void release ()
+    {
+      if (references.fetch_sub (1, boost::memory_order_release) != 1)
+	return;
+      boost::atomic_thread_fence (boost::memory_order_acquire);
+      std::free (what.load (boost::memory_order_relaxed));
+      this->~Message ();
+      std::free (this);
+    }
+  };
+
+  namespace
+  {
+    /// \brief Returned if the message could not be allocated, and
+    /// type of the exceptions not defined by HPP_MAKE_EXCEPTION.
+    char const* const noMessage = "hpp::Exception";
+
+    boost::atomic<bool> stackTraceEnabled;
+
+    /// \brief Frames of the exception constructor itself, not
+    /// captured.
+    ///
+    /// initialize is not inlined and the constructors keep their
+    /// frame (see keepFrame), so that they are always two.
+    const int skippedFrames = 2;
+
+    /// \brief Prevent the constructor calling initialize from
+    /// jumping to it, which would remove the constructor frame.
+    HPP_UTIL_LOCAL inline void
+    keepFrame ()
+    {
+#ifdef __GNUC__
+      asm volatile ("");
+#endif // __GNUC__
+    }
+
+#ifdef HPP_UTIL_STACK_TRACE
+    /// \brief Demangled name of the function starting at \a address.
+    ///
+    /// Names are cached: exceptions are often thrown from the same
+    /// functions.
+    HPP_UTIL_LOCAL std::string
+    functionName (void const* address, char const* symbol)
+    {
+      typedef std::map<void const*, std::string> names_t;
+      // Never destroyed: exceptions may be printed during static
+      // destruction.
+      static boost::mutex* mutex = new boost::mutex ();
+      static names_t* names = new names_t ();
+      boost::lock_guard<boost::mutex> lock (*mutex);
+      names_t::const_iterator it = names->find (address);
+      if (it != names->end ())
+	return it->second;
+
+      std::string name (symbol);
+# ifdef __GNUC__
+      int status;
+      char* demangled = abi::__cxa_demangle (symbol, 0, 0, &status);
+      if (demangled)
+	{
+	  name = demangled;
+	  std::free (demangled);
+	}
+# endif // __GNUC__
+      (*names)[address] = name;
+      return name;
+    }
+#endif // HPP_UTIL_STACK_TRACE
+  } // end of anonymous namespace.
+
+  const std::size_t Exception::maxStackDepth;
+
+  Exception::Exception (const std::string& message,
+			char const* file,
+			unsigned line) throw ()
+    : std::exception (),
+      message_ (0),
+      file_ (file ? file : ""),
+      line_ (line),
+      type_ (noMessage)
+  {
+    initialize (message, 0, 0);
+    keepFrame ();
+  }
+
   Exception::Exception (const std::string& message,
 			const std::string& file,
 			unsigned line) throw ()
     : std::exception (),
-      message_ (message),
-      file_ (file),
-      line_ (line)
+      message_ (0),
+      file_ (""),
+      line_ (line),
+      type_ (noMessage)
+  {
+    initialize (message, file.c_str (), file.size ());
+    keepFrame ();
+  }
+
+  Exception::Exception (const std::string& message,
+			char const* file,
+			unsigned line,
+			char const* type) throw ()
+    : std::exception (),
+      message_ (0),
+      file_ (file ? file : ""),
+      line_ (line),
+      type_ (type)
+  {
+    initialize (message, 0, 0);
+    keepFrame ();
+  }
+
+  Exception::Exception (const std::string& message,
+			const std::string& file,
+			unsigned line,
+			char const* type) throw ()
+    : std::exception (),
+      message_ (0),
+      file_ (""),
+      line_ (line),
+      type_ (type)
+  {
+    initialize (message, file.c_str (), file.size ());
+    keepFrame ();
+  }
+
+#ifdef __GNUC__
+  __attribute__ ((noinline))
+#endif // __GNUC__
+  void
+  Exception::initialize (const std::string& message,
+			 char const* file,
+			 std::size_t fileSize) throw ()
   {
+    void* frames[maxStackDepth + skippedFrames];
+    std::size_t depth = 0;
+#ifdef HPP_UTIL_STACK_TRACE
+    if (stackTraceEnabled.load (boost::memory_order_relaxed))
+      {
+	int captured = backtrace (frames, (int) maxStackDepth + skippedFrames);
+	if (captured > skippedFrames)
+	  depth = (std::size_t) (captured - skippedFrames);
+      }
+#endif // HPP_UTIL_STACK_TRACE
+
+    std::size_t size = message.size ();
+    void* memory = std::malloc (sizeof (Message) + depth * sizeof (void*)
+				+ size + 1 + (file ? fileSize + 1 : 0));
+    if (memory)
+      {
+	message_ = new (memory) Message ();
+	message_->references.store (1, boost::memory_order_relaxed);
+	message_->what.store (0, boost::memory_order_relaxed);
+	message_->depth = depth;
+	message_->size = size;
+	std::memcpy (message_->frames (), frames + skippedFrames,
+		     depth * sizeof (void*));
+	char* text = message_->text ();
+	std::memcpy (text, message.data (), size);
+	text[size] = 0;
+	if (file)
+	  {
+	    char* copy = text + size + 1;
+	    std::memcpy (copy, file, fileSize);
+	    copy[fileSize] = 0;
+	    file_ = copy;
+	  }
+      }
+
     // Allow to transparently log created exceptions.
-#ifdef HPP_LOG_EXCEPTION
-    hppDout (info, *this);
-#endif // HPP_LOG_EXCEPTION
+    debug::ExceptionTelemetry::record (*this);
   }
 
   Exception::~Exception () throw ()
-  {}
+  {
+    if (message_)
+      message_->release ();
+  }
 
   Exception::Exception (const Exception& exception) throw ()
     : std::exception (),
       message_ (exception.message_),
       file_ (exception.file_),
-      line_ (exception.line_)
-  {}
+      line_ (exception.line_),
+      type_ (exception.type_)
+  {
+    if (message_)
+      message_->acquire ();
+  }
 
   Exception&
   Exception::operator= (const Exception& exception) throw ()
   {
-    if (&exception == this)
-      return *this;
+    if (exception.message_)
+      exception.message_->acquire ();
+    if (message_)
+      message_->release ();
 
     message_ = exception.message_;
     file_  = exception.file_;
     line_  = exception.line_;
+    type_  = exception.type_;
     return *this;
   }
 
   const char*
   Exception::what () const throw ()
   {
-    //FIXME: display line and file too.
-    return message_.c_str ();
+    if (!message_)
+      return noMessage;
+    char* what = message_->what.load (boost::memory_order_acquire);
+    if (what)
+      return what;
+
+    // Format "file:line: message"; concurrent callers may format it
+    // twice, only one result is kept.
+    char line[16];
+    int lineSize = std::sprintf (line, ":%u: ", line_);
+    std::size_t fileSize = std::strlen (file_);
+    what = static_cast<char*>
+      (std::malloc (fileSize + (std::size_t) lineSize + message_->size + 1));
+    if (!what)
+      return message_->text ();
+    std::memcpy (what, file_, fileSize);
+    std::memcpy (what + fileSize, line, (std::size_t) lineSize);
+    std::memcpy (what + fileSize + lineSize, message_->text (),
+		 message_->size + 1);
+
+    char* expected = 0;
+    if (!message_->what.compare_exchange_strong
+	(expected, what, boost::memory_order_acq_rel))
+      {
+	std::free (what);
+	return expected;
+      }
+    return what;
+  }
+
+  char const*
+  Exception::message () const throw ()
+  {
+    return message_ ? message_->text () : noMessage;
+  }
+
+  char const*
+  Exception::file () const throw ()
+  {
+    return file_;
+  }
+
+  unsigned
+  Exception::line () const throw ()
+  {
+    return line_;
+  }
+
+  char const*
+  Exception::type () const throw ()
+  {
+    return type_;
+  }
+
+  std::size_t
+  Exception::stackDepth () const throw ()
+  {
+    return message_ ? message_->depth : 0;
+  }
+
+  std::ostream&
+  Exception::printStackTrace (std::ostream& o) const throw ()
+  {
+    if (!message_)
+      return o;
+    void** frames = message_->frames ();
+    for (std::size_t i = 0; i < message_->depth; ++i)
+      {
+	if (i)
+	  o << '\n';
+	o << boost::format ("#%-2d %p") % i % frames[i];
+#ifdef HPP_UTIL_STACK_TRACE
+	Dl_info info;
+	if (dladdr (frames[i], &info))
+	  {
+	    if (info.dli_sname)
+	      o << " in " << functionName (info.dli_saddr, info.dli_sname)
+		<< boost::format ("+0x%x")
+		% (static_cast<char*> (frames[i])
+		   - static_cast<char*> (info.dli_saddr));
+	    if (info.dli_fname)
+	      o << " from " << info.dli_fname;
+	  }
+#endif // HPP_UTIL_STACK_TRACE
+      }
+    return o;
+  }
+
+  void
+  Exception::setStackTraceEnabled (bool enabled)
+  {
+#ifdef HPP_UTIL_STACK_TRACE
+    // The first call loads the unwinder, which allocates.
+    if (enabled)
+      {
+	void* frame;
+	backtrace (&frame, 1);
+      }
+#endif // HPP_UTIL_STACK_TRACE
+    stackTraceEnabled.store (enabled);
+  }
+
+  bool
+  Exception::isStackTraceEnabled ()
+  {
+    return stackTraceEnabled.load ();
   }
 
   std::ostream&
   Exception::print (std::ostream& o) const throw ()
   {
-    using boost::format;
-    o << (format ("%1%:%2%: %3%") % file_ % line_ % message_);
+    o << what ();
+    if (stackDepth ())
+      printStackTrace (o << '\n');
     return o;
   }
 
@@ -0,0 +1,279 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <sstream>
+
+#include <boost/format.hpp>
+
+#ifdef HAVE_UNISTD_H
+# include <csignal>
+# include <fcntl.h>
+# include <unistd.h>
+#endif // HAVE_UNISTD_H
+
+#ifdef __GNUC__
+# include <cxxabi.h>
+#endif // __GNUC__
+
+#include "hpp/util/exception.hh"
+#include "hpp/util/flight-recorder.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      /// \brief Number of recorders dumped on crash, see
+      /// FlightRecorderOutput.
+      const std::size_t maxRecorders = 16;
+
+      /// \brief Living recorders, reachable from signal handlers.
+      ///
+      /// A fixed array of atomic pointers, as signal handlers can
+      /// neither lock nor allocate.
+      ///
+      /// Globals are zero-initialized before any dynamic
+      /// initialization, so recorders created by static constructors
+      /// of other modules are registered safely.
+      boost::atomic<FlightRecorderOutput*> recorders[maxRecorders];
+      boost::atomic<bool> handlersInstalled;
+      std::terminate_handler previousTerminate = 0;
+
+#ifdef HAVE_UNISTD_H
+      struct sigaction previousSegv;
+      struct sigaction previousAbrt;
+
+      HPP_UTIL_LOCAL void
+      signalHandler (int signal)
+      {
+	FlightRecorderOutput::dumpAll ();
+	// Let the previous action terminate the process.
+	sigaction (signal,
+		   signal == SIGSEGV ? &previousSegv : &previousAbrt, 0);
+	raise (signal);
+      }
+
+      HPP_UTIL_LOCAL bool
+      writeAll (int fd, const char* data, std::size_t size)
+      {
+	while (size)
+	  {
+	    ssize_t written = ::write (fd, data, size);
+	    if (written < 0)
+	      return false;
+	    data += written;
+	    size -= (std::size_t) written;
+	  }
+	return true;
+      }
+#endif // HAVE_UNISTD_H
+
+      /// \brief Record the uncaught exception, if any, and dump.
+      HPP_UTIL_LOCAL void
+      terminateHandler ()
+      {
+	std::ostringstream record;
+#ifdef __GNUC__
+	// Only rethrow if there is an exception: the handler may be
+	// called by std::terminate directly.
+	if (abi::__cxa_current_exception_type ())
+	  try
+	    {
+	      throw;
+	    }
+	  catch (const ::hpp::Exception& exception)
+	    {
+	      record << "uncaught exception: " << exception << std::endl;
+	    }
+	  catch (...)
+	    {
+	    }
+#endif // __GNUC__
+	const std::string& text = record.str ();
+	for (std::size_t i = 0; i < maxRecorders; ++i)
+	  {
+	    FlightRecorderOutput* recorder = recorders[i].load ();
+	    if (recorder)
+	      recorder->append (text.data (), text.size ());
+	  }
+
+	FlightRecorderOutput::dumpAll ();
+	if (previousTerminate)
+	  previousTerminate ();
+	std::abort ();
+      }
+
+      HPP_UTIL_LOCAL void
+      installHandlers ()
+      {
+	if (handlersInstalled.exchange (true))
+	  return;
+	previousTerminate = std::set_terminate (&terminateHandler);
+#ifdef HAVE_UNISTD_H
+	struct sigaction action;
+	std::memset (&action, 0, sizeof (action));
+	action.sa_handler = &signalHandler;
+	sigemptyset (&action.sa_mask);
+	sigaction (SIGSEGV, &action, &previousSegv);
+	sigaction (SIGABRT, &action, &previousAbrt);
+#endif // HAVE_UNISTD_H
+      }
+    } // end of anonymous namespace.
+
+    FlightRecorderOutput::FlightRecorderOutput (std::string filename,
+						std::size_t capacity)
+      : filename (filename),
+	path_ (),
+	buffer_ (std::max (capacity, (std::size_t) 1)),
+	head_ (0)
+    {
+      path_ = getFilename ();
+      for (std::size_t i = 0; i < maxRecorders; ++i)
+	{
+	  FlightRecorderOutput* expected = 0;
+	  if (recorders[i].compare_exchange_strong (expected, this))
+	    break;
+	}
+      installHandlers ();
+    }
+
+    FlightRecorderOutput::~FlightRecorderOutput ()
+    {
+      for (std::size_t i = 0; i < maxRecorders; ++i)
+	{
+	  FlightRecorderOutput* expected = this;
+	  if (recorders[i].compare_exchange_strong (expected, 0))
+	    break;
+	}
+    }
+
+    std::string
+    FlightRecorderOutput::getFilename () const
+    {
+      static const std::string packageName = "hpp";
+#ifdef HAVE_UNISTD_H
+      int pid = getpid ();
+#else
+      int pid = 0;
+#endif // HAVE_UNISTD_H
+
+      boost::format fmter ("%1%.%2%.log");
+      fmter % filename % pid;
+      return debug::getFilename (fmter.str (), packageName);
+    }
+
+    void
+    FlightRecorderOutput::write (const Channel& channel,
+				 char const* file,
+				 int line,
+				 char const* function,
+				 boost::string_ref data)
+    {
+      ScopedFormatStream record;
+      writePrefix (record.stream (), channel, file, line, function);
+      record.stream () << data;
+      boost::string_ref text = record.str ();
+      append (text.data (), text.size ());
+    }
+
+    void
+    FlightRecorderOutput::append (const char* data, std::size_t size)
+    {
+      const std::size_t capacity = buffer_.size ();
+      // Only the end of a record larger than the ring would survive.
+      if (size > capacity)
+	{
+	  data += size - capacity;
+	  size = capacity;
+	}
+
+      std::size_t offset =
+	(std::size_t) (head_.fetch_add (size) % capacity);
+      std::size_t first = std::min (size, capacity - offset);
+      std::memcpy (&buffer_[offset], data, first);
+      std::memcpy (&buffer_[0], data + first, size - first);
+    }
+
+    bool
+    FlightRecorderOutput::dump () const
+    {
+      const std::size_t capacity = buffer_.size ();
+      boost::uint64_t head = head_.load ();
+      const char* base = &buffer_[0];
+      // The ring is written as two chunks, oldest bytes first.
+      const char* first = base;
+      const char* firstEnd =
+	base + std::min (head, (boost::uint64_t) capacity);
+      const char* second = base;
+      const char* secondEnd = base;
+      if (head >= capacity)
+	{
+	  // The oldest bytes are right after the newest ones; skip the
+	  // partially overwritten record.
+	  const char* wrap = base + head % capacity;
+	  first = wrap;
+	  firstEnd = base + capacity;
+	  secondEnd = wrap;
+	  const char* newline = std::find (first, firstEnd, '\n');
+	  if (newline != firstEnd)
+	    first = newline + 1;
+	  else
+	    {
+	      newline = std::find (second, secondEnd, '\n');
+	      if (newline != secondEnd)
+		{
+		  first = firstEnd;
+		  second = newline + 1;
+		}
+	    }
+	}
+
+#ifdef HAVE_UNISTD_H
+      int fd = open (path_.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0)
+	return false;
+      bool success = writeAll (fd, first, (std::size_t) (firstEnd - first))
+	&& writeAll (fd, second, (std::size_t) (secondEnd - second));
+      return close (fd) == 0 && success;
+#else
+      std::FILE* file = std::fopen (path_.c_str (), "wb");
+      if (!file)
+	return false;
+      std::fwrite (first, 1, (std::size_t) (firstEnd - first), file);
+      std::fwrite (second, 1, (std::size_t) (secondEnd - second), file);
+      return std::fclose (file) == 0;
+#endif // HAVE_UNISTD_H
+    }
+
+    void
+    FlightRecorderOutput::dumpAll ()
+    {
+      for (std::size_t i = 0; i < maxRecorders; ++i)
+	{
+	  FlightRecorderOutput* recorder = recorders[i].load ();
+	  if (recorder)
+	    recorder->dump ();
+	}
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
@@ -0,0 +1,158 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/thread/tss.hpp>
+
+#include "hpp/util/format-buffer.hh"
+#include "hpp/util/indent.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      /// \brief Formatting streams of a thread.
+      struct HPP_UTIL_LOCAL FormatStreamStack
+      {
+	FormatStreamStack ()
+	  : streams (),
+	    depth (0)
+	{}
+
+	~FormatStreamStack ()
+	{
+	  for (std::size_t i = 0; i < streams.size (); ++i)
+	    delete streams[i];
+	}
+
+	std::vector<FormatStream*> streams;
+	/// \brief Number of streams currently borrowed.
+	std::size_t depth;
+      };
+
+      HPP_UTIL_LOCAL FormatStreamStack&
+      localStack ()
+      {
+	// Never destroyed: logging may happen during static destruction.
+	static boost::thread_specific_ptr<FormatStreamStack>* stacks =
+	  new boost::thread_specific_ptr<FormatStreamStack> ();
+	FormatStreamStack* stack = stacks->get ();
+	if (!stack)
+	  {
+	    stack = new FormatStreamStack ();
+	    stacks->reset (stack);
+	  }
+	return *stack;
+      }
+
+      HPP_UTIL_LOCAL FormatStream&
+      borrow ()
+      {
+	FormatStreamStack& stack = localStack ();
+	if (stack.depth == stack.streams.size ())
+	  stack.streams.push_back (new FormatStream ());
+	FormatStream& stream = *stack.streams[stack.depth++];
+	stream.reset ();
+	return stream;
+      }
+    } // end of anonymous namespace.
+
+    FormatBuffer::FormatBuffer (std::size_t capacity)
+      : buffer_ (std::max (capacity, (std::size_t) 1))
+    {
+      clear ();
+    }
+
+    void
+    FormatBuffer::clear ()
+    {
+      setp (&buffer_[0], &buffer_[0] + buffer_.size ());
+    }
+
+    void
+    FormatBuffer::reserve (std::size_t size)
+    {
+      std::size_t used = (std::size_t) (pptr () - pbase ());
+      if (used + size <= buffer_.size ())
+	return;
+      buffer_.resize (std::max (2 * buffer_.size (), used + size));
+      setp (&buffer_[0], &buffer_[0] + buffer_.size ());
+      // pbump takes an int: advance in steps for huge records.
+      while (used > 0)
+	{
+	  int step = (int) std::min (used, (std::size_t) 1 << 30);
+	  pbump (step);
+	  used -= (std::size_t) step;
+	}
+    }
+
+    FormatBuffer::int_type
+    FormatBuffer::overflow (int_type c)
+    {
+      if (traits_type::eq_int_type (c, traits_type::eof ()))
+	return traits_type::not_eof (c);
+      reserve (1);
+      *pptr () = traits_type::to_char_type (c);
+      pbump (1);
+      return c;
+    }
+
+    std::streamsize
+    FormatBuffer::xsputn (const char* s, std::streamsize n)
+    {
+      reserve ((std::size_t) n);
+      std::memcpy (pptr (), s, (std::size_t) n);
+      pbump ((int) n);
+      return n;
+    }
+
+    FormatStream::FormatStream ()
+      : std::ostream (0),
+	buffer_ ()
+    {
+      rdbuf (&buffer_);
+    }
+
+    void
+    FormatStream::reset ()
+    {
+      // The state of a new stream. Not read from a shared stream:
+      // std::ios::fill initializes the fill character on first call.
+      buffer_.clear ();
+      std::ostream::clear ();
+      flags (std::ios_base::dec | std::ios_base::skipws);
+      precision (6);
+      width (0);
+      fill (widen (' '));
+      *this << resetindent;
+    }
+
+    ScopedFormatStream::ScopedFormatStream ()
+      : stream_ (borrow ())
+    {}
+
+    ScopedFormatStream::~ScopedFormatStream ()
+    {
+      --localStack ().depth;
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
@@ -51,7 +51,22 @@ namespace hpp
 
   std::ostream& iendl (std::ostream& o)
   {
-    o << std::endl;
+    return o << inl << std::flush;
+  }
+
+  std::ostream& incendl (std::ostream& o)
+  {
+    return o << incindent << iendl;
+  }
+
+  std::ostream& decendl (std::ostream& o)
+  {
+    return o << decindent << iendl;
+  }
+
+  std::ostream& inl (std::ostream& o)
+  {
+    o << '\n';
     // Be sure to be able to restore the stream flags.
     char fill = o.fill (' ');
     return o << std::setw ((int)indent (o))
@@ -59,14 +74,14 @@ namespace hpp
 	     << std::setfill (fill);
   }
 
-  std::ostream& incendl (std::ostream& o)
+  std::ostream& incnl (std::ostream& o)
   {
-    return o << incindent << iendl;
+    return o << incindent << inl;
   }
 
-  std::ostream& decendl (std::ostream& o)
+  std::ostream& decnl (std::ostream& o)
   {
-    return o << decindent << iendl;
+    return o << decindent << inl;
   }
 
 } // end of namespace hpp.
@@ -0,0 +1,282 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+#include <boost/format.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "hpp/util/clock.hh"
+#include "hpp/util/debug.hh"
+#include "hpp/util/latency-statistics.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      /// \brief Head of the list of statistics.
+      ///
+      /// Zero-initialized before any statistics can be created.
+      boost::atomic<LatencyStatistics*> statistics;
+      boost::atomic<boost::uint64_t> interval;
+
+      const boost::uint64_t noSample = (boost::uint64_t) -1;
+
+      /// \brief Index of the most significant bit, \a value > 0.
+      HPP_UTIL_LOCAL std::size_t
+      highestBit (boost::uint64_t value)
+      {
+#ifdef __GNUC__
+	return 63 - (std::size_t) __builtin_clzll (value);
+#else
+	std::size_t bit = 0;
+	while (value >>= 1)
+	  ++bit;
+	return bit;
+#endif // __GNUC__
+      }
+    } // end of anonymous namespace.
+
+    const std::size_t LatencyStatistics::subBucketBits;
+    const std::size_t LatencyStatistics::bucketCount;
+
+    LatencyStatistics&
+    LatencyStatistics::get (const std::string& name)
+    {
+      // Never destroyed: benchmarks may run during static destruction.
+      static boost::mutex* mutex = new boost::mutex ();
+      boost::lock_guard<boost::mutex> lock (*mutex);
+      for (LatencyStatistics* s = statistics.load (); s; s = s->next_)
+	if (s->name_ == name)
+	  return *s;
+
+      LatencyStatistics* s = new LatencyStatistics (name);
+      s->next_ = statistics.load ();
+      statistics.store (s);
+      return *s;
+    }
+
+    LatencyStatistics::LatencyStatistics (const std::string& name)
+      : name_ (name),
+	count_ (0),
+	sum_ (0),
+	sumOfSquares_ (0),
+	min_ (noSample),
+	max_ (0),
+	nextReport_ (0),
+	next_ (0)
+    {
+      for (std::size_t i = 0; i < bucketCount; ++i)
+	buckets_[i].store (0, boost::memory_order_relaxed);
+    }
+
+    std::size_t
+    LatencyStatistics::bucketIndex (boost::uint64_t value)
+    {
+      // Values below 2^(subBucketBits + 1) get a bucket each; above,
+      // the power of two is split in 2^subBucketBits buckets.
+      if (value >> (subBucketBits + 1) == 0)
+	return (std::size_t) value;
+      std::size_t shift = highestBit (value) - subBucketBits;
+      return (shift << subBucketBits) + (std::size_t) (value >> shift);
+    }
+
+    boost::uint64_t
+    LatencyStatistics::bucketStart (std::size_t index)
+    {
+      if (index >> (subBucketBits + 1) == 0)
+	return index;
+      std::size_t shift = (index >> subBucketBits) - 1;
+      return (boost::uint64_t) (index - (shift << subBucketBits)) << shift;
+    }
+
+    void
+    LatencyStatistics::record (boost::uint64_t duration)
+    {
+      count_.fetch_add (1, boost::memory_order_relaxed);
+      sum_.fetch_add (duration, boost::memory_order_relaxed);
+      double square = (double) duration * (double) duration;
+      double sumOfSquares = sumOfSquares_.load (boost::memory_order_relaxed);
+      while (!sumOfSquares_.compare_exchange_weak
+	     (sumOfSquares, sumOfSquares + square, boost::memory_order_relaxed))
+	{}
+      boost::uint64_t min = min_.load (boost::memory_order_relaxed);
+      while (duration < min && !min_.compare_exchange_weak
+	     (min, duration, boost::memory_order_relaxed))
+	{}
+      boost::uint64_t max = max_.load (boost::memory_order_relaxed);
+      while (duration > max && !max_.compare_exchange_weak
+	     (max, duration, boost::memory_order_relaxed))
+	{}
+      buckets_[bucketIndex (duration)].fetch_add
+	(1, boost::memory_order_relaxed);
+
+      boost::uint64_t period = interval.load (boost::memory_order_relaxed);
+      if (!period)
+	return;
+      boost::uint64_t now = steadyNow ();
+      boost::uint64_t next = nextReport_.load (boost::memory_order_relaxed);
+      // The first sample only schedules the first report.
+      if (now >= next
+	  && nextReport_.compare_exchange_strong (next, now + period)
+	  && next)
+	log ();
+    }
+
+    const std::string&
+    LatencyStatistics::name () const
+    {
+      return name_;
+    }
+
+    boost::uint64_t
+    LatencyStatistics::count () const
+    {
+      return count_.load ();
+    }
+
+    boost::uint64_t
+    LatencyStatistics::min () const
+    {
+      boost::uint64_t min = min_.load ();
+      return min == noSample ? 0 : min;
+    }
+
+    boost::uint64_t
+    LatencyStatistics::max () const
+    {
+      return max_.load ();
+    }
+
+    double
+    LatencyStatistics::mean () const
+    {
+      boost::uint64_t count = count_.load ();
+      return count ? (double) sum_.load () / (double) count : 0.;
+    }
+
+    double
+    LatencyStatistics::standardDeviation () const
+    {
+      boost::uint64_t count = count_.load ();
+      if (!count)
+	return 0.;
+      double mean = (double) sum_.load () / (double) count;
+      double variance = sumOfSquares_.load () / (double) count - mean * mean;
+      return variance > 0 ? std::sqrt (variance) : 0.;
+    }
+
+    boost::uint64_t
+    LatencyStatistics::percentile (double q) const
+    {
+      // Counts are read one by one: sum them rather than using
+      // count_, which may be ahead.
+      boost::uint64_t total = 0;
+      for (std::size_t i = 0; i < bucketCount; ++i)
+	total += buckets_[i].load (boost::memory_order_relaxed);
+      if (!total)
+	return 0;
+
+      boost::uint64_t rank = (boost::uint64_t)
+	std::ceil (std::min (std::max (q, 0.), 1.) * (double) total);
+      rank = std::max (rank, (boost::uint64_t) 1);
+      boost::uint64_t seen = 0;
+      std::size_t i = 0;
+      for (; i < bucketCount - 1; ++i)
+	{
+	  seen += buckets_[i].load (boost::memory_order_relaxed);
+	  if (seen >= rank)
+	    break;
+	}
+      // Middle of the bucket, within the observed range.
+      boost::uint64_t start = bucketStart (i);
+      boost::uint64_t end = i + 1 < bucketCount ? bucketStart (i + 1) : start;
+      boost::uint64_t value = start + (end - start) / 2;
+      return std::min (std::max (value, min ()), max ());
+    }
+
+    void
+    LatencyStatistics::reset ()
+    {
+      count_.store (0);
+      sum_.store (0);
+      sumOfSquares_.store (0);
+      min_.store (noSample);
+      max_.store (0);
+      for (std::size_t i = 0; i < bucketCount; ++i)
+	buckets_[i].store (0, boost::memory_order_relaxed);
+    }
+
+    std::ostream&
+    LatencyStatistics::print (std::ostream& o) const
+    {
+      // Durations in microseconds.
+      return o << boost::format
+	("%1%: %2% sample(s), min %3$.3f, mean %4$.3f, stddev %5$.3f, "
+	 "max %6$.3f, p50 %7$.3f, p90 %8$.3f, p99 %9$.3f, p99.9 %10$.3f us")
+	% name_ % count ()
+	% ((double) min () * 1e-3) % (mean () * 1e-3)
+	% (standardDeviation () * 1e-3) % ((double) max () * 1e-3)
+	% ((double) percentile (.5) * 1e-3) % ((double) percentile (.9) * 1e-3)
+	% ((double) percentile (.99) * 1e-3)
+	% ((double) percentile (.999) * 1e-3);
+    }
+
+    void
+    LatencyStatistics::log () const
+    {
+      if (!logging.benchmark.isEnabled ())
+	return;
+      ScopedFormatStream record;
+      print (record.stream ()) << inl;
+      logging.benchmark.write (__FILE__, __LINE__, __PRETTY_FUNCTION__,
+			       record.str ());
+    }
+
+    void
+    LatencyStatistics::logAll ()
+    {
+      for (LatencyStatistics* s = statistics.load (); s; s = s->next_)
+	if (s->count ())
+	  s->log ();
+    }
+
+    void
+    LatencyStatistics::setReportInterval (boost::uint64_t period)
+    {
+      interval.store (period);
+    }
+
+    boost::uint64_t
+    LatencyStatistics::reportInterval ()
+    {
+      return interval.load ();
+    }
+
+    std::ostream&
+    operator<< (std::ostream& o, const LatencyStatistics& statistics)
+    {
+      return statistics.print (o);
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
@@ -0,0 +1,365 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#if defined HAVE_UNISTD_H && defined HAVE_SYS_MMAN_H
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <unistd.h>
+# define HPP_UTIL_MAPPED_JOURNAL 1
+#endif // HAVE_UNISTD_H && HAVE_SYS_MMAN_H
+
+#include "hpp/util/mapped-journal.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    struct MappedJournalOutput::Segment
+    {
+      Segment ()
+	: fd (-1),
+	  base (0),
+	  size (0),
+	  path (),
+	  reserved (0),
+	  writers (0),
+	  used (0)
+      {}
+
+      int fd;
+      char* base;
+      std::size_t size;
+      std::string path;
+      /// \brief Bytes reserved by writers, may exceed size.
+      boost::atomic<std::size_t> reserved;
+      /// \brief Writers currently copying into the segment.
+      boost::atomic<int> writers;
+      /// \brief Bytes actually written, known once the segment is full.
+      std::size_t used;
+    };
+
+    MappedJournalOutput::MappedJournalOutput (std::string filename,
+					      std::size_t segmentSize,
+					      std::size_t maxSegments)
+      : filename (filename),
+	segmentSize_ (segmentSize),
+	maxSegments_ (std::max (maxSegments, (std::size_t) 2)),
+	nextIndex_ (0),
+	current_ (0),
+	standby_ (0),
+	dropped_ (0),
+	truncated_ (0),
+	stopping_ (false),
+	failed_ (false),
+	mutex_ (),
+	wakeUpCondition_ (),
+	retired_ (),
+	free_ (),
+	segments_ (),
+	files_ (),
+	thread_ ()
+    {
+      current_.store (createSegment ());
+      thread_ = boost::thread (boost::bind (&MappedJournalOutput::run, this));
+    }
+
+    MappedJournalOutput::~MappedJournalOutput ()
+    {
+      stopping_.store (true);
+      {
+	boost::lock_guard<boost::mutex> lock (mutex_);
+	wakeUpCondition_.notify_one ();
+      }
+      thread_.join ();
+
+      BOOST_FOREACH (Segment* segment, retired_)
+	closeSegment (segment);
+      Segment* segment = current_.exchange (0);
+      if (segment)
+	{
+	  segment->used = std::min (segment->reserved.load (), segment->size);
+	  closeSegment (segment);
+	}
+      segment = standby_.exchange (0);
+      if (segment)
+	{
+	  closeSegment (segment);
+#ifdef HPP_UTIL_MAPPED_JOURNAL
+	  unlink (segment->path.c_str ());
+#endif // HPP_UTIL_MAPPED_JOURNAL
+	}
+      BOOST_FOREACH (Segment* s, segments_)
+	delete s;
+    }
+
+    std::string
+    MappedJournalOutput::getFilename (std::size_t index) const
+    {
+      static const std::string packageName = "hpp";
+#ifdef HPP_UTIL_MAPPED_JOURNAL
+      int pid = getpid ();
+#else
+      int pid = 0;
+#endif // HPP_UTIL_MAPPED_JOURNAL
+
+      boost::format fmter ("%1%.%2%.%3%.log");
+      fmter % filename % pid % index;
+      return debug::getFilename (fmter.str (), packageName);
+    }
+
+    void
+    MappedJournalOutput::write (const Channel& channel,
+				char const* file,
+				int line,
+				char const* function,
+				boost::string_ref data)
+    {
+      ScopedFormatStream record;
+      writePrefix (record.stream (), channel, file, line, function);
+      record.stream () << data;
+      boost::string_ref text = record.str ();
+      append (text.data (), text.size ());
+    }
+
+    void
+    MappedJournalOutput::append (const char* data, std::size_t size)
+    {
+      if (size > segmentSize_)
+	{
+	  size = segmentSize_;
+	  ++truncated_;
+	}
+      for (;;)
+	{
+	  Segment* segment = current_.load ();
+	  if (!segment)
+	    {
+	      ++dropped_;
+	      return;
+	    }
+
+	  // Pin the segment, then check it is still the current one:
+	  // segments are recycled but never freed, so a stale pointer
+	  // is harmless.
+	  ++segment->writers;
+	  if (current_.load () != segment)
+	    {
+	      --segment->writers;
+	      continue;
+	    }
+
+	  std::size_t offset = segment->reserved.fetch_add (size);
+	  // Read while pinned: once unpinned, the segment may be recycled.
+	  std::size_t capacity = segment->size;
+	  if (offset + size <= capacity)
+	    {
+	      std::memcpy (segment->base + offset, data, size);
+	      --segment->writers;
+	      return;
+	    }
+	  --segment->writers;
+
+	  if (offset <= capacity)
+	    {
+	      // This writer crossed the end of the segment.
+	      segment->used = offset;
+	      rotate (segment);
+	    }
+	  else
+	    // Wait for the crossing writer to rotate. The segment may
+	    // have been recycled meanwhile: retry rather than waiting for
+	    // the current segment to change.
+	    boost::this_thread::yield ();
+	}
+    }
+
+    void
+    MappedJournalOutput::rotate (Segment* segment)
+    {
+      Segment* next;
+      // The standby segment is prepared as soon as the previous one
+      // is used: this only waits if segments are filled faster than
+      // they can be created.
+      while (!(next = standby_.exchange (0)))
+	{
+	  if (failed_.load ())
+	    break;
+	  {
+	    boost::lock_guard<boost::mutex> lock (mutex_);
+	    wakeUpCondition_.notify_one ();
+	  }
+	  boost::this_thread::yield ();
+	}
+      current_.store (next);
+
+      boost::lock_guard<boost::mutex> lock (mutex_);
+      retired_.push_back (segment);
+      wakeUpCondition_.notify_one ();
+    }
+
+    void
+    MappedJournalOutput::flush ()
+    {
+#ifdef HPP_UTIL_MAPPED_JOURNAL
+      Segment* segment = current_.load ();
+      if (!segment)
+	return;
+      ++segment->writers;
+      if (current_.load () == segment)
+	msync (segment->base, segment->size, MS_ASYNC);
+      --segment->writers;
+#endif // HPP_UTIL_MAPPED_JOURNAL
+    }
+
+    unsigned long long
+    MappedJournalOutput::droppedRecords () const
+    {
+      return dropped_.load ();
+    }
+
+    unsigned long long
+    MappedJournalOutput::truncatedRecords () const
+    {
+      return truncated_.load ();
+    }
+
+    MappedJournalOutput::Segment*
+    MappedJournalOutput::createSegment ()
+    {
+#ifdef HPP_UTIL_MAPPED_JOURNAL
+      std::string path = getFilename (nextIndex_++);
+      int fd = open (path.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0)
+	return 0;
+      // Allocate the blocks now rather than when writing.
+      if (posix_fallocate (fd, 0, (off_t) segmentSize_) != 0
+	  && ftruncate (fd, (off_t) segmentSize_) != 0)
+	{
+	  close (fd);
+	  unlink (path.c_str ());
+	  return 0;
+	}
+      void* base = mmap (0, segmentSize_, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fd, 0);
+      if (base == MAP_FAILED)
+	{
+	  close (fd);
+	  unlink (path.c_str ());
+	  return 0;
+	}
+      // Touch every page so that writers never fault.
+      long pageSize = sysconf (_SC_PAGESIZE);
+      for (std::size_t i = 0; i < segmentSize_; i += (std::size_t) pageSize)
+	static_cast<volatile char*> (base)[i] = 0;
+
+      Segment* segment;
+      if (free_.empty ())
+	{
+	  segment = new Segment ();
+	  segments_.push_back (segment);
+	}
+      else
+	{
+	  segment = free_.back ();
+	  free_.pop_back ();
+	}
+      segment->fd = fd;
+      segment->base = static_cast<char*> (base);
+      segment->size = segmentSize_;
+      segment->path = path;
+      segment->used = 0;
+      segment->reserved.store (0);
+      files_.push_back (path);
+      return segment;
+#else
+      return 0;
+#endif // HPP_UTIL_MAPPED_JOURNAL
+    }
+
+    void
+    MappedJournalOutput::closeSegment (Segment* segment)
+    {
+#ifdef HPP_UTIL_MAPPED_JOURNAL
+      munmap (segment->base, segment->size);
+      // Drop the unused preallocated tail.
+      if (ftruncate (segment->fd, (off_t) segment->used) != 0)
+	{}
+      close (segment->fd);
+#endif // HPP_UTIL_MAPPED_JOURNAL
+      segment->fd = -1;
+      segment->base = 0;
+      free_.push_back (segment);
+    }
+
+    void
+    MappedJournalOutput::run ()
+    {
+      std::vector<Segment*> retired;
+      for (;;)
+	{
+	  if (!standby_.load () && !failed_.load ())
+	    {
+	      Segment* segment = createSegment ();
+	      if (segment)
+		standby_.store (segment);
+	      else
+		// Records will be dropped once the current segment is full.
+		failed_.store (true);
+	    }
+
+	  {
+	    boost::lock_guard<boost::mutex> lock (mutex_);
+	    retired.swap (retired_);
+	  }
+	  BOOST_FOREACH (Segment* segment, retired)
+	    {
+	      while (segment->writers.load ())
+		boost::this_thread::yield ();
+	      closeSegment (segment);
+	    }
+	  retired.clear ();
+
+	  // The standby segment does not count as a kept segment.
+	  std::size_t kept = maxSegments_ + (standby_.load () ? 1 : 0);
+	  while (files_.size () > kept)
+	    {
+#ifdef HPP_UTIL_MAPPED_JOURNAL
+	      unlink (files_.front ().c_str ());
+#endif // HPP_UTIL_MAPPED_JOURNAL
+	      files_.pop_front ();
+	    }
+
+	  boost::unique_lock<boost::mutex> lock (mutex_);
+	  if (!retired_.empty ())
+	    continue;
+	  if (stopping_.load ())
+	    break;
+	  wakeUpCondition_.timed_wait
+	    (lock, boost::posix_time::milliseconds (100));
+	}
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
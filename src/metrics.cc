@@ -0,0 +1,384 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstring>
+#include <new>
+
+#include <boost/atomic.hpp>
+#include <boost/format.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#if defined HAVE_UNISTD_H && defined HAVE_SYS_MMAN_H
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+// Other processes can only read lock-free atomic values.
+# if BOOST_ATOMIC_INT64_LOCK_FREE == 2 && BOOST_ATOMIC_INT32_LOCK_FREE == 2
+#  define HPP_UTIL_SHARED_METRICS 1
+# endif
+#endif // HAVE_UNISTD_H && HAVE_SYS_MMAN_H
+
+#include "hpp/util/debug.hh"
+#include "hpp/util/format-buffer.hh"
+#include "hpp/util/indent.hh"
+#include "hpp/util/metrics.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    BOOST_STATIC_ASSERT (sizeof (MetricsHeader) == 64);
+    BOOST_STATIC_ASSERT (sizeof (MetricSlot) % 64 == 0);
+
+    namespace
+    {
+      const std::size_t segmentSize =
+	sizeof (MetricsHeader) + Metrics::capacity * sizeof (MetricSlot);
+
+      /// \brief Registry segment, 0 until the first registration.
+      boost::atomic<MetricsHeader*> segment;
+      /// \brief Whether the segment is in shared memory.
+      boost::atomic<bool> shared;
+
+      HPP_UTIL_LOCAL MetricSlot*
+      slots (const MetricsHeader* header)
+      {
+	return reinterpret_cast<MetricSlot*>
+	  (reinterpret_cast<char*> (const_cast<MetricsHeader*> (header))
+	   + sizeof (MetricsHeader));
+      }
+
+      /// \brief Slot of a metric which is not published.
+      ///
+      /// Each unpublished metric has its own slot, never destroyed:
+      /// metrics may be updated during static destruction.
+      HPP_UTIL_LOCAL MetricSlot*
+      unpublished ()
+      {
+	return new (std::memset (new char[sizeof (MetricSlot)], 0,
+				 sizeof (MetricSlot))) MetricSlot ();
+      }
+
+      HPP_UTIL_LOCAL const char*
+      typeName (boost::uint32_t type)
+      {
+	switch (type)
+	  {
+	  case METRIC_COUNTER: return "counter";
+	  case METRIC_GAUGE: return "gauge";
+	  case METRIC_HISTOGRAM: return "histogram";
+	  default: return "metric";
+	  }
+      }
+
+      /// \brief Warn that metric \a name of \a type is not published.
+      HPP_UTIL_LOCAL void
+      reportUnpublished (const std::string& name, MetricType type,
+			 boost::uint32_t registered)
+      {
+	if (!logging.warning.isEnabled ())
+	  return;
+	ScopedFormatStream message;
+	if (registered == METRIC_NONE)
+	  message.stream ()
+	    << boost::format ("%1% \"%2%\" not published: the registry "
+			      "is full (%3% metrics)")
+	    % typeName (type) % name % Metrics::capacity;
+	else
+	  message.stream ()
+	    << boost::format ("%1% \"%2%\" not published: the name is "
+			      "registered as a %3%")
+	    % typeName (type) % name % typeName (registered);
+	message.stream () << inl;
+	logging.warning.write (__FILE__, __LINE__, __PRETTY_FUNCTION__,
+			       message.str ());
+      }
+
+      HPP_UTIL_LOCAL int
+      processId ()
+      {
+#ifdef HAVE_UNISTD_H
+	return getpid ();
+#else
+	return 0;
+#endif // HAVE_UNISTD_H
+      }
+
+      /// \brief Map the segment of this process, in shared memory if
+      /// possible.
+      HPP_UTIL_LOCAL MetricsHeader*
+      createSegment ()
+      {
+	void* base = 0;
+#ifdef HPP_UTIL_SHARED_METRICS
+	std::string name = Metrics::segmentName (processId ());
+	// Left by a previous process with the same identifier.
+	shm_unlink (name.c_str ());
+	int fd = shm_open (name.c_str (), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd >= 0)
+	  {
+	    if (ftruncate (fd, (off_t) segmentSize) == 0)
+	      {
+		base = mmap (0, segmentSize, PROT_READ | PROT_WRITE,
+			     MAP_SHARED, fd, 0);
+		if (base == MAP_FAILED)
+		  base = 0;
+	      }
+	    close (fd);
+	    if (base)
+	      shared.store (true);
+	    else
+	      shm_unlink (name.c_str ());
+	  }
+#endif // HPP_UTIL_SHARED_METRICS
+	if (!base)
+	  base = new char[segmentSize];
+	std::memset (base, 0, segmentSize);
+
+	MetricsHeader* header = new (base) MetricsHeader ();
+	std::memcpy (header->magic, HPP_UTIL_METRICS_MAGIC,
+		     sizeof (HPP_UTIL_METRICS_MAGIC));
+	header->layoutVersion = MetricsHeader::version;
+	header->capacity = Metrics::capacity;
+	header->slotSize = sizeof (MetricSlot);
+	header->pid = (boost::uint32_t) processId ();
+	header->size.store (0);
+	MetricSlot* s = slots (header);
+	for (std::size_t i = 0; i < Metrics::capacity; ++i)
+	  new (s + i) MetricSlot ();
+	return header;
+      }
+
+      /// \brief Slot of metric \a name of \a type, created if needed.
+      HPP_UTIL_LOCAL MetricSlot*
+      find (const std::string& name, MetricType type)
+      {
+	// Never destroyed: metrics may be registered during static
+	// destruction.
+	static boost::mutex* mutex = new boost::mutex ();
+	// Type of the metric registered under name if it is not type.
+	boost::uint32_t registered = METRIC_NONE;
+	{
+	  boost::lock_guard<boost::mutex> lock (*mutex);
+	  MetricsHeader* header = segment.load ();
+	  if (!header)
+	    {
+	      header = createSegment ();
+	      segment.store (header);
+	    }
+
+	  std::string truncated = name.substr (0, MetricSlot::nameSize - 1);
+	  MetricSlot* s = slots (header);
+	  boost::uint32_t size = header->size.load ();
+	  boost::uint32_t i = 0;
+	  for (; i < size; ++i)
+	    if (truncated == s[i].name)
+	      {
+		if (s[i].type == (boost::uint32_t) type)
+		  return s + i;
+		registered = s[i].type;
+		break;
+	      }
+	  if (i == size && size < header->capacity)
+	    {
+	      MetricSlot& slot = s[size];
+	      std::strcpy (slot.name, truncated.c_str ());
+	      slot.type = type;
+	      // Publish the name and type.
+	      header->size.store (size + 1, boost::memory_order_release);
+	      return &slot;
+	    }
+	}
+	// Outside of the lock, in case an output registers metrics.
+	reportUnpublished (name, type, registered);
+	return unpublished ();
+      }
+
+      /// \brief Remove the segment name at exit.
+      ///
+      /// The segment stays mapped for the metrics updated during
+      /// static destruction.
+      class HPP_UTIL_LOCAL SegmentRemover
+      {
+      public:
+	~SegmentRemover ()
+	{
+#ifdef HPP_UTIL_SHARED_METRICS
+	  if (shared.load ())
+	    shm_unlink (Metrics::segmentName (processId ()).c_str ());
+#endif // HPP_UTIL_SHARED_METRICS
+	}
+      };
+
+      SegmentRemover remover;
+    } // end of anonymous namespace.
+
+    const boost::uint32_t MetricsHeader::version;
+    const std::size_t MetricSlot::nameSize;
+    const std::size_t MetricSlot::bucketCount;
+    const std::size_t Metrics::capacity;
+
+    Counter::Counter ()
+      : slot_ (unpublished ())
+    {}
+
+    Counter::Counter (MetricSlot* slot)
+      : slot_ (slot)
+    {}
+
+    boost::uint64_t
+    Counter::value () const
+    {
+      return (boost::uint64_t) slot_->value.load (boost::memory_order_relaxed);
+    }
+
+    Gauge::Gauge ()
+      : slot_ (unpublished ())
+    {}
+
+    Gauge::Gauge (MetricSlot* slot)
+      : slot_ (slot)
+    {}
+
+    boost::int64_t
+    Gauge::value () const
+    {
+      return slot_->value.load (boost::memory_order_relaxed);
+    }
+
+    Histogram::Histogram ()
+      : slot_ (unpublished ())
+    {}
+
+    Histogram::Histogram (MetricSlot* slot)
+      : slot_ (slot)
+    {}
+
+    boost::uint64_t
+    Histogram::count () const
+    {
+      return slot_->count.load (boost::memory_order_relaxed);
+    }
+
+    boost::uint64_t
+    Histogram::sum () const
+    {
+      return (boost::uint64_t) slot_->value.load (boost::memory_order_relaxed);
+    }
+
+    Counter
+    Metrics::counter (const std::string& name)
+    {
+      return Counter (find (name, METRIC_COUNTER));
+    }
+
+    Gauge
+    Metrics::gauge (const std::string& name)
+    {
+      return Gauge (find (name, METRIC_GAUGE));
+    }
+
+    Histogram
+    Metrics::histogram (const std::string& name)
+    {
+      return Histogram (find (name, METRIC_HISTOGRAM));
+    }
+
+    std::string
+    Metrics::segmentName (int pid)
+    {
+      return (boost::format ("/hpp-metrics.%1%") % pid).str ();
+    }
+
+    bool
+    Metrics::isShared ()
+    {
+      return shared.load ();
+    }
+
+    MetricsView::MetricsView (int pid)
+      : header_ (0),
+	mappedSize_ (0)
+    {
+#ifdef HPP_UTIL_SHARED_METRICS
+      int fd = shm_open (Metrics::segmentName (pid).c_str (), O_RDONLY, 0);
+      if (fd < 0)
+	return;
+      struct stat status;
+      void* base = MAP_FAILED;
+      if (fstat (fd, &status) == 0
+	  && (std::size_t) status.st_size >= sizeof (MetricsHeader))
+	{
+	  mappedSize_ = (std::size_t) status.st_size;
+	  base = mmap (0, mappedSize_, PROT_READ, MAP_SHARED, fd, 0);
+	}
+      close (fd);
+      if (base == MAP_FAILED)
+	return;
+
+      const MetricsHeader* header = static_cast<const MetricsHeader*> (base);
+      if (std::memcmp (header->magic, HPP_UTIL_METRICS_MAGIC,
+		       sizeof (HPP_UTIL_METRICS_MAGIC)) != 0
+	  || header->layoutVersion != MetricsHeader::version
+	  || header->slotSize != sizeof (MetricSlot)
+	  || mappedSize_ < sizeof (MetricsHeader)
+	  + header->capacity * sizeof (MetricSlot))
+	{
+	  munmap (base, mappedSize_);
+	  return;
+	}
+      header_ = header;
+#else
+      (void) pid;
+#endif // HPP_UTIL_SHARED_METRICS
+    }
+
+    MetricsView::~MetricsView ()
+    {
+#ifdef HPP_UTIL_SHARED_METRICS
+      if (header_)
+	munmap (const_cast<MetricsHeader*> (header_), mappedSize_);
+#endif // HPP_UTIL_SHARED_METRICS
+    }
+
+    bool
+    MetricsView::isAttached () const
+    {
+      return header_;
+    }
+
+    std::size_t
+    MetricsView::size () const
+    {
+      if (!header_)
+	return 0;
+      boost::uint32_t size = header_->size.load (boost::memory_order_acquire);
+      return size < header_->capacity ? size : header_->capacity;
+    }
+
+    const MetricSlot&
+    MetricsView::slot (std::size_t i) const
+    {
+      return slots (header_)[i];
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
@@ -0,0 +1,255 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <ostream>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/tss.hpp>
+
+#if defined HAVE_LINUX_PERF_EVENT_H && defined HAVE_UNISTD_H
+# include <linux/perf_event.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+# ifdef SYS_perf_event_open
+#  define HPP_UTIL_HAVE_PERF_EVENT 1
+# endif // SYS_perf_event_open
+#endif // HAVE_LINUX_PERF_EVENT_H && HAVE_UNISTD_H
+
+#include "hpp/util/perf-counters.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      boost::atomic<bool> enabled;
+
+#ifdef HPP_UTIL_HAVE_PERF_EVENT
+      struct HPP_UTIL_LOCAL EventConfig
+      {
+	boost::uint32_t type;
+	boost::uint64_t config;
+      };
+
+      /// \brief perf_event_open configuration, by PerfCounters::Event.
+      const EventConfig configs[PerfCounters::EVENT_COUNT] =
+	{
+	  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	  { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+	    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+	    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+	  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+	};
+
+      /// \brief Counters opened by a thread.
+      struct HPP_UTIL_LOCAL CounterGroup
+      {
+	CounterGroup ()
+	  : leader (-1),
+	    size (0)
+	{
+	  for (int i = 0; i < PerfCounters::EVENT_COUNT; ++i)
+	    {
+	      fds[i] = -1;
+	      slots[i] = -1;
+	      open ((PerfCounters::Event) i);
+	    }
+	}
+
+	~CounterGroup ()
+	{
+	  for (int i = 0; i < PerfCounters::EVENT_COUNT; ++i)
+	    if (fds[i] >= 0)
+	      close (fds[i]);
+	}
+
+	/// \brief Add \a event to the group, if permitted.
+	void open (PerfCounters::Event event)
+	{
+	  perf_event_attr attr;
+	  std::memset (&attr, 0, sizeof (attr));
+	  attr.size = sizeof (attr);
+	  attr.type = configs[event].type;
+	  attr.config = configs[event].config;
+	  attr.read_format = PERF_FORMAT_GROUP
+	    | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	  // User space only, which is permitted by default.
+	  attr.exclude_kernel = 1;
+	  attr.exclude_hv = 1;
+	  int fd = (int) syscall (SYS_perf_event_open, &attr, 0, -1, leader, 0);
+	  if (fd < 0)
+	    return;
+	  if (leader < 0)
+	    leader = fd;
+	  fds[event] = fd;
+	  slots[event] = size++;
+	}
+
+	int leader;
+	int fds[PerfCounters::EVENT_COUNT];
+	/// \brief Position of each event in a group read, -1 if not
+	/// available.
+	int slots[PerfCounters::EVENT_COUNT];
+	int size;
+      };
+
+      HPP_UTIL_LOCAL CounterGroup&
+      localGroup ()
+      {
+	// Never destroyed: timers may be used during static
+	// destruction. Groups are closed when their thread exits.
+	static boost::thread_specific_ptr<CounterGroup>* groups =
+	  new boost::thread_specific_ptr<CounterGroup> ();
+	CounterGroup* group = groups->get ();
+	if (!group)
+	  {
+	    group = new CounterGroup ();
+	    groups->reset (group);
+	  }
+	return *group;
+      }
+#endif // HPP_UTIL_HAVE_PERF_EVENT
+    } // end of anonymous namespace.
+
+    PerfCounters::PerfCounters ()
+      : valid_ (0)
+    {
+      for (int i = 0; i < EVENT_COUNT; ++i)
+	values_[i] = 0;
+    }
+
+    PerfCounters
+    PerfCounters::read ()
+    {
+      PerfCounters counters;
+#ifdef HPP_UTIL_HAVE_PERF_EVENT
+      if (!enabled.load (boost::memory_order_relaxed))
+	return counters;
+      CounterGroup& group = localGroup ();
+      if (group.leader < 0)
+	return counters;
+
+      // Number of events, time enabled, time running, values.
+      boost::uint64_t data[3 + EVENT_COUNT];
+      ssize_t size = ::read (group.leader, data, sizeof (data));
+      if (size < (ssize_t) (3 * sizeof (boost::uint64_t)) || !data[2])
+	return counters;
+      double scale = (double) data[1] / (double) data[2];
+      for (int i = 0; i < EVENT_COUNT; ++i)
+	{
+	  int slot = group.slots[i];
+	  if (slot < 0 || (boost::uint64_t) slot >= data[0])
+	    continue;
+	  counters.values_[i] = data[1] == data[2] ? data[3 + slot]
+	    : (boost::uint64_t) ((double) data[3 + slot] * scale);
+	  counters.valid_ |= 1u << i;
+	}
+#endif // HPP_UTIL_HAVE_PERF_EVENT
+      return counters;
+    }
+
+    void
+    PerfCounters::setEnabled (bool enable)
+    {
+      enabled.store (enable);
+    }
+
+    bool
+    PerfCounters::isEnabled ()
+    {
+      return enabled.load ();
+    }
+
+    char const*
+    PerfCounters::name (Event event)
+    {
+      static char const* names[EVENT_COUNT] =
+	{
+	  "cycles",
+	  "instructions",
+	  "L1D misses",
+	  "LLC misses",
+	  "branch misses"
+	};
+      return event < EVENT_COUNT ? names[event] : "";
+    }
+
+    bool
+    PerfCounters::isValid (Event event) const
+    {
+      return valid_ & (1u << event);
+    }
+
+    boost::uint64_t
+    PerfCounters::value (Event event) const
+    {
+      return isValid (event) ? values_[event] : 0;
+    }
+
+    bool
+    PerfCounters::empty () const
+    {
+      return !valid_;
+    }
+
+    double
+    PerfCounters::instructionsPerCycle () const
+    {
+      if (!isValid (CYCLES) || !isValid (INSTRUCTIONS) || !values_[CYCLES])
+	return 0;
+      return (double) values_[INSTRUCTIONS] / (double) values_[CYCLES];
+    }
+
+    PerfCounters
+    PerfCounters::operator- (const PerfCounters& start) const
+    {
+      PerfCounters counters;
+      counters.valid_ = valid_ & start.valid_;
+      for (int i = 0; i < EVENT_COUNT; ++i)
+	if (counters.isValid ((Event) i))
+	  counters.values_[i] = values_[i] > start.values_[i]
+	    ? values_[i] - start.values_[i] : 0;
+      return counters;
+    }
+
+    std::ostream&
+    PerfCounters::print (std::ostream& o) const
+    {
+      const char* separator = "";
+      for (int i = 0; i < EVENT_COUNT; ++i)
+	if (isValid ((Event) i))
+	  {
+	    o << separator << name ((Event) i) << ' ' << values_[i];
+	    separator = ", ";
+	  }
+      if (isValid (CYCLES) && isValid (INSTRUCTIONS))
+	o << ", IPC " << instructionsPerCycle ();
+      return o;
+    }
+
+    std::ostream&
+    operator<< (std::ostream& o, const PerfCounters& counters)
+    {
+      return counters.print (o);
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
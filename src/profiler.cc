@@ -0,0 +1,420 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "hpp/util/clock.hh"
+#include "hpp/util/debug.hh"
+#include "hpp/util/profiler.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Region in the call tree of a thread.
+    ///
+    /// Only the owning thread adds children and counts; reports read
+    /// the tree concurrently. Children are prepended to an immutable
+    /// sibling list.
+    struct HPP_UTIL_LOCAL ProfileNode
+    {
+      ProfileNode (char const* name, ProfileNode* parent)
+	: name (name),
+	  parent (parent),
+	  children (0),
+	  sibling (0),
+	  calls (0),
+	  inclusive (0)
+      {}
+
+      ProfileNode* child (char const* childName)
+      {
+	ProfileNode* head = children.load (boost::memory_order_relaxed);
+	for (ProfileNode* node = head; node; node = node->sibling)
+	  if (node->name == childName
+	      || std::strcmp (node->name, childName) == 0)
+	    return node;
+	ProfileNode* node = new ProfileNode (childName, this);
+	node->sibling = head;
+	children.store (node, boost::memory_order_release);
+	return node;
+      }
+
+      char const* name;
+      ProfileNode* parent;
+      boost::atomic<ProfileNode*> children;
+      ProfileNode* sibling;
+      boost::atomic<boost::uint64_t> calls;
+      /// \brief Inclusive time in nanoseconds.
+      boost::atomic<boost::uint64_t> inclusive;
+    };
+
+    namespace
+    {
+      /// \brief Maximum number of regions active at once on a thread.
+      const std::size_t maxDepth = 64;
+
+      /// \brief Call tree of a thread.
+      ///
+      /// Kept for the final report and reused by the next thread once
+      /// the thread exits.
+      struct HPP_UTIL_LOCAL ThreadProfile
+      {
+	ThreadProfile ()
+	  : root ("", 0),
+	    depth (0),
+	    inUse (true),
+	    next (0)
+	{}
+
+	/// \brief Innermost active region.
+	ProfileNode* current ()
+	{
+	  return depth ? active[depth - 1] : &root;
+	}
+
+	/// \brief Leave \a node, wherever it is among the active
+	/// regions.
+	///
+	/// Regions left out of order, such as overlapping
+	/// hppStartBenchmark and hppStopBenchmark pairs, leave the
+	/// others active.
+	void leave (ProfileNode* node)
+	{
+	  std::size_t i = depth;
+	  while (i > 0 && active[i - 1] != node)
+	    --i;
+	  if (i == 0)
+	    return;
+	  for (; i < depth; ++i)
+	    active[i - 1] = active[i];
+	  --depth;
+	}
+
+	ProfileNode root;
+	ProfileNode* active[maxDepth];
+	std::size_t depth;
+	boost::atomic<bool> inUse;
+	ThreadProfile* next;
+      };
+
+      /// \brief Head of the list of thread profiles.
+      ///
+      /// Zero-initialized before any region can be entered.
+      boost::atomic<ThreadProfile*> profiles;
+      /// \brief Number of threads which entered a region.
+      boost::atomic<std::size_t> profiledThreads;
+      boost::atomic<bool> noReportAtExit;
+
+      /// \brief Registered observers, zero-initialized.
+      ///
+      /// A fixed array, so that scopes check a single counter when
+      /// there is no observer.
+      const std::size_t maxObservers = 16;
+      boost::atomic<RegionObserver*> observers[maxObservers];
+      boost::atomic<std::size_t> observerCount;
+
+      HPP_UTIL_LOCAL void
+      releaseProfile (ThreadProfile* profile)
+      {
+	profile->inUse.store (false);
+      }
+
+      HPP_UTIL_LOCAL ThreadProfile&
+      localProfile ()
+      {
+	// Never destroyed: regions may be timed during static
+	// destruction.
+	static boost::thread_specific_ptr<ThreadProfile>* locals =
+	  new boost::thread_specific_ptr<ThreadProfile> (&releaseProfile);
+	ThreadProfile* profile = locals->get ();
+	if (profile)
+	  return *profile;
+
+	for (profile = profiles.load (); profile; profile = profile->next)
+	  {
+	    bool inUse = false;
+	    if (profile->inUse.compare_exchange_strong (inUse, true))
+	      break;
+	  }
+	if (!profile)
+	  {
+	    profile = new ThreadProfile ();
+	    profile->next = profiles.load ();
+	    while (!profiles.compare_exchange_weak (profile->next, profile))
+	      {}
+	  }
+	++profiledThreads;
+	profile->depth = 0;
+	locals->reset (profile);
+	return *profile;
+      }
+
+      /// \brief Region merged over the threads.
+      struct HPP_UTIL_LOCAL Summary
+      {
+	explicit Summary (const std::string& name)
+	  : name (name),
+	    calls (0),
+	    inclusive (0),
+	    children ()
+	{}
+
+	Summary& child (const std::string& childName)
+	{
+	  for (std::size_t i = 0; i < children.size (); ++i)
+	    if (children[i].name == childName)
+	      return children[i];
+	  children.push_back (Summary (childName));
+	  return children.back ();
+	}
+
+	void merge (const ProfileNode& node)
+	{
+	  for (ProfileNode* c = node.children.load (boost::memory_order_acquire);
+	       c; c = c->sibling)
+	    {
+	      Summary& summary = child (c->name);
+	      summary.calls += c->calls.load (boost::memory_order_relaxed);
+	      summary.inclusive +=
+		c->inclusive.load (boost::memory_order_relaxed);
+	      summary.merge (*c);
+	    }
+	}
+
+	/// \brief Whether neither this region nor its children were
+	/// left since the last reset.
+	bool empty () const
+	{
+	  for (std::size_t i = 0; i < children.size (); ++i)
+	    if (!children[i].empty ())
+	      return false;
+	  return calls == 0;
+	}
+
+	boost::uint64_t childrenTime () const
+	{
+	  boost::uint64_t time = 0;
+	  for (std::size_t i = 0; i < children.size (); ++i)
+	    time += children[i].inclusive;
+	  return time;
+	}
+
+	std::string name;
+	boost::uint64_t calls;
+	boost::uint64_t inclusive;
+	std::vector<Summary> children;
+      };
+
+      HPP_UTIL_LOCAL bool
+      slowerThan (const Summary& lhs, const Summary& rhs)
+      {
+	return lhs.inclusive > rhs.inclusive;
+      }
+
+      HPP_UTIL_LOCAL void
+      mergeProfiles (Summary& root)
+      {
+	for (ThreadProfile* profile = profiles.load (); profile;
+	     profile = profile->next)
+	  root.merge (profile->root);
+      }
+
+      HPP_UTIL_LOCAL void
+      printSummary (std::ostream& o, Summary& summary, double total,
+		    std::size_t depth)
+      {
+	std::sort (summary.children.begin (), summary.children.end (),
+		   &slowerThan);
+	for (std::size_t i = 0; i < summary.children.size (); ++i)
+	  {
+	    const Summary& child = summary.children[i];
+	    if (child.empty ())
+	      continue;
+	    boost::uint64_t childrenTime = child.childrenTime ();
+	    boost::uint64_t exclusive = child.inclusive > childrenTime
+	      ? child.inclusive - childrenTime : 0;
+	    o << boost::format ("%10d %12.3f %12.3f %6.1f  %s%s")
+	      % child.calls
+	      % ((double) child.inclusive * 1e-6)
+	      % ((double) exclusive * 1e-6)
+	      % (total > 0 ? 100. * (double) child.inclusive / total : 0.)
+	      % std::string (2 * depth, ' ')
+	      % child.name
+	      << '\n';
+	    printSummary (o, summary.children[i], total, depth + 1);
+	  }
+      }
+
+      HPP_UTIL_LOCAL void
+      resetNode (ProfileNode& node)
+      {
+	node.calls.store (0, boost::memory_order_relaxed);
+	node.inclusive.store (0, boost::memory_order_relaxed);
+	for (ProfileNode* c = node.children.load (boost::memory_order_acquire);
+	     c; c = c->sibling)
+	  resetNode (*c);
+      }
+
+      HPP_UTIL_LOCAL void
+      notifyBegin (char const* name, boost::uint64_t time)
+      {
+	for (std::size_t i = 0; i < maxObservers; ++i)
+	  {
+	    RegionObserver* observer = observers[i].load ();
+	    if (observer)
+	      observer->regionBegin (name, time);
+	  }
+      }
+
+      HPP_UTIL_LOCAL void
+      notifyEnd (char const* name, boost::uint64_t time,
+		 boost::uint64_t duration)
+      {
+	for (std::size_t i = 0; i < maxObservers; ++i)
+	  {
+	    RegionObserver* observer = observers[i].load ();
+	    if (observer)
+	      observer->regionEnd (name, time, duration);
+	  }
+      }
+    } // end of anonymous namespace.
+
+    RegionObserver::~RegionObserver ()
+    {}
+
+    ProfileScope::ProfileScope (char const* name)
+      : node_ (0),
+	start_ (0)
+    {
+      ThreadProfile& profile = localProfile ();
+      if (profile.depth == maxDepth)
+	return;
+      node_ = profile.current ()->child (name);
+      profile.active[profile.depth++] = node_;
+      start_ = steadyNow ();
+      if (observerCount.load (boost::memory_order_relaxed))
+	notifyBegin (node_->name, start_);
+    }
+
+    ProfileScope::~ProfileScope ()
+    {
+      stop ();
+    }
+
+    void
+    ProfileScope::stop ()
+    {
+      if (!node_)
+	return;
+      boost::uint64_t now = steadyNow ();
+      boost::uint64_t duration = now - start_;
+      node_->calls.fetch_add (1, boost::memory_order_relaxed);
+      node_->inclusive.fetch_add (duration, boost::memory_order_relaxed);
+      localProfile ().leave (node_);
+      if (observerCount.load (boost::memory_order_relaxed))
+	notifyEnd (node_->name, now, duration);
+      node_ = 0;
+    }
+
+    void
+    Profiler::print (std::ostream& o)
+    {
+      Summary root ("");
+      mergeProfiles (root);
+      o << "profile of " << profiledThreads.load () << " thread(s), times in ms\n"
+	<< boost::format ("%10s %12s %12s %6s  %s")
+	% "calls" % "inclusive" % "exclusive" % "%" % "region"
+	<< '\n';
+      printSummary (o, root, (double) root.childrenTime (), 0);
+    }
+
+    void
+    Profiler::logReport ()
+    {
+      if (!logging.benchmark.isEnabled ())
+	return;
+      Summary root ("");
+      mergeProfiles (root);
+      if (root.empty ())
+	return;
+
+      ScopedFormatStream report;
+      print (report.stream ());
+      logging.benchmark.write (__FILE__, __LINE__, __PRETTY_FUNCTION__,
+			       report.str ());
+    }
+
+    void
+    Profiler::reset ()
+    {
+      for (ThreadProfile* profile = profiles.load (); profile;
+	   profile = profile->next)
+	resetNode (profile->root);
+    }
+
+    void
+    Profiler::setReportAtExit (bool report)
+    {
+      noReportAtExit.store (!report);
+    }
+
+    bool
+    Profiler::reportAtExit ()
+    {
+      return !noReportAtExit.load ();
+    }
+
+    bool
+    Profiler::addObserver (RegionObserver* observer)
+    {
+      for (std::size_t i = 0; i < maxObservers; ++i)
+	{
+	  RegionObserver* expected = 0;
+	  if (observers[i].compare_exchange_strong (expected, observer))
+	    {
+	      ++observerCount;
+	      return true;
+	    }
+	}
+      return false;
+    }
+
+    void
+    Profiler::removeObserver (RegionObserver* observer)
+    {
+      for (std::size_t i = 0; i < maxObservers; ++i)
+	{
+	  RegionObserver* expected = observer;
+	  if (observers[i].compare_exchange_strong (expected, 0))
+	    {
+	      --observerCount;
+	      return;
+	    }
+	}
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
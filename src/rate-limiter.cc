@@ -0,0 +1,108 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "hpp/util/clock.hh"
+#include "hpp/util/debug.hh"
+#include "hpp/util/rate-limiter.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      /// \brief Head of the list of registered limiters.
+      ///
+      /// Zero-initialized before any limiter can be constructed.
+      boost::atomic<RateLimiter*> limiters;
+
+      const boost::uint64_t nanosecondsPerSecond = 1000000000;
+    } // end of anonymous namespace.
+
+    RateLimiter::RateLimiter (Channel& channel,
+			      char const* file,
+			      int line,
+			      char const* function)
+      : channel_ (channel),
+	file_ (file),
+	line_ (line),
+	function_ (function),
+	hits_ (0),
+	accepted_ (0),
+	reported_ (0),
+	window_ (0),
+	windowHits_ (0),
+	next_ (limiters.load ())
+    {
+      while (!limiters.compare_exchange_weak (next_, this))
+	{}
+    }
+
+    bool
+    RateLimiter::perSecond (boost::uint64_t limit)
+    {
+      hits_.fetch_add (1, boost::memory_order_relaxed);
+      boost::uint64_t window = steadyNow () / nanosecondsPerSecond;
+      boost::uint64_t current = window_.load (boost::memory_order_relaxed);
+      // The window is switched by a single thread; hits racing with
+      // the switch may be counted in either window.
+      if (window != current && window_.compare_exchange_strong (current,
+								window))
+	windowHits_.store (0, boost::memory_order_relaxed);
+      return accept (windowHits_.fetch_add (1, boost::memory_order_relaxed)
+		     < limit);
+    }
+
+    boost::uint64_t
+    RateLimiter::hits () const
+    {
+      return hits_.load ();
+    }
+
+    boost::uint64_t
+    RateLimiter::suppressed () const
+    {
+      boost::uint64_t accepted = accepted_.load ();
+      boost::uint64_t hits = hits_.load ();
+      return hits > accepted ? hits - accepted : 0;
+    }
+
+    void
+    RateLimiter::logSummary ()
+    {
+      for (RateLimiter* limiter = limiters.load (); limiter;
+	   limiter = limiter->next_)
+	{
+	  boost::uint64_t suppressed = limiter->suppressed ();
+	  if (suppressed == limiter->reported_
+	      || !limiter->channel_.isEnabled ())
+	    continue;
+
+	  ScopedFormatStream summary;
+	  summary.stream ()
+	    << suppressed - limiter->reported_
+	    << " record(s) suppressed by rate limiting, "
+	    << suppressed << " of " << limiter->hits () << " in total"
+	    << inl;
+	  limiter->channel_.write (limiter->file_, limiter->line_,
+				   limiter->function_, summary.str ());
+	  limiter->reported_ = suppressed;
+	}
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
@@ -0,0 +1,279 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/format.hpp>
+
+#include "hpp/util/clock.hh"
+
+#include "threaded-writer.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      /// \brief Order records by timestamp, then by collection order.
+      struct HPP_UTIL_LOCAL EarlierRecord
+      {
+	explicit EarlierRecord (const std::vector<Record>& records)
+	  : records (records)
+	{}
+
+	bool operator() (std::size_t a, std::size_t b) const
+	{
+	  return records[a].timestamp < records[b].timestamp;
+	}
+
+	const std::vector<Record>& records;
+      };
+
+      HPP_UTIL_LOCAL unsigned long
+      nextSerial ()
+      {
+	static boost::atomic<unsigned long> serial (0);
+	return ++serial;
+      }
+    } // end of anonymous namespace.
+
+    ThreadedWriter::ThreadState::ThreadState (std::size_t capacity,
+					      unsigned long owner)
+      : queue (capacity),
+	owner (owner),
+	index (0),
+	lastFunction (),
+	buffer (),
+	stream (&buffer),
+	shard ()
+    {}
+
+    ThreadedWriter::ThreadedWriter (std::ostream& stream,
+				    const std::string& filename,
+				    bool sharded,
+				    std::size_t capacity)
+      : stream_ (stream),
+	filename_ (filename),
+	sharded_ (sharded),
+	capacity_ (capacity),
+	serial_ (nextSerial ()),
+	local_ (),
+	registryMutex_ (),
+	states_ (),
+	nextIndex_ (0),
+	pending_ (),
+	order_ (),
+	sleeping_ (false),
+	stopping_ (false),
+	mutex_ (),
+	flushRequested_ (0),
+	flushCompleted_ (0),
+	wakeUpCondition_ (),
+	flushedCondition_ (),
+	thread_ (boost::bind (&ThreadedWriter::run, this))
+    {}
+
+    ThreadedWriter::~ThreadedWriter ()
+    {
+      stopping_.store (true);
+      {
+	boost::lock_guard<boost::mutex> lock (mutex_);
+	wakeUpCondition_.notify_one ();
+      }
+      thread_.join ();
+    }
+
+    ThreadedWriter::ThreadState&
+    ThreadedWriter::local ()
+    {
+      ThreadStatePtr* state = local_.get ();
+      // The serial check discards states left over by a previous
+      // writer, which may have lived at the same address.
+      if (state && (*state)->owner == serial_)
+	return **state;
+
+      ThreadStatePtr newState (new ThreadState (capacity_, serial_));
+      {
+	boost::lock_guard<boost::mutex> lock (registryMutex_);
+	newState->index = nextIndex_++;
+	states_.push_back (newState);
+      }
+      local_.reset (new ThreadStatePtr (newState));
+      return *newState;
+    }
+
+    void
+    ThreadedWriter::push (ThreadState& state)
+    {
+      boost::uint64_t timestamp = steadyNow ();
+      boost::string_ref text = state.buffer.str ();
+      while (!state.queue.tryPush (text, timestamp))
+	{
+	  wakeUp ();
+	  boost::this_thread::yield ();
+	}
+      wakeUp ();
+    }
+
+    void
+    ThreadedWriter::flush ()
+    {
+      boost::unique_lock<boost::mutex> lock (mutex_);
+      unsigned long request = ++flushRequested_;
+      wakeUpCondition_.notify_one ();
+      while (flushCompleted_ < request)
+	flushedCondition_.wait (lock);
+    }
+
+    void
+    ThreadedWriter::wakeUp ()
+    {
+      if (sleeping_.load ())
+	{
+	  boost::lock_guard<boost::mutex> lock (mutex_);
+	  wakeUpCondition_.notify_one ();
+	}
+    }
+
+    std::ofstream&
+    ThreadedWriter::shard (ThreadState& state)
+    {
+      if (!state.shard)
+	{
+	  std::string prefix (filename_);
+	  const std::string extension (".log");
+	  if (prefix.size () >= extension.size ()
+	      && prefix.compare (prefix.size () - extension.size (),
+				 extension.size (), extension) == 0)
+	    prefix.resize (prefix.size () - extension.size ());
+	  boost::format fmter ("%1%.%2%.log");
+	  fmter % prefix % state.index;
+	  state.shard.reset (new std::ofstream (fmter.str ().c_str ()));
+	}
+      return *state.shard;
+    }
+
+    std::size_t
+    ThreadedWriter::collect ()
+    {
+      std::size_t count = 0;
+      Record record;
+      boost::lock_guard<boost::mutex> lock (registryMutex_);
+      for (std::size_t i = 0; i < states_.size ();)
+	{
+	  ThreadState& state = *states_[i];
+	  // Read before draining: an exited thread cannot push anymore.
+	  bool exited = states_[i].use_count () == 1;
+	  while (state.queue.tryPop (record))
+	    {
+	      ++count;
+	      if (sharded_)
+		shard (state).write (record.text.data (),
+				     (std::streamsize) record.text.size ());
+	      else
+		{
+		  pending_.push_back (Record ());
+		  pending_.back ().swap (record);
+		}
+	    }
+	  if (sharded_ && state.shard)
+	    state.shard->flush ();
+	  if (exited)
+	    {
+	      states_[i] = states_.back ();
+	      states_.pop_back ();
+	    }
+	  else
+	    ++i;
+	}
+      return count;
+    }
+
+    void
+    ThreadedWriter::writePending (boost::uint64_t limit)
+    {
+      if (pending_.empty ())
+	return;
+
+      order_.resize (pending_.size ());
+      for (std::size_t i = 0; i < order_.size (); ++i)
+	order_[i] = i;
+      std::stable_sort (order_.begin (), order_.end (),
+			EarlierRecord (pending_));
+
+      std::size_t written = 0;
+      while (written < order_.size ()
+	     && pending_[order_[written]].timestamp <= limit)
+	{
+	  const std::string& text = pending_[order_[written]].text;
+	  stream_.write (text.data (), (std::streamsize) text.size ());
+	  ++written;
+	}
+      stream_.flush ();
+
+      // Keep the remaining records, in timestamp order.
+      std::vector<Record> remaining (order_.size () - written);
+      for (std::size_t i = written; i < order_.size (); ++i)
+	remaining[i - written].swap (pending_[order_[i]]);
+      pending_.swap (remaining);
+    }
+
+    void
+    ThreadedWriter::run ()
+    {
+      for (;;)
+	{
+	  unsigned long request;
+	  {
+	    boost::lock_guard<boost::mutex> lock (mutex_);
+	    request = flushRequested_;
+	  }
+	  bool stopping = stopping_.load ();
+
+	  std::size_t count = collect ();
+	  bool all = stopping || request != flushCompleted_;
+	  boost::uint64_t limit = steadyNow ();
+	  limit = limit > mergeDelay ? limit - mergeDelay : 0;
+	  writePending
+	    (all ? std::numeric_limits<boost::uint64_t>::max () : limit);
+
+	  boost::unique_lock<boost::mutex> lock (mutex_);
+	  if (all)
+	    {
+	      flushCompleted_ = request;
+	      flushedCondition_.notify_all ();
+	      if (stopping)
+		break;
+	    }
+	  if (count == 0 && flushRequested_ == flushCompleted_)
+	    {
+	      sleeping_.store (true);
+	      // Wake up regularly to write delayed merged records and to
+	      // catch missed notifications.
+	      wakeUpCondition_.timed_wait
+		(lock, boost::posix_time::milliseconds (10));
+	      sleeping_.store (false);
+	    }
+	}
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
@@ -0,0 +1,147 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HPP_UTIL_SRC_THREADED_WRITER_HH
+# define HPP_UTIL_SRC_THREADED_WRITER_HH
+# include <cstddef>
+# include <fstream>
+# include <ostream>
+# include <string>
+# include <vector>
+
+# include <boost/atomic.hpp>
+# include <boost/cstdint.hpp>
+# include <boost/scoped_ptr.hpp>
+# include <boost/shared_ptr.hpp>
+# include <boost/thread/condition_variable.hpp>
+# include <boost/thread/mutex.hpp>
+# include <boost/thread/thread.hpp>
+# include <boost/thread/tss.hpp>
+
+# include <hpp/util/config.hh>
+# include <hpp/util/format-buffer.hh>
+
+# include "async-writer.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Background writer collecting records from per-thread
+    /// buffers.
+    ///
+    /// Each emitting thread owns a ring of timestamped records and
+    /// its own formatting state. Producers never share a lock: the
+    /// registry mutex is only taken the first time a thread logs.
+    ///
+    /// Records are either merged by timestamp into a single stream
+    /// or written to one shard file per thread.
+    class HPP_UTIL_LOCAL ThreadedWriter
+    {
+    public:
+      /// \brief State owned by an emitting thread.
+      struct ThreadState
+      {
+	ThreadState (std::size_t capacity, unsigned long owner);
+
+	RecordQueue queue;
+	/// \brief Serial number of the writer this state belongs to.
+	unsigned long owner;
+	/// \brief Registration rank, used to name the shard.
+	std::size_t index;
+	/// \brief Last function logged by this thread.
+	std::string lastFunction;
+	/// \brief Storage of the record being formatted, reused from
+	/// one record to the next.
+	FormatBuffer buffer;
+	/// \brief Stream records are formatted into (per-thread
+	/// indentation).
+	std::ostream stream;
+	/// \brief Shard file, only accessed by the writer thread.
+	boost::scoped_ptr<std::ofstream> shard;
+      };
+
+      /// \param stream destination of merged records
+      /// \param filename journal file name, shards are named after it
+      /// \param sharded write one file per thread instead of merging
+      /// \param capacity number of records buffered per thread
+      ThreadedWriter (std::ostream& stream,
+		      const std::string& filename,
+		      bool sharded,
+		      std::size_t capacity);
+
+      /// \brief Stop the writer thread after having written every
+      /// buffered record.
+      ~ThreadedWriter ();
+
+      /// \brief State of the calling thread, registered on first use.
+      ThreadState& local ();
+
+      /// \brief Queue the record formatted in \a state stream.
+      void push (ThreadState& state);
+
+      /// \brief Wait until every record pushed so far is written
+      /// and the streams flushed.
+      void flush ();
+
+    private:
+      typedef boost::shared_ptr<ThreadState> ThreadStatePtr;
+
+      void run ();
+      void wakeUp ();
+      /// \brief Move the records of all threads to pending_ (or to
+      /// the shards), forget exited threads.
+      std::size_t collect ();
+      /// \brief Write pending records older than \a limit.
+      void writePending (boost::uint64_t limit);
+      std::ofstream& shard (ThreadState& state);
+
+      /// \brief Delay before a merged record is written, so that
+      /// records from slower threads can be ordered before it.
+      static const boost::uint64_t mergeDelay = 10000000;
+
+      std::ostream& stream_;
+      std::string filename_;
+      bool sharded_;
+      std::size_t capacity_;
+      unsigned long serial_;
+
+      boost::thread_specific_ptr<ThreadStatePtr> local_;
+      boost::mutex registryMutex_;
+      std::vector<ThreadStatePtr> states_;
+      std::size_t nextIndex_;
+
+      /// \brief Collected records not written yet (writer thread only).
+      std::vector<Record> pending_;
+      std::vector<std::size_t> order_;
+
+      boost::atomic<bool> sleeping_;
+      boost::atomic<bool> stopping_;
+      boost::mutex mutex_;
+      /// \brief Flush requests issued and served (mutex_).
+      unsigned long flushRequested_;
+      unsigned long flushCompleted_;
+      boost::condition_variable wakeUpCondition_;
+      boost::condition_variable flushedCondition_;
+
+      boost::thread thread_;
+    };
+
+  } // end of namespace debug
+} // end of namespace hpp
+
+#endif //! HPP_UTIL_SRC_THREADED_WRITER_HH
@@ -15,10 +15,14 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <iostream>
 //#include <boost/date_time/microsec_time_clock.hpp>
+#include <boost/atomic.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/format.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/tss.hpp>
 
 #include "hpp/util/timer.hh"
 
@@ -26,17 +30,134 @@ namespace hpp
 {
   namespace debug
   {
+    namespace
+    {
+      /// \brief Wall-clock time matching steady time zero.
+      boost::posix_time::ptime wallEpoch;
+      boost::once_flag wallEpochOnce = BOOST_ONCE_INIT;
+
+      HPP_UTIL_LOCAL void
+      initWallEpoch ()
+      {
+	using namespace boost::posix_time;
+	boost::uint64_t now = steadyNow ();
+	wallEpoch = microsec_clock::universal_time ()
+	  - microseconds ((boost::int64_t) (now / 1000));
+      }
+
+      HPP_UTIL_LOCAL boost::posix_time::ptime
+      toWallClock (ClockSource source, boost::uint64_t time)
+      {
+	if (source == THREAD_CPU_CLOCK)
+	  return boost::posix_time::ptime ();
+	boost::call_once (wallEpochOnce, &initWallEpoch);
+	return wallEpoch
+	  + boost::posix_time::microseconds ((boost::int64_t) (time / 1000));
+      }
+
+      boost::atomic<bool> compensate (false);
+
+      /// \brief Measured overheads by clock source, zero until measured.
+      struct HPP_UTIL_LOCAL Overhead
+      {
+	/// \brief Duration of an empty measurement.
+	boost::atomic<boost::uint64_t> empty;
+	/// \brief Cost of a nested start/stop pair.
+	boost::atomic<boost::uint64_t> nested;
+      };
+      Overhead overheads[THREAD_CPU_CLOCK + 1];
+
+      /// \brief Number of timers stopped by the calling thread, only
+      /// maintained while compensating.
+      HPP_UTIL_LOCAL boost::uint64_t&
+      stoppedTimers ()
+      {
+	// Never destroyed: timers may be used during static destruction.
+	static boost::thread_specific_ptr<boost::uint64_t>* counters =
+	  new boost::thread_specific_ptr<boost::uint64_t> ();
+	boost::uint64_t* counter = counters->get ();
+	if (!counter)
+	  {
+	    counter = new boost::uint64_t (0);
+	    counters->reset (counter);
+	  }
+	return *counter;
+      }
+
+      HPP_UTIL_LOCAL const Overhead&
+      measureOverhead (ClockSource source)
+      {
+	static const int nSamples = 1000;
+	Overhead& overhead = overheads[source];
+	if (overhead.nested.load ())
+	  return overhead;
+
+	// The fastest empty measurement is the clock reading bias.
+	boost::uint64_t empty = (boost::uint64_t) -1;
+	for (int i = 0; i < nSamples; ++i)
+	  {
+	    boost::uint64_t start = clockNow (source);
+	    boost::uint64_t stop = clockNow (source);
+	    empty = std::min (empty, stop - start);
+	  }
+
+	// Average cost of a start/stop pair, as seen from outside.
+	Timer timer (source);
+	boost::uint64_t begin = clockNow (source);
+	for (int i = 0; i < nSamples; ++i)
+	  {
+	    timer.start ();
+	    timer.stop ();
+	  }
+	boost::uint64_t nested = (clockNow (source) - begin) / nSamples;
+
+	// Zero means not measured.
+	overhead.empty.store (empty);
+	overhead.nested.store (std::max (nested, (boost::uint64_t) 1));
+	return overhead;
+      }
+    } // end of anonymous namespace.
+
     Timer::Timer (bool autoStart)
-      : start_ (),
-	end_ ()
+      : source_ (STEADY_CLOCK),
+	startNs_ (0),
+	stopNs_ (0),
+	nestedAtStart_ (0),
+	nestedAtStop_ (0),
+	start_ (),
+	end_ (),
+	countersAtStart_ (),
+	countersAtStop_ ()
+    {
+      if (autoStart)
+	start ();
+    }
+
+    Timer::Timer (ClockSource source, bool autoStart)
+      : source_ (source),
+	startNs_ (0),
+	stopNs_ (0),
+	nestedAtStart_ (0),
+	nestedAtStop_ (0),
+	start_ (),
+	end_ (),
+	countersAtStart_ (),
+	countersAtStop_ ()
     {
       if (autoStart)
 	start ();
     }
 
     Timer::Timer (const Timer& timer)
-      : start_ (timer.start_),
-	end_ (timer.end_)
+      : source_ (timer.source_),
+	startNs_ (timer.startNs_),
+	stopNs_ (timer.stopNs_),
+	nestedAtStart_ (timer.nestedAtStart_),
+	nestedAtStop_ (timer.nestedAtStop_),
+	start_ (timer.start_),
+	end_ (timer.end_),
+	countersAtStart_ (timer.countersAtStart_),
+	countersAtStop_ (timer.countersAtStop_)
     {}
 
     Timer&
@@ -44,8 +165,15 @@ namespace hpp
     {
       if (this == &timer)
 	return *this;
+      source_ = timer.source_;
+      startNs_ = timer.startNs_;
+      stopNs_ = timer.stopNs_;
+      nestedAtStart_ = timer.nestedAtStart_;
+      nestedAtStop_ = timer.nestedAtStop_;
       start_ = timer.start_;
       end_ = timer.end_;
+      countersAtStart_ = timer.countersAtStart_;
+      countersAtStop_ = timer.countersAtStop_;
       return *this;
     }
 
@@ -55,13 +183,28 @@ namespace hpp
     const Timer::ptime&
     Timer::start ()
     {
-      return start_ = boost::posix_time::microsec_clock::universal_time ();
+      nestedAtStart_ =
+	compensate.load (boost::memory_order_relaxed) ? stoppedTimers () : 0;
+      // Counters are read out of the timed interval.
+      countersAtStart_ = PerfCounters::read ();
+      // Convert before reading the start time, so that the
+      // conversion is not measured: start_ may precede startNs_ by
+      // the cost of a clock read.
+      start_ = toWallClock (source_, clockNow (source_));
+      startNs_ = clockNow (source_);
+      return start_;
     }
 
     const Timer::ptime&
     Timer::stop ()
     {
-      return end_ = boost::posix_time::microsec_clock::universal_time ();
+      stopNs_ = clockNow (source_);
+      countersAtStop_ = PerfCounters::read ();
+      if (compensate.load (boost::memory_order_relaxed))
+	nestedAtStop_ = stoppedTimers ()++;
+      else
+	nestedAtStop_ = nestedAtStart_;
+      return end_ = toWallClock (source_, stopNs_);
     }
 
     const Timer::ptime&
@@ -76,21 +219,85 @@ namespace hpp
       return end_;
     }
 
+    boost::uint64_t
+    Timer::getStartNs () const
+    {
+      return startNs_;
+    }
+
+    boost::uint64_t
+    Timer::getStopNs () const
+    {
+      return stopNs_;
+    }
+
+    boost::uint64_t
+    Timer::durationNs () const
+    {
+      boost::uint64_t duration = stopNs_ > startNs_ ? stopNs_ - startNs_ : 0;
+      if (!compensate.load (boost::memory_order_relaxed))
+	return duration;
+
+      const Overhead& overhead = measureOverhead (source_);
+      boost::uint64_t bias = overhead.empty.load ()
+	+ (nestedAtStop_ - nestedAtStart_) * overhead.nested.load ();
+      return duration > bias ? duration - bias : 0;
+    }
+
     Timer::time_duration
     Timer::duration () const
     {
-      time_period duration (start_, end_);
-      return duration.length ();
+      return boost::posix_time::microseconds
+	((boost::int64_t) (durationNs () / 1000));
+    }
+
+    ClockSource
+    Timer::clockSource () const
+    {
+      return source_;
+    }
+
+    PerfCounters
+    Timer::counters () const
+    {
+      return countersAtStop_ - countersAtStart_;
     }
 
     std::ostream&
     Timer::print (std::ostream& o) const
     {
       using boost::format;
-      return o <<
+      o <<
 	(format
 	 ("timer started at ``%1%'' and ended at ``%2%'' (elapsed time ``%3%''")
 	 % start_ % end_ % duration ());
+      PerfCounters counters = this->counters ();
+      if (!counters.empty ())
+	o << ", " << counters;
+      return o;
+    }
+
+    boost::uint64_t
+    Timer::overhead (ClockSource source)
+    {
+      return measureOverhead (source).nested.load ();
+    }
+
+    void
+    Timer::setOverheadCompensation (bool compensateOverhead)
+    {
+      // Measure with compensation enabled, as nested timers then
+      // maintain the per-thread count.
+      compensate.store (compensateOverhead);
+      if (compensateOverhead)
+	for (int source = STEADY_CLOCK; source <= THREAD_CPU_CLOCK; ++source)
+	  measureOverhead ((ClockSource) source);
+    }
+
+    bool
+    Timer::overheadCompensation ()
+    {
+      return compensate.load ();
     }
   } // end of namespace debug
 } // end of namespace hpp
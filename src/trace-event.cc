@@ -0,0 +1,198 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iomanip>
+
+#include <boost/atomic.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/tss.hpp>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+# ifdef __linux__
+#  include <sys/syscall.h>
+# endif // __linux__
+#endif // HAVE_UNISTD_H
+
+#include "hpp/util/clock.hh"
+#include "hpp/util/format-buffer.hh"
+#include "hpp/util/trace-event.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    namespace
+    {
+      HPP_UTIL_LOCAL int
+      processId ()
+      {
+#ifdef HAVE_UNISTD_H
+	return getpid ();
+#else
+	return 0;
+#endif // HAVE_UNISTD_H
+      }
+
+      /// \brief Identifier of the calling thread, as shown by the
+      /// system tools when available.
+      HPP_UTIL_LOCAL unsigned long
+      threadId ()
+      {
+	// Never destroyed: regions may be traced during static
+	// destruction.
+	static boost::thread_specific_ptr<unsigned long>* ids =
+	  new boost::thread_specific_ptr<unsigned long> ();
+	unsigned long* id = ids->get ();
+	if (!id)
+	  {
+#if defined HAVE_UNISTD_H && defined __linux__ && defined SYS_gettid
+	    id = new unsigned long ((unsigned long) syscall (SYS_gettid));
+#else
+	    static boost::atomic<unsigned long> nextId (1);
+	    id = new unsigned long (nextId++);
+#endif // HAVE_UNISTD_H && __linux__ && SYS_gettid
+	    ids->reset (id);
+	  }
+	return *id;
+      }
+
+      /// \brief Write \a text as the content of a JSON string.
+      HPP_UTIL_LOCAL void
+      writeEscaped (std::ostream& o, boost::string_ref text)
+      {
+	for (std::size_t i = 0; i < text.size (); ++i)
+	  {
+	    char c = text[i];
+	    switch (c)
+	      {
+	      case '"':
+		o << "\\\"";
+		break;
+	      case '\\':
+		o << "\\\\";
+		break;
+	      case '\n':
+		o << "\\n";
+		break;
+	      case '\t':
+		o << "\\t";
+		break;
+	      default:
+		if ((unsigned char) c < 0x20)
+		  o << boost::format ("\\u%04x") % (int) c;
+		else
+		  o << c;
+	      }
+	  }
+      }
+    } // end of anonymous namespace.
+
+    TraceEventOutput::TraceEventOutput (std::string filename,
+					std::size_t capacity,
+					OverflowPolicy policy)
+      : filename (filename),
+	stream (),
+	pid_ (processId ())
+    {
+      stream.open (getFilename ().c_str ());
+      stream << "[\n";
+      startAsynchronous (stream, capacity, policy);
+      Profiler::addObserver (this);
+    }
+
+    TraceEventOutput::~TraceEventOutput ()
+    {
+      Profiler::removeObserver (this);
+      // The writer thread must be stopped before the array is closed.
+      setSynchronous ();
+      stream << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":"
+	     << pid_ << ",\"args\":{\"name\":\"hpp\"}}\n]\n";
+    }
+
+    std::string
+    TraceEventOutput::getFilename () const
+    {
+      static const std::string packageName = "hpp";
+
+      boost::format fmter ("%1%.%2%.json");
+      fmter % filename % pid_;
+      return debug::getFilename (fmter.str (), packageName);
+    }
+
+    void
+    TraceEventOutput::write (const Channel& channel,
+			     char const* file,
+			     int line,
+			     char const*,
+			     boost::string_ref data)
+    {
+      // Records end with a newline.
+      if (!data.empty () && data[data.size () - 1] == '\n')
+	data.remove_suffix (1);
+      writeEvent ('i', data, channel.label (), steadyNow (), file, line);
+    }
+
+    void
+    TraceEventOutput::regionBegin (char const* name, boost::uint64_t time)
+    {
+      writeEvent ('B', name, "region", time);
+    }
+
+    void
+    TraceEventOutput::regionEnd (char const* name,
+				 boost::uint64_t time,
+				 boost::uint64_t)
+    {
+      writeEvent ('E', name, "region", time);
+    }
+
+    void
+    TraceEventOutput::writeEvent (char phase,
+				  boost::string_ref name,
+				  boost::string_ref category,
+				  boost::uint64_t time,
+				  char const* file,
+				  int line)
+    {
+      if (!isAsynchronous ())
+	return;
+
+      ScopedFormatStream event;
+      std::ostream& o = event.stream ();
+      o << "{\"name\":\"";
+      writeEscaped (o, name);
+      o << "\",\"cat\":\"";
+      writeEscaped (o, category);
+      // Timestamps are microseconds with a nanosecond fraction.
+      o << "\",\"ph\":\"" << phase << "\",\"ts\":" << time / 1000 << '.'
+	<< std::setw (3) << std::setfill ('0') << time % 1000
+	<< ",\"pid\":" << pid_ << ",\"tid\":" << threadId ();
+      if (phase == 'i')
+	o << ",\"s\":\"t\"";
+      if (file)
+	{
+	  o << ",\"args\":{\"file\":\"";
+	  writeEscaped (o, file);
+	  o << "\",\"line\":" << line << '}';
+	}
+      o << "},\n";
+      push (event.str ());
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
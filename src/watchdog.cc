@@ -0,0 +1,407 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <boost/format.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+# ifdef __linux__
+#  include <sys/syscall.h>
+# endif // __linux__
+#endif // HAVE_UNISTD_H
+
+#include "hpp/util/clock.hh"
+#include "hpp/util/debug.hh"
+#include "hpp/util/format-buffer.hh"
+#include "hpp/util/indent.hh"
+#include "hpp/util/watchdog.hh"
+
+namespace hpp
+{
+  namespace debug
+  {
+    /// \brief Region slot of a thread, read by the watchdog.
+    ///
+    /// The generation is odd while a region is open. The owner thread
+    /// writes the other fields while it is even, so that the watchdog
+    /// can read them consistently (as a sequence lock):
+    /// \li the owner opens a region with a release fence, the field
+    ///     stores, then a release increment of the generation,
+    /// \li it closes the region with a release increment,
+    /// \li the watchdog loads the generation (acquire), the fields,
+    ///     then, after an acquire fence, the generation again; the
+    ///     fields are only used if both generations are the same odd
+    ///     value.
+    struct WatchedRegion
+    {
+      boost::atomic<boost::uint64_t> generation;
+      boost::atomic<Deadline*> deadline;
+      boost::atomic<boost::uint64_t> start;
+      /// \brief Last generation reported, used by the watchdog only.
+      boost::uint64_t reported;
+    };
+
+    namespace
+    {
+      const std::size_t maxDepth = 16;
+
+      /// \brief Regions of a thread.
+      ///
+      /// Never freed: the records of finished threads are reused.
+      struct HPP_UTIL_LOCAL ThreadRegions
+      {
+	ThreadRegions ()
+	  : inUse (true),
+	    id (0),
+	    depth (0),
+	    next (0)
+	{
+	  for (std::size_t i = 0; i < maxDepth; ++i)
+	    {
+	      regions[i].generation.store (0);
+	      regions[i].deadline.store (0);
+	      regions[i].start.store (0);
+	      regions[i].reported = 0;
+	    }
+	}
+
+	boost::atomic<bool> inUse;
+	boost::atomic<unsigned long> id;
+	/// \brief Number of open regions, used by the owner only.
+	std::size_t depth;
+	WatchedRegion regions[maxDepth];
+	ThreadRegions* next;
+      };
+
+      /// \brief Head of the list of thread records.
+      ///
+      /// Zero-initialized before any region can be entered.
+      boost::atomic<ThreadRegions*> threads;
+      boost::atomic<Deadline*> deadlines;
+      boost::atomic<boost::uint64_t> reportedCount;
+      /// \brief Time between checks, 0 for the default.
+      boost::atomic<boost::uint64_t> checkPeriod;
+
+      const boost::uint64_t defaultPeriod = 10 * 1000 * 1000;
+
+      enum ThreadState
+	{
+	  NOT_STARTED,
+	  RUNNING,
+	  STOPPED
+	};
+
+      boost::atomic<int> state;
+
+      /// \brief Identifier of the calling thread, as shown by the
+      /// system tools when available.
+      HPP_UTIL_LOCAL unsigned long
+      threadId ()
+      {
+#if defined HAVE_UNISTD_H && defined __linux__ && defined SYS_gettid
+	return (unsigned long) syscall (SYS_gettid);
+#else
+	static boost::atomic<unsigned long> nextId (1);
+	return nextId++;
+#endif // HAVE_UNISTD_H && __linux__ && SYS_gettid
+      }
+
+      HPP_UTIL_LOCAL void
+      releaseRegions (ThreadRegions* regions)
+      {
+	regions->inUse.store (false);
+      }
+
+      HPP_UTIL_LOCAL ThreadRegions&
+      localRegions ()
+      {
+	// Never destroyed: regions may be entered during static
+	// destruction.
+	static boost::thread_specific_ptr<ThreadRegions>* locals =
+	  new boost::thread_specific_ptr<ThreadRegions> (&releaseRegions);
+	ThreadRegions* regions = locals->get ();
+	if (regions)
+	  return *regions;
+
+	for (regions = threads.load (); regions; regions = regions->next)
+	  {
+	    bool inUse = false;
+	    if (regions->inUse.compare_exchange_strong (inUse, true))
+	      break;
+	  }
+	if (!regions)
+	  {
+	    regions = new ThreadRegions ();
+	    regions->next = threads.load ();
+	    while (!threads.compare_exchange_weak (regions->next, regions))
+	      {}
+	  }
+	regions->id.store (threadId ());
+	regions->depth = 0;
+	locals->reset (regions);
+	return *regions;
+      }
+
+      HPP_UTIL_LOCAL void
+      report (const Deadline& deadline, unsigned long thread,
+	      boost::uint64_t elapsed)
+      {
+	reportedCount.fetch_add (1, boost::memory_order_relaxed);
+	if (!logging.warning.isEnabled ())
+	  return;
+	ScopedFormatStream message;
+	message.stream ()
+	  << boost::format ("region %1% on thread %2% open for %3% ms, "
+			    "over its budget of %4% ms")
+	  % deadline.name () % thread % ((double) elapsed * 1e-6)
+	  % ((double) deadline.budget () * 1e-6)
+	  << inl;
+	logging.warning.write (__FILE__, __LINE__, __PRETTY_FUNCTION__,
+			       message.str ());
+      }
+
+      /// \brief Wakes the watchdog thread up to stop it.
+      struct HPP_UTIL_LOCAL Wakeup
+      {
+	boost::mutex mutex;
+	boost::condition_variable condition;
+	boost::thread thread;
+      };
+
+      // Never destroyed: the thread is stopped by Logging.
+      HPP_UTIL_LOCAL Wakeup&
+      wakeup ()
+      {
+	static Wakeup* wakeup = new Wakeup ();
+	return *wakeup;
+      }
+
+      HPP_UTIL_LOCAL void
+      run ()
+      {
+	Wakeup& w = wakeup ();
+	boost::unique_lock<boost::mutex> lock (w.mutex);
+	while (state.load () == RUNNING)
+	  {
+	    boost::uint64_t period = Watchdog::period () / 1000;
+	    w.condition.timed_wait
+	      (lock, boost::posix_time::microseconds
+	       ((long) (period ? period : 1)));
+	    if (state.load () != RUNNING)
+	      break;
+	    lock.unlock ();
+	    Watchdog::check ();
+	    lock.lock ();
+	  }
+      }
+
+      HPP_UTIL_LOCAL void
+      startWatchdog ()
+      {
+	Wakeup& w = wakeup ();
+	boost::lock_guard<boost::mutex> lock (w.mutex);
+	int notStarted = NOT_STARTED;
+	if (state.compare_exchange_strong (notStarted, RUNNING))
+	  w.thread = boost::thread (&run);
+      }
+    } // end of anonymous namespace.
+
+    Deadline::Deadline (char const* name,
+			boost::uint64_t budget,
+			char const* file,
+			int line)
+      : name_ (name),
+	budget_ (budget),
+	file_ (file),
+	line_ (line),
+	completed_ (0),
+	overBudget_ (0),
+	reported_ (0),
+	next_ (deadlines.load ())
+    {
+      while (!deadlines.compare_exchange_weak (next_, this))
+	{}
+      startWatchdog ();
+    }
+
+    char const*
+    Deadline::name () const
+    {
+      return name_;
+    }
+
+    boost::uint64_t
+    Deadline::budget () const
+    {
+      return budget_;
+    }
+
+    boost::uint64_t
+    Deadline::completed () const
+    {
+      return completed_.load ();
+    }
+
+    boost::uint64_t
+    Deadline::overBudget () const
+    {
+      return overBudget_.load ();
+    }
+
+    void
+    Deadline::logSummary ()
+    {
+      for (Deadline* deadline = deadlines.load (); deadline;
+	   deadline = deadline->next_)
+	{
+	  boost::uint64_t overBudget = deadline->overBudget ();
+	  if (overBudget == deadline->reported_
+	      || !logging.warning.isEnabled ())
+	    continue;
+
+	  ScopedFormatStream summary;
+	  summary.stream ()
+	    << boost::format ("%1% region(s) %2% over the budget of %3% ms, "
+			      "%4% of %5% in total")
+	    % (overBudget - deadline->reported_) % deadline->name_
+	    % ((double) deadline->budget_ * 1e-6) % overBudget
+	    % deadline->completed ()
+	    << inl;
+	  logging.warning.write (deadline->file_, deadline->line_,
+				 __PRETTY_FUNCTION__, summary.str ());
+	  deadline->reported_ = overBudget;
+	}
+    }
+
+    DeadlineScope::DeadlineScope (Deadline& deadline)
+      : deadline_ (&deadline),
+	region_ (0),
+	start_ (steadyNow ())
+    {
+      ThreadRegions& regions = localRegions ();
+      if (regions.depth < maxDepth)
+	{
+	  region_ = &regions.regions[regions.depth];
+	  // Order the field stores after the closing increment of the
+	  // previous region: a release operation only orders the writes
+	  // preceding it. A watchdog reading one of these fields then
+	  // sees, after its acquire fence, the generation at least
+	  // closed, and discards the fields.
+	  boost::atomic_thread_fence (boost::memory_order_release);
+	  region_->deadline.store (deadline_, boost::memory_order_relaxed);
+	  region_->start.store (start_, boost::memory_order_relaxed);
+	  // Open: publish the fields.
+	  region_->generation.fetch_add (1, boost::memory_order_release);
+	}
+      ++regions.depth;
+    }
+
+    DeadlineScope::~DeadlineScope ()
+    {
+      stop ();
+    }
+
+    void
+    DeadlineScope::stop ()
+    {
+      if (!deadline_)
+	return;
+      boost::uint64_t duration = steadyNow () - start_;
+      if (region_)
+	region_->generation.fetch_add (1, boost::memory_order_release);
+      --localRegions ().depth;
+      deadline_->completed_.fetch_add (1, boost::memory_order_relaxed);
+      if (duration > deadline_->budget_)
+	deadline_->overBudget_.fetch_add (1, boost::memory_order_relaxed);
+      deadline_ = 0;
+    }
+
+    void
+    Watchdog::setPeriod (boost::uint64_t period)
+    {
+      checkPeriod.store (period);
+    }
+
+    boost::uint64_t
+    Watchdog::period ()
+    {
+      boost::uint64_t period = checkPeriod.load ();
+      return period ? period : defaultPeriod;
+    }
+
+    void
+    Watchdog::check ()
+    {
+      // Serialize the checks made by the thread and by the callers.
+      static boost::mutex* mutex = new boost::mutex ();
+      boost::lock_guard<boost::mutex> lock (*mutex);
+      boost::uint64_t now = steadyNow ();
+      for (ThreadRegions* t = threads.load (); t; t = t->next)
+	for (std::size_t i = 0; i < maxDepth; ++i)
+	  {
+	    WatchedRegion& region = t->regions[i];
+	    boost::uint64_t generation =
+	      region.generation.load (boost::memory_order_acquire);
+	    // Closed regions are not nested in any open region.
+	    if (!(generation & 1))
+	      break;
+	    if (generation == region.reported)
+	      continue;
+	    Deadline* deadline =
+	      region.deadline.load (boost::memory_order_relaxed);
+	    boost::uint64_t start =
+	      region.start.load (boost::memory_order_relaxed);
+	    unsigned long id = t->id.load (boost::memory_order_relaxed);
+	    boost::atomic_thread_fence (boost::memory_order_acquire);
+	    if (region.generation.load (boost::memory_order_relaxed)
+		!= generation)
+	      continue;
+	    if (now > start && now - start > deadline->budget_)
+	      {
+		region.reported = generation;
+		report (*deadline, id, now - start);
+	      }
+	  }
+    }
+
+    boost::uint64_t
+    Watchdog::reported ()
+    {
+      return reportedCount.load ();
+    }
+
+    void
+    Watchdog::stop ()
+    {
+      Wakeup& w = wakeup ();
+      {
+	boost::lock_guard<boost::mutex> lock (w.mutex);
+	if (state.exchange (STOPPED) != RUNNING)
+	  return;
+	w.condition.notify_all ();
+      }
+      w.thread.join ();
+    }
+
+  } // end of namespace debug
+} // end of namespace hpp
@@ -0,0 +1,150 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "config.h"
+
+#define HPP_ENABLE_BENCHMARK 1
+#define HPP_DEBUG_CHANNEL_BENCHMARK 1
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <hpp/util/allocation-tracker.hh>
+#include <hpp/util/timer.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+struct Region
+{
+  Region ()
+    : calls (0),
+      allocations (0),
+      deallocations (0),
+      bytes (0),
+      peak (0)
+  {}
+
+  unsigned long calls;
+  unsigned long allocations;
+  unsigned long deallocations;
+  unsigned long bytes;
+  long peak;
+  std::string residentSetSize;
+};
+
+int run_test ();
+
+/// \brief Allocate 10 blocks of 1000 bytes, 10000 bytes live at most.
+static void
+sample ()
+{
+  hppProfileScope (sample);
+  std::vector<char*> blocks;
+  blocks.reserve (10);
+  for (int i = 0; i < 10; ++i)
+    blocks.push_back (new char[1000]);
+  for (int i = 0; i < 10; ++i)
+    delete [] blocks[i];
+}
+
+/// \brief Find region \a name in the report.
+static Region
+find (const std::string& report, const std::string& name)
+{
+  Region region;
+  std::istringstream lines (report);
+  std::string line;
+  while (std::getline (lines, line))
+    if (line.size () > 79 && line.substr (79) == name)
+      {
+	std::istringstream fields (line);
+	fields >> region.calls >> region.allocations >> region.deallocations
+	       >> region.bytes >> region.peak >> region.residentSetSize;
+      }
+  return region;
+}
+
+int run_test ()
+{
+  AllocationCounters before = AllocationTracker::current ();
+  int* value = new int (1);
+  AllocationCounters after = AllocationTracker::current ();
+  delete value;
+  if (after.allocations != before.allocations + 1
+      || after.bytes != before.bytes + sizeof (int)
+      || after.live != before.live + (long) sizeof (int)
+      || AllocationTracker::current ().live != before.live)
+    return TEST_FAILED;
+
+  hppStartBenchmark (plan);
+  for (int i = 0; i < 3; ++i)
+    sample ();
+  // Live at the end of the region.
+  char* kept = new char[500];
+  hppStopBenchmark (plan);
+  delete [] kept;
+
+  std::ostringstream report;
+  AllocationTracker::print (report);
+  std::cout << report.str ();
+
+  // The vector buffer of sample is counted as well.
+  Region sampleRegion = find (report.str (), "sample");
+  if (sampleRegion.calls != 3
+      || sampleRegion.allocations != 3 * 11
+      || sampleRegion.deallocations != 3 * 11
+      || sampleRegion.bytes != 3 * (10000 + 10 * sizeof (char*))
+      || sampleRegion.peak != (long) (10000 + 10 * sizeof (char*)))
+    return TEST_FAILED;
+  // Child regions are included.
+  Region plan = find (report.str (), "plan");
+  if (plan.calls != 1
+      || plan.allocations < sampleRegion.allocations + 1
+      || plan.bytes < sampleRegion.bytes + 500
+      || plan.peak < sampleRegion.peak)
+    return TEST_FAILED;
+
+  // The resident set size is only read around outermost regions.
+  if (sampleRegion.residentSetSize != "-" || plan.residentSetSize == "-")
+    return TEST_FAILED;
+  if (AllocationTracker::residentSetSize () == 0)
+    std::cout << "resident set size not available" << std::endl;
+
+  // The report goes to the benchmark channel.
+  RecordingOutput output;
+  logging.benchmark.subscribe (&output);
+  AllocationTracker::logReport ();
+  logging.benchmark.unsubscribe (&output);
+  if (output.records.size () != 1
+      || output.records[0].find ("sample") == std::string::npos)
+    return TEST_FAILED;
+
+  // Nothing is left to report after a reset.
+  AllocationTracker::reset ();
+  std::ostringstream empty;
+  AllocationTracker::print (empty);
+  if (find (empty.str (), "sample").calls != 0)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
@@ -0,0 +1,125 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Make sure assertions are enabled and profiled.
+#ifndef HPP_ENABLE_ASSERTIONS
+# define HPP_ENABLE_ASSERTIONS
+#endif // !HPP_ENABLE_ASSERTIONS
+#define HPP_PROFILE_ASSERTIONS 1
+
+#include "config.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <hpp/util/assertion.hh>
+
+#include "common.hh"
+
+int run_test ();
+int cheap (int a);
+bool sorted (const int* values, int size);
+
+int cheap (int a)
+{
+  HPP_ASSERT (a >= 0);
+  return a + 1;
+}
+
+bool sorted (const int* values, int size)
+{
+  for (int i = 1; i < size; ++i)
+    if (values[i] < values[i - 1])
+      return false;
+  return true;
+}
+
+/// \brief Mean time of the evaluations of \a condition in the
+/// report, in nanoseconds.
+static double
+meanTime (const std::string& report, const std::string& condition)
+{
+  std::istringstream lines (report);
+  std::string line;
+  while (std::getline (lines, line))
+    if (line.find (condition) != std::string::npos)
+      {
+	unsigned long evaluations;
+	double total, mean;
+	std::istringstream fields (line);
+	fields >> evaluations >> total >> mean;
+	return mean;
+      }
+  return -1;
+}
+
+int run_test ()
+{
+  static int values[100000];
+  for (int i = 0; i < 100000; ++i)
+    values[i] = cheap (i);
+  // Far more expensive in total than the cheap site, whatever the
+  // clock resolution.
+  for (int i = 0; i < 1000; ++i)
+    HPP_ASSERT (sorted (values, 100000));
+
+  // Failures are evaluations too.
+  try
+    {
+      cheap (-1);
+      return TEST_FAILED;
+    }
+  catch (const hpp::AssertionError&)
+    {}
+
+  // Sites are registered once, when first checked.
+  std::ostringstream report;
+  hpp::Assertion::printProfile (report);
+  std::cout << report.str ();
+  std::string s = report.str ();
+  std::string::size_type expensive = s.find ("sorted (values, 100000)");
+  std::string::size_type inexpensive = s.find ("a >= 0");
+  if (expensive == std::string::npos || inexpensive == std::string::npos
+      || s.find ("a >= 0", inexpensive + 1) != std::string::npos)
+    return TEST_FAILED;
+  if (meanTime (s, "sorted (values, 100000)") <= meanTime (s, "a >= 0"))
+    return TEST_FAILED;
+  if (s.find (" 100001 ") == std::string::npos
+      || s.find (" 1000 ") == std::string::npos)
+    return TEST_FAILED;
+
+  // Only the most expensive site.
+  std::ostringstream top;
+  hpp::Assertion::printProfile (top, 1);
+  if (top.str ().find ("a >= 0") != std::string::npos
+      || top.str ().find ("sorted") == std::string::npos)
+    return TEST_FAILED;
+
+  // Sites are not evaluated when their level is disabled.
+  hpp::Assertion::setLevel (hpp::ASSERTION_CHEAP);
+  cheap (-1);
+  hpp::Assertion::setLevel (hpp::ASSERTION_AUDIT);
+  std::ostringstream disabled;
+  hpp::Assertion::printProfile (disabled);
+  if (disabled.str ().find (" 100001 ") == std::string::npos)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
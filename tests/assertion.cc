@@ -20,11 +20,14 @@
 #ifndef HPP_ENABLE_ASSERTIONS
 # define HPP_ENABLE_ASSERTIONS
 #endif // !HPP_ENABLE_ASSERTIONS
+// Compile all the levels in.
+#define HPP_ASSERTION_LEVEL 3
 
 #include "config.h"
 
 #include <cassert>
 #include <iostream>
+#include <string>
 #include <hpp/util/assertion.hh>
 
 #include "common.hh"
@@ -93,7 +96,40 @@ int run_test ()
       std::cout << assertionError << std::endl;
     }
 
-  // Check for postcondition failure.
+  // The failure names the condition and the site.
+  try
+    {
+      HPP_ASSERT_AUDIT (1 + 1 == 3);
+      return TEST_FAILED;
+    }
+  catch (::hpp::AssertionError& assertionError)
+    {
+      std::cout << assertionError << std::endl;
+      if (std::string (assertionError.message ())
+	  != "1 + 1 == 3 evaluates to false"
+	  || assertionError.file () != std::string (__FILE__))
+	return TEST_FAILED;
+    }
+
+  // Only the cheap assertions are checked at this level.
+  ::hpp::Assertion::setLevel (::hpp::ASSERTION_CHEAP);
+  if (::hpp::Assertion::level () != ::hpp::ASSERTION_CHEAP)
+    return TEST_FAILED;
+  HPP_ASSERT (false);
+  HPP_ASSERT_AUDIT (false);
+  try
+    {
+      HPP_ASSERT_CHEAP (false);
+      return TEST_FAILED;
+    }
+  catch (::hpp::AssertionError& assertionError)
+    {
+      std::cout << assertionError << std::endl;
+    }
+  ::hpp::Assertion::setLevel (::hpp::ASSERTION_AUDIT);
+
+  // Check for postcondition failure. Last: from C++11, the failure is
+  // thrown from a destructor and terminates the test.
   try
     {
       my_broken_plus_function (3, 5);
@@ -0,0 +1,222 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <hpp/util/debug.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+/// \brief Output storing records in memory.
+class StringOutput : public Output
+{
+public:
+  ~StringOutput ()
+  {
+    setSynchronous ();
+  }
+
+  void write (const Channel& channel,
+	      char const* file,
+	      int line,
+	      char const* function,
+	      boost::string_ref data)
+  {
+    std::ostringstream record;
+    writePrefix (record, channel, file, line, function);
+    record << data;
+    push (record.str ());
+  }
+
+  void setAsynchronous (std::size_t capacity, OverflowPolicy policy)
+  {
+    startAsynchronous (stream, capacity, policy);
+  }
+
+  std::size_t countLines () const
+  {
+    std::string s = stream.str ();
+    std::size_t res = 0;
+    for (std::size_t i = 0; i < s.size (); ++i)
+      if (s[i] == '\n')
+	++res;
+    return res;
+  }
+
+  std::ostringstream stream;
+};
+
+/// \brief Stream buffer keeping the lines written, which can be
+/// looked up while the writer thread writes.
+class LineBuffer : public std::streambuf
+{
+public:
+  bool contains (const std::string& line)
+  {
+    boost::lock_guard<boost::mutex> lock (mutex);
+    return lines.count (line) != 0;
+  }
+
+protected:
+  int overflow (int c)
+  {
+    boost::lock_guard<boost::mutex> lock (mutex);
+    if (c == '\n')
+      {
+	lines.insert (current);
+	current.clear ();
+      }
+    else if (c != traits_type::eof ())
+      current += (char) c;
+    return traits_type::not_eof (c);
+  }
+
+private:
+  boost::mutex mutex;
+  std::string current;
+  std::set<std::string> lines;
+};
+
+/// \brief Output writing the records to a LineBuffer.
+class LineOutput : public Output
+{
+public:
+  LineOutput ()
+    : buffer (),
+      stream (&buffer)
+  {}
+
+  ~LineOutput ()
+  {
+    setSynchronous ();
+  }
+
+  void write (const Channel&, char const*, int, char const*,
+	      boost::string_ref data)
+  {
+    push (data);
+  }
+
+  void setAsynchronous (std::size_t capacity, OverflowPolicy policy)
+  {
+    startAsynchronous (stream, capacity, policy);
+  }
+
+  LineBuffer buffer;
+  std::ostream stream;
+};
+
+static const int nThreads = 4;
+static const int nRecords = 10000;
+
+void produce (Channel* channel);
+int testPolicy (Output::OverflowPolicy policy, std::size_t capacity);
+void produceAndFlush (Channel* channel, LineOutput* output, int thread,
+		      bool* found);
+int testFlush ();
+int run_test ();
+
+void produce (Channel* channel)
+{
+  for (int i = 0; i < nRecords; ++i)
+    channel->write (__FILE__, __LINE__, __PRETTY_FUNCTION__, "record\n");
+}
+
+int testPolicy (Output::OverflowPolicy policy, std::size_t capacity)
+{
+  StringOutput output;
+  output.setAsynchronous (capacity, policy);
+  Channel channel ("TEST", boost::assign::list_of<Output*> (&output));
+
+  boost::thread_group producers;
+  for (int i = 0; i < nThreads; ++i)
+    producers.create_thread (boost::bind (&produce, &channel));
+  producers.join_all ();
+  output.flush ();
+
+  std::size_t written = output.countLines ();
+  unsigned long long dropped = output.droppedRecords ();
+  std::cout << "policy " << policy << ": " << written << " written, "
+	    << dropped << " dropped" << std::endl;
+
+  if (written + dropped != (std::size_t) (nThreads * nRecords))
+    return TEST_FAILED;
+  if (policy == Output::BLOCK && dropped)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+void produceAndFlush (Channel* channel, LineOutput* output, int thread,
+		      bool* found)
+{
+  *found = true;
+  for (int i = 0; i < 1000; ++i)
+    {
+      std::string line = "record " + boost::lexical_cast<std::string> (thread)
+	+ " " + boost::lexical_cast<std::string> (i);
+      std::string record = line + "\n";
+      channel->write (__FILE__, __LINE__, __PRETTY_FUNCTION__, record);
+      output->flush ();
+      if (!output->buffer.contains (line))
+	*found = false;
+    }
+}
+
+/// \brief A flush writes the records of the calling thread, even when
+/// other threads have not finished pushing theirs.
+int testFlush ()
+{
+  LineOutput output;
+  output.setAsynchronous (64, Output::BLOCK);
+  Channel channel ("TEST", boost::assign::list_of<Output*> (&output));
+  bool found[nThreads];
+  boost::thread_group producers;
+  for (int i = 0; i < nThreads; ++i)
+    producers.create_thread (boost::bind (&produceAndFlush, &channel, &output,
+					  i, &found[i]));
+  producers.join_all ();
+  for (int i = 0; i < nThreads; ++i)
+    if (!found[i])
+      return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+int run_test ()
+{
+  int status = TEST_SUCCEED;
+  status |= testPolicy (Output::BLOCK, 16);
+  status |= testPolicy (Output::DROP_NEWEST, 16);
+  status |= testPolicy (Output::DROP_OLDEST, 16);
+  status |= testFlush ();
+  return status;
+}
+
+GENERATE_TEST ()
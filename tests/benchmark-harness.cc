@@ -0,0 +1,130 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include <hpp/util/benchmark.hh>
+
+#include "common.hh"
+
+using namespace hpp::benchmark;
+
+int run_test ();
+
+static void
+sum (State& state)
+{
+  int x = 0;
+  while (state.keepRunning ())
+    {
+      x += 1;
+      doNotOptimize (x);
+    }
+}
+HPP_BENCHMARK (sum);
+
+static void
+slowSum (State& state)
+{
+  while (state.keepRunning ())
+    for (int i = 0; i < 100; ++i)
+      doNotOptimize (i);
+}
+HPP_BENCHMARK (slowSum);
+
+int run_test ()
+{
+  Options options;
+  char program[] = "benchmark-harness";
+  char repetitions[] = "--repetitions=3";
+  char minTime[] = "--min-time=0.002";
+  char warmup[] = "--warmup=0.001";
+  char* argv[] = { program, repetitions, minTime, warmup };
+  if (!options.parse (4, argv, std::cerr) || options.repetitions != 3)
+    return TEST_FAILED;
+
+  checkEnvironment (std::cout);
+  results_t results = run (options);
+  printText (std::cout, results);
+  if (results.size () != 2)
+    return TEST_FAILED;
+  for (std::size_t i = 0; i < results.size (); ++i)
+    {
+      const Result& r = results[i];
+      if (r.repetitions != 3 || r.iterations == 0
+	  || r.min > r.median || r.median > r.min + 3 * r.stddev + r.mean)
+	return TEST_FAILED;
+    }
+  if (results[1].median <= results[0].median)
+    return TEST_FAILED;
+
+  // JSON results can be read back.
+  std::stringstream json;
+  printJson (json, results);
+  std::cout << json.str ();
+  results_t read = readJson (json);
+  if (read.size () != 2 || read[1].name != "slowSum"
+      || read[1].iterations != results[1].iterations
+      || std::abs (read[1].median - results[1].median) > 1e-3)
+    return TEST_FAILED;
+
+  // Reformatted results are read as well, malformed ones rejected.
+  std::istringstream reformatted
+    ("{\"benchmarks\": [{\n \"name\": \"sum\",\n \"iterations\": 10,\n"
+     " \"repetitions\": 1, \"min_ns\": 1, \"median_ns\": 2.5,\n"
+     " \"mean_ns\": 2, \"stddev_ns\": 0}]}");
+  results_t hand = readJson (reformatted);
+  if (hand.size () != 1 || hand[0].name != "sum" || hand[0].median != 2.5)
+    return TEST_FAILED;
+  std::istringstream truncated ("{\"benchmarks\": [{\"name\": \"sum\"");
+  CHECK_FAILURE (std::runtime_error, readJson (truncated));
+  std::istringstream incomplete ("{\"benchmarks\": [{\"name\": \"sum\"}]}");
+  CHECK_FAILURE (std::runtime_error, readJson (incomplete));
+
+  // Slowdowns above the threshold are regressions.
+  if (compare (std::cout, results, read, .1) != 0)
+    return TEST_FAILED;
+  read[0].median /= 2;
+  if (compare (std::cout, results, read, .1) != 1)
+    return TEST_FAILED;
+
+  // The iteration count is capped for benchmarks too fast to reach
+  // the minimum time.
+  Options capped;
+  capped.repetitions = 1;
+  capped.warmupTime = 0;
+  capped.minTime = 10;
+  capped.maxIterations = 1000;
+  capped.filter = "sum";
+  results_t fast = run (capped);
+  printText (std::cout, fast);
+  if (fast.size () != 1 || !fast[0].tooFast || fast[0].iterations != 1000)
+    return TEST_FAILED;
+  if (results[0].tooFast || results[1].tooFast)
+    return TEST_FAILED;
+
+  options.filter = "slow";
+  if (run (options).size () != 1)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
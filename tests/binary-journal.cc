@@ -0,0 +1,225 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+// Log through the binary records of the macros.
+#ifndef HPP_DEBUG
+# define HPP_DEBUG
+#endif // !HPP_DEBUG
+#define HPP_BINARY_JOURNAL
+
+#include "config.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/filesystem.hpp>
+
+#include <hpp/util/debug.hh>
+
+#include "common.hh"
+
+using namespace hpp;
+using namespace hpp::debug;
+
+/// \brief Format of a call site and text of a message, decoded from
+/// a binary journal.
+struct Entry
+{
+  std::string format;
+  std::string text;
+};
+
+int run_test ();
+
+template <typename T>
+static bool
+read (std::istream& stream, T& value)
+{
+  stream.read (reinterpret_cast<char*> (&value), sizeof (T));
+  return !stream.fail ();
+}
+
+static bool
+read (std::istream& stream, std::string& value)
+{
+  boost::uint32_t length;
+  if (!read (stream, length))
+    return false;
+  value.resize (length);
+  return length == 0 || stream.read (&value[0], length);
+}
+
+/// \brief Decode the messages of journal \a filename.
+///
+/// \return false if the journal is not valid
+static bool
+decode (const std::string& filename, std::vector<Entry>& entries)
+{
+  std::ifstream stream (filename.c_str (), std::ios_base::binary);
+  std::string magic (std::strlen (HPP_UTIL_BINARY_JOURNAL_MAGIC), '\0');
+  if (!stream.read (&magic[0], (std::streamsize) magic.size ())
+      || magic != HPP_UTIL_BINARY_JOURNAL_MAGIC)
+    return false;
+
+  std::map<boost::uint32_t, std::string> formats;
+  char kind;
+  while (stream.get (kind))
+    {
+      boost::uint32_t id;
+      if (!read (stream, id))
+	return false;
+      if (kind == ENTRY_SITE)
+	{
+	  boost::int32_t line;
+	  std::string channel, file, function;
+	  if (!read (stream, line) || !read (stream, channel)
+	      || !read (stream, file) || !read (stream, function)
+	      || !read (stream, formats[id]))
+	    return false;
+	  continue;
+	}
+
+      boost::uint64_t timestamp;
+      boost::uint32_t size;
+      std::string data;
+      if (kind != ENTRY_MESSAGE || !formats.count (id)
+	  || !read (stream, timestamp) || !read (stream, size))
+	return false;
+      data.resize (size);
+      if (size && !stream.read (&data[0], size))
+	return false;
+      Entry entry;
+      entry.format = formats[id];
+      std::ostringstream text;
+      if (!BinaryRecord::print (text, data.data (), data.size ()))
+	return false;
+      entry.text = text.str ();
+      entries.push_back (entry);
+    }
+  return stream.eof ();
+}
+
+int run_test ()
+{
+  // Arguments must be formatted as the original stream expression.
+  std::string text ("text");
+  BinaryRecord record;
+  std::ostringstream expected;
+  record << "int " << -42 << ", unsigned " << 42u << ", double " << 3.25
+	 << ", char " << 'c' << ", bool " << true << ", string " << text
+	 << ", hex " << std::hex << 255 << std::dec << incendl << "indented"
+	 << decendl;
+  expected << "int " << -42 << ", unsigned " << 42u << ", double " << 3.25
+	   << ", char " << 'c' << ", bool " << true << ", string " << text
+	   << ", hex " << std::hex << 255 << std::dec << incendl << "indented"
+	   << decendl;
+  std::ostringstream decoded;
+  record.print (decoded);
+  std::cout << decoded.str () << std::endl;
+  if (decoded.str () != expected.str ())
+    return TEST_FAILED;
+
+  // Large records do not fit in the inline storage.
+  BinaryRecord large;
+  std::string long_string (1000, 'x');
+  large << long_string << 1;
+  std::ostringstream decodedLarge;
+  large.print (decodedLarge);
+  if (decodedLarge.str () != long_string + "1")
+    return TEST_FAILED;
+
+  // Format state, including the manipulators taking arguments.
+  BinaryRecord formatted;
+  std::ostringstream expectedFormat;
+  const void* pointer = &text;
+  formatted << std::setprecision (3) << 3.14159 << ' ' << std::setw (6)
+	    << 42 << '|' << std::setw (5) << "ab" << '|' << std::fixed
+	    << 2.5f << ' ' << 18446744073709551615ull << ' ' << pointer
+	    << ' ' << std::setw (4) << std::left << 'x' << '|';
+  expectedFormat << std::setprecision (3) << 3.14159 << ' ' << std::setw (6)
+		 << 42 << '|' << std::setw (5) << "ab" << '|' << std::fixed
+		 << 2.5f << ' ' << 18446744073709551615ull << ' ' << pointer
+		 << ' ' << std::setw (4) << std::left << 'x' << '|';
+  std::ostringstream decodedFormat;
+  formatted.print (decodedFormat);
+  std::cout << decodedFormat.str () << std::endl;
+  if (decodedFormat.str () != expectedFormat.str ())
+    return TEST_FAILED;
+
+  // Write a journal in the build directory.
+  setenv ("HPP_LOGGINGDIR",
+	  boost::filesystem::current_path ().string ().c_str (), 1);
+  std::string filename;
+  {
+    BinaryJournalOutput journal ("binary-journal");
+    Channel channel ("TEST", boost::assign::list_of<Output*> (&journal));
+    static const CallSite site (__FILE__, __LINE__, "run_test", "record");
+    for (int i = 0; i < 10; ++i)
+      channel.write (site, record);
+    channel.write (__FILE__, __LINE__, "run_test", "text record\n");
+    journal.flush ();
+    filename = journal.getFilename ();
+  }
+
+  std::vector<Entry> entries;
+  bool valid = decode (filename, entries);
+  std::remove (filename.c_str ());
+  if (!valid || entries.size () != 11
+      || entries[0].format != "record"
+      || entries[9].text != expected.str ()
+      || entries[10].text != "text record\n")
+    return TEST_FAILED;
+
+  // Records of the logging macros round-trip through the journal.
+  {
+    BinaryJournalOutput journal ("binary-journal-macros");
+    logging.info.subscribe (&journal);
+    for (int i = 0; i < 3; ++i)
+      hppDout (info, "step " << i << " of " << 3u << ", cost "
+	       << std::setprecision (2) << 0.125 * i << ", " << text);
+    logging.info.unsubscribe (&journal);
+    journal.flush ();
+    filename = journal.getFilename ();
+  }
+  entries.clear ();
+  valid = decode (filename, entries);
+  std::remove (filename.c_str ());
+  if (!valid || entries.size () != 3)
+    return TEST_FAILED;
+  for (int i = 0; i < 3; ++i)
+    {
+      std::ostringstream step;
+      step << "step " << i << " of " << 3u << ", cost "
+	   << std::setprecision (2) << 0.125 * i << ", " << text << inl;
+      std::cout << entries[i].text;
+      if (entries[i].text != step.str ()
+	  || entries[i].format.find ("\"step \" << i") == std::string::npos)
+	return TEST_FAILED;
+    }
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
@@ -0,0 +1,57 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+// Keep errors, drop technical information, whatever HPP_DEBUG is.
+#define HPP_DEBUG_CHANNEL_ERROR 1
+#define HPP_DEBUG_CHANNEL_INFO 0
+
+#include <iostream>
+#include <hpp/util/debug.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+static int evaluated = 0;
+
+int evaluate ();
+int run_test ();
+
+int evaluate ()
+{
+  return ++evaluated;
+}
+
+int run_test ()
+{
+  RecordingOutput output;
+  logging.error.subscribe (&output);
+  logging.info.subscribe (&output);
+
+  hppDout (error, "compiled in " << evaluate ());
+  hppDout (info, "compiled out " << evaluate ());
+
+  std::cout << output.records.size () << " record(s), "
+	    << evaluated << " evaluation(s)" << std::endl;
+  if (output.records.size () != 1 || evaluated != 1)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
@@ -0,0 +1,80 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <iostream>
+
+#include <boost/thread/thread.hpp>
+
+#include <hpp/util/clock.hh>
+#include <hpp/util/timer.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+static const boost::uint64_t sleepTime = 20000000;
+
+int run_test ();
+
+int run_test ()
+{
+  std::cout << "TSC: " << calibrateTsc () << " Hz" << std::endl;
+
+  // Wall-time clocks see the sleep, the thread CPU clock does not.
+  ClockSource sources[] = { STEADY_CLOCK, TSC_CLOCK, THREAD_CPU_CLOCK };
+  for (int i = 0; i < 3; ++i)
+    {
+      Timer timer (sources[i], true);
+      boost::this_thread::sleep
+	(boost::posix_time::microseconds (sleepTime / 1000));
+      timer.stop ();
+      boost::uint64_t duration = timer.durationNs ();
+      std::cout << "clock " << sources[i] << ": " << duration << " ns, "
+		<< "overhead " << Timer::overhead (sources[i]) << " ns"
+		<< std::endl;
+      if (timer.getStopNs () < timer.getStartNs ())
+	return TEST_FAILED;
+      if (sources[i] == THREAD_CPU_CLOCK
+	  ? duration >= sleepTime / 2
+	  : duration < sleepTime || duration > 10 * sleepTime)
+	return TEST_FAILED;
+      if (timer.duration ().total_microseconds ()
+	  != (boost::int64_t) (duration / 1000))
+	return TEST_FAILED;
+    }
+
+  // Compensation removes the cost of nested timers.
+  Timer::setOverheadCompensation (true);
+  Timer outer (true);
+  for (int i = 0; i < 1000; ++i)
+    {
+      Timer inner (true);
+      inner.stop ();
+    }
+  outer.stop ();
+  boost::uint64_t raw = outer.getStopNs () - outer.getStartNs ();
+  std::cout << "nested: " << raw << " ns raw, "
+	    << outer.durationNs () << " ns compensated" << std::endl;
+  Timer::setOverheadCompensation (false);
+  if (outer.durationNs () != raw)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
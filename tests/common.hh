@@ -20,11 +20,45 @@
 # define TESTS_COMMON_HH
 # include <stdexcept>
 # include <iostream>
+# include <string>
+# include <vector>
+
+# include <boost/thread/locks.hpp>
+# include <boost/thread/mutex.hpp>
+
+# include <hpp/util/debug.hh>
+
 # include "config.h"
 
 static const int TEST_FAILED = 10;
 static const int TEST_SUCCEED = 0;
 
+/// \brief Keep the records written, from any thread.
+class RecordingOutput : public ::hpp::debug::Output
+{
+public:
+  void write (const ::hpp::debug::Channel&, char const*, int, char const*,
+	      boost::string_ref data)
+  {
+    boost::lock_guard<boost::mutex> lock (mutex);
+    records.push_back (data.to_string ());
+  }
+
+  /// \brief Number of records containing \a text.
+  std::size_t count (const std::string& text)
+  {
+    boost::lock_guard<boost::mutex> lock (mutex);
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < records.size (); ++i)
+      if (records[i].find (text) != std::string::npos)
+	++n;
+    return n;
+  }
+
+  boost::mutex mutex;
+  std::vector<std::string> records;
+};
+
 # define GENERATE_TEST()                                \
   int                                                   \
   main (int argc, char** argv)                          \
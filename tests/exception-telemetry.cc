@@ -0,0 +1,128 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "config.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <hpp/util/debug.hh>
+#include <hpp/util/exception.hh>
+#include <hpp/util/exception-telemetry.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+HPP_MAKE_EXCEPTION_NO_QUALIFIER (RecoverableError);
+
+int run_test ();
+
+static void
+recoverable (int i)
+{
+  try
+    {
+      HPP_THROW_EXCEPTION (RecoverableError, "no solution");
+    }
+  catch (const RecoverableError&)
+    {}
+  if (i % 100 == 0)
+    {
+      try
+	{
+	  HPP_THROW_EXCEPTION_ ("rare");
+	}
+      catch (const hpp::Exception&)
+	{}
+    }
+}
+
+static void
+thrower ()
+{
+  for (int i = 0; i < 1000; ++i)
+    recoverable (i);
+}
+
+int run_test ()
+{
+  RecordingOutput output;
+  logging.info.subscribe (&output);
+  ExceptionTelemetry::setEnabled (true);
+
+  // Only the first exception of each site is logged.
+  boost::thread_group throwers;
+  for (int i = 0; i < 4; ++i)
+    throwers.create_thread (&thrower);
+  throwers.join_all ();
+  ExceptionTelemetry::print (std::cout);
+  if (output.records.size () != 2
+      || output.records[0].find (", first at this site: ")
+      == std::string::npos)
+    return TEST_FAILED;
+
+  exceptionSiteCounts_t sites = ExceptionTelemetry::sites ();
+  if (sites.size () != 2
+      || sites[0].type != "RecoverableError" || sites[0].count != 4000
+      || sites[1].type != "hpp::Exception" || sites[1].count != 40
+      || sites[0].line == sites[1].line
+      || sites[0].file.find ("exception-telemetry.cc") == std::string::npos)
+    return TEST_FAILED;
+
+  // Then they are summarized.
+  ExceptionTelemetry::logSummary ();
+  // In the order of the site table.
+  if (output.records.size () != 4
+      || output.count ("3999 RecoverableError thrown in ") != 1
+      || output.count (", 4000 in total") != 1)
+    return TEST_FAILED;
+  ExceptionTelemetry::logSummary ();
+  if (output.records.size () != 4)
+    return TEST_FAILED;
+
+  // Without summary interval, every exception is logged.
+  ExceptionTelemetry::setSummaryInterval (0);
+  recoverable (1);
+  recoverable (2);
+  ExceptionTelemetry::setSummaryInterval (10000000000ull);
+  if (output.records.size () != 6
+      || output.records[5] != "RecoverableError: no solution\n")
+    return TEST_FAILED;
+
+  // Nothing is counted when disabled.
+  ExceptionTelemetry::setEnabled (false);
+  recoverable (1);
+  logging.info.unsubscribe (&output);
+  if (ExceptionTelemetry::sites ()[0].count != 4002
+      || output.records.size () != 6)
+    return TEST_FAILED;
+
+  // Copies keep the type.
+  RecoverableError error ("copied", __FILE__, __LINE__);
+  RecoverableError copy (error);
+  if (std::string (copy.type ()) != "RecoverableError")
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
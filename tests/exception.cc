@@ -18,7 +18,10 @@
 #include "config.h"
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#include <sstream>
+#include <string>
 #include <hpp/util/exception.hh>
 
 #include "common.hh"
@@ -26,6 +29,12 @@
 HPP_MAKE_EXCEPTION_NO_QUALIFIER (CustomException);
 
 int run_test ();
+void thrower ();
+
+void thrower ()
+{
+  HPP_THROW_EXCEPTION (CustomException, "exception with a stack trace");
+}
 
 int run_test ()
 {
@@ -33,6 +42,33 @@ int run_test ()
 			      "filename",
 			      0);
   std::cout << exception << std::endl;
+  if (std::string (exception.what ())
+      != "filename:0: put your message here"
+      || std::string (exception.message ()) != "put your message here"
+      || exception.line () != 0)
+    return TEST_FAILED;
+
+  // Copies share the message and the formatted text.
+  ::hpp::Exception copy (exception);
+  ::hpp::Exception assigned ("other", __FILE__, __LINE__);
+  assigned = copy;
+  if (copy.what () != exception.what ()
+      || assigned.message () != exception.message ())
+    return TEST_FAILED;
+
+  // A file name given as a string is copied.
+  ::hpp::Exception* copied;
+  {
+    std::string file ("temporary");
+    copied = new ::hpp::Exception ("message", file, 3);
+  }
+  if (std::string (copied->what ()) != "temporary:3: message")
+    return TEST_FAILED;
+  ::hpp::Exception survivor (*copied);
+  delete copied;
+  if (std::string (survivor.file ()) != "temporary"
+      || std::strcmp (survivor.what (), "temporary:3: message") != 0)
+    return TEST_FAILED;
 
   try
     {
@@ -64,7 +100,48 @@ int run_test ()
   catch (::hpp::Exception& exception)
     {
       std::cout << exception << std::endl;
+      if (exception.file () != std::string (__FILE__)
+	  || std::string (exception.message ())
+	  != "this custom exception should be catched")
+	return TEST_FAILED;
+    }
+
+  try
+    {
+      throw CustomException ("message", std::string ("file"), 1);
+    }
+  catch (::hpp::Exception& exception)
+    {
+      if (std::string (exception.what ()) != "file:1: message"
+	  || exception.stackDepth () != 0)
+	return TEST_FAILED;
+    }
+
+  // Stack traces are captured when enabled, symbolized when printed.
+  ::hpp::Exception::setStackTraceEnabled (true);
+  try
+    {
+      thrower ();
+    }
+  catch (::hpp::Exception& exception)
+    {
+      std::ostringstream text;
+      text << exception;
+      std::cout << text.str () << std::endl;
+      if (exception.stackDepth () == 0
+	  || exception.stackDepth () > ::hpp::Exception::maxStackDepth
+	  || text.str ().find ("\n#0  ") == std::string::npos
+	  || std::string (exception.what ()).find ('\n') != std::string::npos)
+	return TEST_FAILED;
+#if defined __GNUC__ && defined __linux__
+      // Exported functions are named.
+      std::ostringstream trace;
+      exception.printStackTrace (trace);
+      if (trace.str ().find ("thrower") == std::string::npos)
+	return TEST_FAILED;
+#endif // __GNUC__ && __linux__
     }
+  ::hpp::Exception::setStackTraceEnabled (false);
   return 0;
 }
 
@@ -0,0 +1,105 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/filesystem.hpp>
+
+#include <hpp/util/flight-recorder.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+static const std::size_t capacity = 1024;
+
+std::string readFile (const std::string& filename);
+int run_test ();
+
+std::string readFile (const std::string& filename)
+{
+  std::ifstream file (filename.c_str ());
+  std::stringstream content;
+  content << file.rdbuf ();
+  return content.str ();
+}
+
+int run_test ()
+{
+  // Keep the dumps in the build directory.
+  setenv ("HPP_LOGGINGDIR",
+	  boost::filesystem::current_path ().string ().c_str (), 1);
+
+  FlightRecorderOutput recorder ("flight-recorder", capacity);
+  Channel channel ("TEST", boost::assign::list_of<Output*> (&recorder));
+  std::string filename = recorder.getFilename ();
+  std::remove (filename.c_str ());
+
+  for (int i = 0; i < 100; ++i)
+    {
+      std::ostringstream record;
+      record << "record " << i << std::endl;
+      channel.write ("file", 1, "run_test", record.str ());
+    }
+  // Nothing is written during normal operation.
+  if (boost::filesystem::exists (filename))
+    return TEST_FAILED;
+
+  // The dump keeps the last whole records.
+  if (!recorder.dump ())
+    return TEST_FAILED;
+  std::string dump = readFile (filename);
+  std::cout << dump;
+  if (dump.empty () || dump.size () > capacity
+      || dump.compare (0, 5, "TEST:") != 0
+      || dump.find ("record 99\n") != dump.size () - 10
+      || dump.find ("record 0\n") != std::string::npos)
+    return TEST_FAILED;
+  std::remove (filename.c_str ());
+
+  // A crashing process dumps its ring from the signal handler.
+  pid_t child = fork ();
+  if (child == 0)
+    {
+      channel.write ("file", 1, "run_test", "last words\n");
+      raise (SIGSEGV);
+      _exit (0);
+    }
+  int status;
+  waitpid (child, &status, 0);
+  if (!WIFSIGNALED (status) || WTERMSIG (status) != SIGSEGV)
+    return TEST_FAILED;
+  dump = readFile (filename);
+  std::remove (filename.c_str ());
+  if (dump.find ("last words\n") == std::string::npos)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
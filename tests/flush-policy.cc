@@ -0,0 +1,144 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <hpp/util/debug.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+int run_test ();
+
+static void
+writeRecords (Channel* channel)
+{
+  for (int i = 0; i < 1000; ++i)
+    channel->write ("file", 1, "run_test", "console record\n");
+}
+
+/// \brief Write from several threads to the console, return the lines
+/// written to std::cerr.
+static std::string
+writeConcurrently (Output::FlushPolicy policy)
+{
+  std::ostringstream captured;
+  std::streambuf* cerr = std::cerr.rdbuf (captured.rdbuf ());
+  {
+    ConsoleOutput console;
+    console.setFlushPolicy (policy, 4096);
+    Channel info ("INFO", boost::assign::list_of<Output*> (&console));
+    boost::thread_group writers;
+    for (int i = 0; i < 8; ++i)
+      writers.create_thread (boost::bind (&writeRecords, &info));
+    writers.join_all ();
+  }
+  std::cerr.rdbuf (cerr);
+  return captured.str ();
+}
+
+/// \brief Whether \a text is made of \a count whole records.
+static bool
+wholeRecords (const std::string& text, std::size_t count)
+{
+  std::istringstream lines (text);
+  std::string line;
+  std::size_t n = 0;
+  for (; std::getline (lines, line); ++n)
+    if (line != "INFO:file:1: console record")
+      return false;
+  return n == count;
+}
+
+int run_test ()
+{
+  // Console records are neither lost nor interleaved, whether they
+  // are gathered or not.
+  if (!wholeRecords (writeConcurrently (Output::FLUSH_ON_SIZE), 8000)
+      || !wholeRecords (writeConcurrently (Output::FLUSH_ALWAYS), 8000))
+    return TEST_FAILED;
+
+  // Keep the journal in the build directory.
+  setenv ("HPP_LOGGINGDIR",
+	  boost::filesystem::current_path ().string ().c_str (), 1);
+
+  std::string filename;
+  {
+    JournalOutput journal ("flush-policy");
+    filename = journal.getFilename ();
+    journal.setFlushPolicy (Output::FLUSH_ON_SIZE, 1000);
+    Channel info ("INFO", boost::assign::list_of<Output*> (&journal));
+    Channel error ("ERROR", boost::assign::list_of<Output*> (&journal));
+    journal.setUrgent (error);
+
+    // Below the threshold, records stay in the stream buffer.
+    std::string record (99, 'x');
+    record += '\n';
+    for (int i = 0; i < 5; ++i)
+      info.write ("file", 1, "run_test", record);
+    if (boost::filesystem::exists (filename)
+	&& boost::filesystem::file_size (filename) != 0)
+      return TEST_FAILED;
+
+    // Urgent channels are flushed immediately.
+    error.write ("file", 1, "run_test", "error\n");
+    boost::uintmax_t size = boost::filesystem::file_size (filename);
+    std::cout << "after error: " << size << " bytes" << std::endl;
+    if (size == 0)
+      return TEST_FAILED;
+
+    // So is everything once the threshold is reached.
+    for (int i = 0; i < 10; ++i)
+      info.write ("file", 1, "run_test", record);
+    std::cout << "after threshold: "
+	      << boost::filesystem::file_size (filename) << " bytes"
+	      << std::endl;
+    if (boost::filesystem::file_size (filename) < size + 1000)
+      return TEST_FAILED;
+  }
+  std::remove (filename.c_str ());
+
+  // The threshold counts the record prefixes as well: 200 bytes of
+  // messages, 1500 bytes written.
+  {
+    JournalOutput journal ("flush-policy-prefix");
+    filename = journal.getFilename ();
+    journal.setFlushPolicy (Output::FLUSH_ON_SIZE, 1000);
+    Channel info ("INFO", boost::assign::list_of<Output*> (&journal));
+    for (int i = 0; i < 100; ++i)
+      info.write ("file", 1, "run_test", "x\n");
+    if (!boost::filesystem::exists (filename)
+	|| boost::filesystem::file_size (filename) < 1000)
+      return TEST_FAILED;
+  }
+  std::remove (filename.c_str ());
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
@@ -0,0 +1,70 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <hpp/util/format-buffer.hh>
+#include <hpp/util/indent.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+int run_test ();
+
+int run_test ()
+{
+  const char* address;
+  {
+    ScopedFormatStream outer;
+    outer.stream () << std::hex << std::setprecision (2) << hpp::incindent
+		    << 255 << ' ' << 3.14159;
+    address = outer.str ().data ();
+    if (outer.str () != "ff 3.1")
+      return TEST_FAILED;
+
+    // A nested borrow gets its own stream.
+    ScopedFormatStream inner;
+    inner.stream () << "inner";
+    if (inner.str () != "inner" || outer.str () != "ff 3.1")
+      return TEST_FAILED;
+  }
+
+  {
+    // The stream is reused and restored to its initial state.
+    ScopedFormatStream stream;
+    stream.stream () << 255 << ' ' << 3.14159 << hpp::iendl << '.';
+    std::cout << stream.str () << std::endl;
+    if (stream.str ().data () != address
+	|| stream.str () != "255 3.14159\n.")
+      return TEST_FAILED;
+
+    // Records larger than the initial storage grow it.
+    std::string large (10000, 'x');
+    stream.stream () << large;
+    if (stream.str ().size () != 10013
+	|| stream.str ().substr (13) != large)
+      return TEST_FAILED;
+  }
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
@@ -0,0 +1,121 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#define HPP_ENABLE_BENCHMARK 1
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <hpp/util/latency-statistics.hh>
+#include <hpp/util/timer.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+static const boost::uint64_t nSamples = 100000;
+
+int run_test ();
+
+static void
+produce (LatencyStatistics* statistics)
+{
+  for (boost::uint64_t i = 1; i <= nSamples; ++i)
+    statistics->record (1000 * i);
+}
+
+/// \brief Whether \a value is within the bucket precision of \a exact.
+static bool
+close (boost::uint64_t value, double exact)
+{
+  return std::fabs ((double) value - exact) <= exact / 32;
+}
+
+int run_test ()
+{
+  LatencyStatistics& statistics = LatencyStatistics::get ("uniform");
+  if (&LatencyStatistics::get ("uniform") != &statistics)
+    return TEST_FAILED;
+
+  // Concurrent producers of 1, 2, ..., 100000 us.
+  boost::thread_group producers;
+  for (int i = 0; i < 4; ++i)
+    producers.create_thread (boost::bind (&produce, &statistics));
+  producers.join_all ();
+  std::cout << statistics << std::endl;
+
+  double mean = 1000. * (nSamples + 1) / 2;
+  double deviation = 1000. * std::sqrt ((nSamples * nSamples - 1) / 12.);
+  if (statistics.count () != 4 * nSamples
+      || statistics.min () != 1000 || statistics.max () != 1000 * nSamples
+      || std::fabs (statistics.mean () - mean) > 1e-6 * mean
+      || std::fabs (statistics.standardDeviation () - deviation)
+      > 1e-6 * deviation)
+    return TEST_FAILED;
+
+  double qs[] = { .5, .9, .99, .999 };
+  for (int i = 0; i < 4; ++i)
+    if (!close (statistics.percentile (qs[i]), qs[i] * 1000 * nSamples))
+      return TEST_FAILED;
+  if (!close (statistics.percentile (0), (double) statistics.min ())
+      || !close (statistics.percentile (1), (double) statistics.max ()))
+    return TEST_FAILED;
+
+  // Small values are exact.
+  LatencyStatistics& small = LatencyStatistics::get ("small");
+  for (boost::uint64_t i = 0; i < 50; ++i)
+    small.record (i);
+  if (small.percentile (.5) != 24 || small.percentile (1) != 49)
+    return TEST_FAILED;
+
+  // Benchmarks feed the statistics of their ID.
+  for (int i = 0; i < 3; ++i)
+    {
+      hppStartBenchmark (step);
+      hppStopBenchmark (step);
+    }
+  std::cout << LatencyStatistics::get ("step") << std::endl;
+  if (LatencyStatistics::get ("step").count () != 3)
+    return TEST_FAILED;
+
+  // Periodic reports: the first sample schedules the first one.
+  RecordingOutput output;
+  logging.benchmark.subscribe (&output);
+  LatencyStatistics::setReportInterval (1);
+  small.record (1);
+  small.record (1);
+  LatencyStatistics::setReportInterval (0);
+  small.record (1);
+  logging.benchmark.unsubscribe (&output);
+  if (output.records.size () != 1
+      || output.records[0].find ("small: 52 sample(s)") != 0)
+    return TEST_FAILED;
+
+  statistics.reset ();
+  if (statistics.count () != 0 || statistics.percentile (.5) != 0)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
@@ -0,0 +1,122 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <hpp/util/mapped-journal.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+static const int nThreads = 4;
+static const int nRecords = 5000;
+static const std::size_t segmentSize = 16384;
+static const std::size_t maxSegments = 3;
+static const std::string expected = "TEST:file:1: record\n";
+
+void produce (Channel* channel);
+int run_test ();
+
+void produce (Channel* channel)
+{
+  for (int i = 0; i < nRecords; ++i)
+    channel->write ("file", 1, "produce", "record\n");
+}
+
+int run_test ()
+{
+  // Keep the segments in the build directory.
+  setenv ("HPP_LOGGINGDIR",
+	  boost::filesystem::current_path ().string ().c_str (), 1);
+
+  std::string prefix;
+  {
+    MappedJournalOutput journal ("mapped-journal", segmentSize, maxSegments);
+    Channel channel ("TEST", boost::assign::list_of<Output*> (&journal));
+
+    boost::thread_group producers;
+    for (int i = 0; i < nThreads; ++i)
+      producers.create_thread (boost::bind (&produce, &channel));
+    producers.join_all ();
+
+    if (journal.droppedRecords () || journal.truncatedRecords ())
+      return TEST_FAILED;
+    prefix = journal.getFilename (0);
+    prefix.resize (prefix.size () - 5);
+  }
+
+  // Only the last segments are kept, and they hold whole records.
+  std::size_t nFiles = 0;
+  boost::filesystem::path directory =
+    boost::filesystem::path (prefix).parent_path ();
+  boost::filesystem::directory_iterator it (directory), end;
+  for (; it != end; ++it)
+    {
+      std::string filename = it->path ().string ();
+      if (filename.compare (0, prefix.size (), prefix) != 0)
+	continue;
+      ++nFiles;
+      std::ifstream file (filename.c_str ());
+      std::string line;
+      std::size_t size = 0;
+      while (std::getline (file, line))
+	{
+	  if (line + '\n' != expected)
+	    return TEST_FAILED;
+	  size += expected.size ();
+	}
+      std::cout << filename << ": " << size << " bytes" << std::endl;
+      if (size > segmentSize)
+	return TEST_FAILED;
+      std::remove (filename.c_str ());
+    }
+  if (nFiles == 0 || nFiles > maxSegments)
+    return TEST_FAILED;
+
+  // Records longer than a segment are cut and counted.
+  {
+    MappedJournalOutput journal ("mapped-journal-long", segmentSize,
+				 maxSegments);
+    Channel channel ("TEST", boost::assign::list_of<Output*> (&journal));
+    channel.write ("file", 1, "run_test", std::string (2 * segmentSize, 'x'));
+    channel.write ("file", 1, "run_test", "record\n");
+    std::cout << journal.truncatedRecords () << " record(s) truncated"
+	      << std::endl;
+    if (journal.truncatedRecords () != 1 || journal.droppedRecords ())
+      return TEST_FAILED;
+    prefix = journal.getFilename (0);
+    prefix.resize (prefix.size () - 5);
+  }
+  for (boost::filesystem::directory_iterator it (directory); it != end; ++it)
+    if (it->path ().string ().compare (0, prefix.size (), prefix) == 0)
+      std::remove (it->path ().string ().c_str ());
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
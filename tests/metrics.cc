@@ -0,0 +1,109 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "config.h"
+
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+#include <hpp/util/metrics.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+int run_test ();
+
+int run_test ()
+{
+  if (MetricSlot::bucket (0) != 0 || MetricSlot::bucket (1) != 1
+      || MetricSlot::bucket (3) != 2 || MetricSlot::bucket (4) != 3
+      || MetricSlot::bucket ((boost::uint64_t) -1)
+      != MetricSlot::bucketCount - 1)
+    return TEST_FAILED;
+
+  Counter nodes = Metrics::counter ("nodes expanded");
+  nodes.add ();
+  nodes.add (9);
+  // Same name, same metric.
+  Metrics::counter ("nodes expanded").add (5);
+  if (nodes.value () != 15)
+    return TEST_FAILED;
+
+  Gauge queue = Metrics::gauge ("queue depth");
+  queue.set (10);
+  queue.add (-3);
+  if (queue.value () != 7)
+    return TEST_FAILED;
+
+  Histogram checks = Metrics::histogram ("collision check ns");
+  checks.record (100);
+  checks.record (300);
+  if (checks.count () != 2 || checks.sum () != 400)
+    return TEST_FAILED;
+
+  // Another type is not published.
+  Gauge wrong = Metrics::gauge ("nodes expanded");
+  wrong.set (1);
+  if (nodes.value () != 15 || wrong.value () != 1)
+    return TEST_FAILED;
+
+  // Unpublished metrics do not share their values.
+  Counter first;
+  Counter second;
+  first.add ();
+  if (first.value () != 1 || second.value () != 0)
+    return TEST_FAILED;
+  Gauge other = Metrics::gauge ("nodes expanded");
+  if (other.value () != 0)
+    return TEST_FAILED;
+
+  if (!Metrics::isShared ())
+    {
+      std::cout << "shared memory not available" << std::endl;
+      return TEST_SUCCEED;
+    }
+
+  // Read the segment as hpp-util-top does.
+  MetricsView view (getpid ());
+  if (!view.isAttached () || view.size () != 3)
+    return TEST_FAILED;
+  const MetricSlot& node = view.slot (0);
+  const MetricSlot& depth = view.slot (1);
+  const MetricSlot& check = view.slot (2);
+  std::cout << node.name << ", " << depth.name << ", " << check.name
+	    << std::endl;
+  if (std::string (node.name) != "nodes expanded"
+      || node.type != METRIC_COUNTER || node.value.load () != 15
+      || depth.type != METRIC_GAUGE || depth.value.load () != 7
+      || check.type != METRIC_HISTOGRAM || check.count.load () != 2
+      || check.buckets[MetricSlot::bucket (100)].load () != 1
+      || check.buckets[MetricSlot::bucket (300)].load () != 1)
+    return TEST_FAILED;
+  nodes.add ();
+  if (node.value.load () != 16)
+    return TEST_FAILED;
+
+  if (MetricsView (0).isAttached ())
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
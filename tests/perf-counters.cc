@@ -0,0 +1,77 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <iostream>
+
+#include <hpp/util/perf-counters.hh>
+#include <hpp/util/timer.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+int run_test ();
+
+static volatile double sink;
+
+static void
+work ()
+{
+  double x = 0;
+  for (int i = 0; i < 1000000; ++i)
+    x += i * .5;
+  sink = x;
+}
+
+int run_test ()
+{
+  // Counters are not read by default.
+  Timer timer (true);
+  work ();
+  timer.stop ();
+  if (!timer.counters ().empty () || !PerfCounters::read ().empty ())
+    return TEST_FAILED;
+
+  PerfCounters::setEnabled (true);
+  bool available = !PerfCounters::read ().empty ();
+  timer.start ();
+  work ();
+  timer.stop ();
+  PerfCounters counters = timer.counters ();
+  timer.print (std::cout) << std::endl;
+
+  // Counters may not be permitted: timers then behave as before.
+  if (!available)
+    {
+      std::cout << "hardware counters not available" << std::endl;
+      return counters.empty () ? TEST_SUCCEED : TEST_FAILED;
+    }
+  if (counters.empty ())
+    return TEST_FAILED;
+  if (counters.isValid (PerfCounters::INSTRUCTIONS)
+      && counters.value (PerfCounters::INSTRUCTIONS) < 1000000)
+    return TEST_FAILED;
+  if (counters.isValid (PerfCounters::CYCLES)
+      && counters.isValid (PerfCounters::INSTRUCTIONS)
+      && counters.instructionsPerCycle () <= 0)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
@@ -0,0 +1,156 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#define HPP_ENABLE_BENCHMARK 1
+#define HPP_DEBUG_CHANNEL_BENCHMARK 1
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <boost/thread/thread.hpp>
+
+#include <hpp/util/timer.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+struct Region
+{
+  Region ()
+    : calls (0),
+      inclusive (0),
+      exclusive (0)
+  {}
+
+  int calls;
+  double inclusive;
+  double exclusive;
+};
+
+int run_test ();
+
+static void
+sleep (int milliseconds)
+{
+  boost::this_thread::sleep (boost::posix_time::milliseconds (milliseconds));
+}
+
+static void
+plan ()
+{
+  hppProfileScope (plan);
+  {
+    hppProfileScope (sample);
+    sleep (2);
+  }
+  {
+    hppProfileScope (sample);
+    sleep (2);
+  }
+  hppProfileScope (steer);
+  sleep (5);
+}
+
+/// \brief Stop benchmarks in the order they were started.
+static void
+overlap ()
+{
+  hppStartBenchmark (load);
+  hppStartBenchmark (parse);
+  hppStopBenchmark (load);
+  hppStopBenchmark (parse);
+  hppProfileScope (solve);
+}
+
+/// \brief Find region \a path, its name indented by its depth, in the
+/// report.
+static Region
+find (const std::string& report, const std::string& path)
+{
+  Region region;
+  std::istringstream lines (report);
+  std::string line;
+  while (std::getline (lines, line))
+    if (line.size () > 45 && line.substr (45) == path)
+      {
+	std::istringstream fields (line);
+	fields >> region.calls >> region.inclusive >> region.exclusive;
+      }
+  return region;
+}
+
+int run_test ()
+{
+  for (int i = 0; i < 3; ++i)
+    plan ();
+  boost::thread other (&plan);
+  other.join ();
+
+  hppStartBenchmark (build);
+  sleep (1);
+  hppStopBenchmark (build);
+  overlap ();
+
+  std::ostringstream report;
+  Profiler::print (report);
+  std::cout << report.str ();
+
+  // Trees of both threads are merged by path.
+  Region planRegion = find (report.str (), "plan");
+  Region sample = find (report.str (), "  sample");
+  Region steer = find (report.str (), "  steer");
+  Region build = find (report.str (), "build");
+  if (planRegion.calls != 4 || sample.calls != 8 || steer.calls != 4
+      || build.calls != 1)
+    return TEST_FAILED;
+  // Overlapping benchmarks leave no region active.
+  if (find (report.str (), "load").calls != 1
+      || find (report.str (), "  parse").calls != 1
+      || find (report.str (), "solve").calls != 1)
+    return TEST_FAILED;
+  if (sample.inclusive < 8 * 2 || steer.inclusive < 4 * 5
+      || planRegion.inclusive < sample.inclusive + steer.inclusive)
+    return TEST_FAILED;
+  if (sample.exclusive != sample.inclusive
+      || planRegion.exclusive > planRegion.inclusive - sample.inclusive
+      - steer.inclusive + 2e-3)
+    return TEST_FAILED;
+
+  // The report goes to the benchmark channel.
+  RecordingOutput output;
+  logging.benchmark.subscribe (&output);
+  hppDisplayProfile ();
+  logging.benchmark.unsubscribe (&output);
+  if (output.records.size () != 1
+      || output.records[0].find ("  sample") == std::string::npos)
+    return TEST_FAILED;
+
+  // Nothing is left to report after a reset.
+  Profiler::reset ();
+  std::ostringstream empty;
+  Profiler::print (empty);
+  std::cout << empty.str ();
+  if (find (empty.str (), "plan").calls != 0)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
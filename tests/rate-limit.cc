@@ -0,0 +1,81 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#define HPP_DEBUG_CHANNEL_INFO 1
+
+#include <iostream>
+#include <string>
+#include <hpp/util/debug.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+static int formatted = 0;
+
+int format ();
+int run_test ();
+
+int format ()
+{
+  return ++formatted;
+}
+
+int run_test ()
+{
+  RecordingOutput output;
+  logging.info.subscribe (&output);
+
+  for (int i = 0; i < 100; ++i)
+    {
+      hppDoutEveryN (info, 10, "every " << format ());
+      hppDoutFirstN (info, 5, "first " << format ());
+      hppDoutRateLimited (info, 3, "limited " << format ());
+    }
+
+  // Suppressed hits are not formatted. The rate-limited site may
+  // straddle a second boundary.
+  std::cout << formatted << " formatted" << std::endl;
+  if (formatted < 10 + 5 + 3 || formatted > 10 + 5 + 6
+      || output.records.size () != (std::size_t) formatted)
+    return TEST_FAILED;
+
+  // One summary per site.
+  RateLimiter::logSummary ();
+  std::size_t summaries = output.records.size () - formatted;
+  bool everyN = false;
+  for (std::size_t i = formatted; i < output.records.size (); ++i)
+    {
+      std::cout << output.records[i];
+      everyN = everyN || output.records[i].find
+	("90 record(s) suppressed") != std::string::npos;
+    }
+  if (summaries != 3 || !everyN)
+    return TEST_FAILED;
+
+  // Nothing new to report.
+  RateLimiter::logSummary ();
+  if (output.records.size () != formatted + summaries)
+    return TEST_FAILED;
+
+  logging.info.unsubscribe (&output);
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
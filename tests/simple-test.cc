@@ -23,10 +23,34 @@
 #include "common.hh"
 
 
+using namespace hpp::debug;
+
 int run_test ();
 
 int run_test ()
 {
+  // A channel without enabled subscribers must be disabled.
+  Channel channel ("TEST", Channel::subscribers_t ());
+  if (channel.isEnabled ())
+    return TEST_FAILED;
+
+  channel.subscribe (&logging.console);
+  if (!channel.isEnabled ())
+    return TEST_FAILED;
+
+  logging.console.setEnabled (false);
+  if (channel.isEnabled () || !logging.error.isEnabled ())
+    return TEST_FAILED;
+  logging.console.setEnabled (true);
+
+  channel.setEnabled (false);
+  if (channel.isEnabled ())
+    return TEST_FAILED;
+  channel.setEnabled (true);
+
+  channel.unsubscribe (&logging.console);
+  if (channel.isEnabled ())
+    return TEST_FAILED;
   return 0;
 }
 
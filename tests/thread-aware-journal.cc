@@ -0,0 +1,91 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <hpp/util/debug.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+static const int nThreads = 4;
+static const int nRecords = 1000;
+
+void produce (Channel* channel);
+int run_test ();
+
+void produce (Channel* channel)
+{
+  for (int i = 0; i < nRecords; ++i)
+    channel->write (__FILE__, __LINE__, "produce", "record\n");
+}
+
+int run_test ()
+{
+  // Keep the shards in the build directory.
+  setenv ("HPP_LOGGINGDIR",
+	  boost::filesystem::current_path ().string ().c_str (), 1);
+
+  JournalOutput journal ("thread-aware-journal");
+  journal.setThreadAware (JournalOutput::SHARDED);
+  Channel channel ("TEST", boost::assign::list_of<Output*> (&journal));
+
+  boost::thread_group producers;
+  for (int i = 0; i < nThreads; ++i)
+    producers.create_thread (boost::bind (&produce, &channel));
+  producers.join_all ();
+  journal.flush ();
+
+  // Each thread tracks its own function: one ``entering'' line and
+  // all its records in its own shard.
+  std::string prefix (journal.getFilename ());
+  prefix.resize (prefix.size () - 4);
+  for (int i = 0; i < nThreads; ++i)
+    {
+      std::string shard = (boost::format ("%1%.%2%.log") % prefix % i).str ();
+      std::ifstream file (shard.c_str ());
+      int entering = 0, records = 0;
+      std::string line;
+      while (std::getline (file, line))
+	{
+	  if (line.find ("entering produce") != std::string::npos)
+	    ++entering;
+	  else if (line.find ("record") != std::string::npos)
+	    ++records;
+	}
+      std::cout << shard << ": " << records << " records" << std::endl;
+      std::remove (shard.c_str ());
+      if (entering != 1 || records != nRecords)
+	return TEST_FAILED;
+    }
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
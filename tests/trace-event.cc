@@ -0,0 +1,105 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "config.h"
+
+#define HPP_ENABLE_BENCHMARK 1
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <string>
+
+#include <boost/thread/thread.hpp>
+
+#include <hpp/util/timer.hh>
+#include <hpp/util/trace-event.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+int run_test ();
+
+static void
+plan ()
+{
+  hppProfileScope (plan);
+  for (int i = 0; i < 10; ++i)
+    {
+      hppStartBenchmark (sample);
+      hppStopBenchmark (sample);
+    }
+}
+
+/// \brief Number of occurrences of \a pattern in \a text.
+static std::size_t
+count (const std::string& text, const std::string& pattern)
+{
+  std::size_t n = 0;
+  for (std::size_t i = text.find (pattern); i != std::string::npos;
+       i = text.find (pattern, i + 1))
+    ++n;
+  return n;
+}
+
+int run_test ()
+{
+  std::string filename;
+  {
+    TraceEventOutput trace ("trace-event");
+    filename = trace.getFilename ();
+    logging.benchmark.subscribe (&trace);
+
+    plan ();
+    boost::thread other (&plan);
+    other.join ();
+    logging.benchmark.write (__FILE__, __LINE__, __PRETTY_FUNCTION__,
+			     "a \"quoted\" record\n");
+  }
+
+  std::ifstream file (filename.c_str ());
+  std::string trace ((std::istreambuf_iterator<char> (file)),
+		     std::istreambuf_iterator<char> ());
+  std::cout << trace.substr (0, 400) << "..." << std::endl;
+
+  // A closed JSON array of balanced begin/end events.
+  if (trace.compare (0, 2, "[\n") != 0
+      || trace.compare (trace.size () - 4, 4, "}\n]\n") != 0)
+    return TEST_FAILED;
+  if (count (trace, "\"ph\":\"B\"") != 22
+      || count (trace, "\"ph\":\"E\"") != 22
+      || count (trace, "\"name\":\"sample\",\"cat\":\"region\"") != 40)
+    return TEST_FAILED;
+
+  // Events of both threads.
+  std::set<std::string> threads;
+  for (std::size_t i = trace.find ("\"tid\":"); i != std::string::npos;
+       i = trace.find ("\"tid\":", i + 1))
+    threads.insert (trace.substr (i, trace.find_first_of (",}", i) - i));
+  if (threads.size () != 2)
+    return TEST_FAILED;
+
+  // Channel records are escaped instant events.
+  if (count (trace, "\"name\":\"a \\\"quoted\\\" record\",\"cat\":\"BENCHMARK\","
+	     "\"ph\":\"i\"") != 1)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
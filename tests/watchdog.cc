@@ -0,0 +1,107 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "config.h"
+
+#define HPP_ENABLE_BENCHMARK 1
+
+#include <iostream>
+#include <string>
+
+#include <boost/thread/thread.hpp>
+
+#include <hpp/util/timer.hh>
+#include <hpp/util/watchdog.hh>
+
+#include "common.hh"
+
+using namespace hpp::debug;
+
+const boost::uint64_t millisecond = 1000 * 1000;
+
+static Deadline outer ("outer", 1000 * millisecond, __FILE__, __LINE__);
+static Deadline inner ("inner", 5 * millisecond, __FILE__, __LINE__);
+
+int run_test ();
+
+static void
+sleep (int milliseconds)
+{
+  boost::this_thread::sleep (boost::posix_time::milliseconds (milliseconds));
+}
+
+static void
+slowIteration ()
+{
+  hppDeadlineScope (iteration, 5 * millisecond);
+  sleep (30);
+}
+
+static void
+nested ()
+{
+  DeadlineScope outerScope (outer);
+  for (int i = 0; i < 3; ++i)
+    {
+      DeadlineScope innerScope (inner);
+      if (i == 1)
+	sleep (30);
+    }
+}
+
+int run_test ()
+{
+  RecordingOutput output;
+  logging.warning.subscribe (&output);
+  Watchdog::setPeriod (millisecond);
+
+  // Reported once while open, by the watchdog thread.
+  slowIteration ();
+  if (output.count ("region iteration on thread") != 1
+      || Watchdog::reported () != 1)
+    return TEST_FAILED;
+
+  // Only the slow inner region exceeds its budget.
+  boost::thread other (&nested);
+  other.join ();
+  if (output.count ("region inner") != 1
+      || output.count ("region outer") != 0
+      || inner.completed () != 3 || inner.overBudget () != 1
+      || outer.completed () != 1 || outer.overBudget () != 0)
+    return TEST_FAILED;
+
+  // Regions over budget are counted even if not seen open.
+  Watchdog::stop ();
+  nested ();
+  if (output.count ("region inner") != 1
+      || inner.completed () != 6 || inner.overBudget () != 2)
+    return TEST_FAILED;
+
+  Deadline::logSummary ();
+  logging.warning.unsubscribe (&output);
+  for (std::size_t i = 0; i < output.records.size (); ++i)
+    std::cout << output.records[i];
+  if (output.count ("2 region(s) inner over the budget of 5 ms, 2 of 6")
+      != 1
+      || output.count ("1 region(s) iteration over the budget") != 1
+      || output.count ("outer over") != 0)
+    return TEST_FAILED;
+  return TEST_SUCCEED;
+}
+
+GENERATE_TEST ()
@@ -0,0 +1,222 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+// Turn a binary journal (journal.PID.bin) back into the text format
+// written by JournalOutput.
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/format.hpp>
+
+#include <hpp/util/binary-record.hh>
+#include <hpp/util/indent.hh>
+
+using namespace hpp;
+using namespace hpp::debug;
+
+namespace
+{
+  struct Site
+  {
+    std::string channel;
+    std::string file;
+    int line;
+    std::string function;
+    std::string format;
+  };
+
+  typedef std::map<boost::uint32_t, Site> sites_t;
+
+  template <typename T>
+  bool read (std::istream& stream, T& value)
+  {
+    stream.read (reinterpret_cast<char*> (&value), sizeof (T));
+    return !stream.fail ();
+  }
+
+  bool read (std::istream& stream, std::string& value)
+  {
+    boost::uint32_t length;
+    if (!read (stream, length))
+      return false;
+    value.resize (length);
+    return length == 0 || stream.read (&value[0], length);
+  }
+
+  std::ostream& writePrefix (std::ostream& stream, const Site& site)
+  {
+    return stream << site.channel << ':' << site.file << ':'
+		  << site.line << ": ";
+  }
+
+  int decode (std::istream& stream, std::ostream& out, bool timestamps)
+  {
+    const std::size_t magicSize = std::strlen (HPP_UTIL_BINARY_JOURNAL_MAGIC);
+    std::string magic (magicSize, '\0');
+    if (!stream.read (&magic[0], magicSize)
+	|| magic != HPP_UTIL_BINARY_JOURNAL_MAGIC)
+      {
+	std::cerr << "hpp-log-decode: not a binary journal" << std::endl;
+	return 1;
+      }
+
+    sites_t sites;
+    std::string lastFunction;
+    std::string data;
+    char kind;
+    // Whether the last entry was read up to its end.
+    bool complete = true;
+    while (stream.get (kind))
+      {
+	complete = false;
+	boost::uint32_t id;
+	if (!read (stream, id))
+	  break;
+
+	if (kind == ENTRY_SITE)
+	  {
+	    Site site;
+	    boost::int32_t line;
+	    if (!read (stream, line)
+		|| !read (stream, site.channel)
+		|| !read (stream, site.file)
+		|| !read (stream, site.function)
+		|| !read (stream, site.format))
+	      break;
+	    site.line = line;
+	    sites[id] = site;
+	    complete = true;
+	    continue;
+	  }
+
+	if (kind != ENTRY_MESSAGE)
+	  {
+	    std::cerr << "hpp-log-decode: unknown entry kind "
+		      << (int) kind << std::endl;
+	    return 1;
+	  }
+	boost::uint64_t timestamp;
+	boost::uint32_t size;
+	if (!read (stream, timestamp)
+	    || !read (stream, size))
+	  break;
+	data.resize (size);
+	if (size && !stream.read (&data[0], size))
+	  break;
+	complete = true;
+
+	sites_t::const_iterator it = sites.find (id);
+	if (it == sites.end ())
+	  {
+	    std::cerr << "hpp-log-decode: undefined call site " << id
+		      << std::endl;
+	    return 1;
+	  }
+	const Site& site = it->second;
+
+	std::ostringstream message;
+	if (!BinaryRecord::print (message, data.data (), data.size ()))
+	  {
+	    std::cerr << "hpp-log-decode: corrupted record" << std::endl;
+	    return 1;
+	  }
+
+	// Same layout as JournalOutput.
+	if (lastFunction != site.function)
+	  {
+	    if (!lastFunction.empty ())
+	      {
+		writePrefix (out, site);
+		out << "exiting " << lastFunction << inl;
+	      }
+	    writePrefix (out, site);
+	    out << "entering " << site.function << inl;
+	    lastFunction = site.function;
+	  }
+	if (timestamps)
+	  out << boost::format ("[%1%.%|2$09|] ")
+	    % (timestamp / 1000000000u) % (timestamp % 1000000000u);
+	writePrefix (out, site);
+	out << incindent << message.str () << decindent;
+      }
+
+    // A stream ending inside an entry is at its end as well.
+    if (!complete || !stream.eof ())
+      {
+	std::cerr << "hpp-log-decode: truncated journal" << std::endl;
+	return 1;
+      }
+    return 0;
+  }
+
+  void usage (std::ostream& stream)
+  {
+    stream << "Usage: hpp-log-decode [-t] JOURNAL..." << std::endl
+	   << "Print binary journals (journal.PID.bin) as text." << std::endl
+	   << std::endl
+	   << "  -t  prefix each record with its monotonic timestamp"
+	   << std::endl;
+  }
+} // end of anonymous namespace.
+
+int main (int argc, char** argv)
+{
+  bool timestamps = false;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg (argv[i]);
+      if (arg == "-t")
+	timestamps = true;
+      else if (arg == "-h" || arg == "--help")
+	{
+	  usage (std::cout);
+	  return 0;
+	}
+      else
+	files.push_back (arg);
+    }
+
+  if (files.empty ())
+    {
+      usage (std::cerr);
+      return 1;
+    }
+
+  int status = 0;
+  for (std::size_t i = 0; i < files.size (); ++i)
+    {
+      std::ifstream stream (files[i].c_str (),
+			    std::ios_base::in | std::ios_base::binary);
+      if (!stream)
+	{
+	  std::cerr << "hpp-log-decode: cannot open " << files[i]
+		    << std::endl;
+	  status = 1;
+	  continue;
+	}
+      status |= decode (stream, std::cout, timestamps);
+    }
+  return status;
+}
@@ -0,0 +1,240 @@
+// Copyright (C) 2014 by CNRS.
+//
+// This file is part of the hpp-util.
+//
+// hpp-util is free software: you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+//
+// hpp-util is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with hpp-util.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Show the live metrics (see hpp/util/metrics.hh) of a running process.
+
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <hpp/util/clock.hh>
+#include <hpp/util/metrics.hh>
+
+using namespace hpp::debug;
+
+namespace
+{
+  /// \brief Values of a slot at the previous update.
+  struct Previous
+  {
+    Previous ()
+      : value (0),
+	count (0)
+    {}
+
+    boost::int64_t value;
+    boost::uint64_t count;
+  };
+
+  /// \brief Upper bound of the bucket holding quantile \a q.
+  boost::uint64_t quantile (const MetricSlot& slot, boost::uint64_t count,
+			    double q)
+  {
+    boost::uint64_t rank = (boost::uint64_t) (q * (double) count);
+    boost::uint64_t seen = 0;
+    for (std::size_t i = 0; i < MetricSlot::bucketCount; ++i)
+      {
+	seen += slot.buckets[i].load (boost::memory_order_relaxed);
+	if (seen > rank)
+	  return i ? (boost::uint64_t) 1 << i : 0;
+      }
+    return 0;
+  }
+
+  char const* typeName (boost::uint32_t type)
+  {
+    switch (type)
+      {
+      case METRIC_COUNTER:
+	return "counter";
+      case METRIC_GAUGE:
+	return "gauge";
+      case METRIC_HISTOGRAM:
+	return "histogram";
+      default:
+	return "?";
+      }
+  }
+
+  void show (std::ostream& out, int pid, const MetricsView& view,
+	     std::vector<Previous>& previous, double elapsed)
+  {
+    out << "process " << pid << ", " << view.size () << " metric(s)"
+	<< std::endl
+	<< boost::format ("%-40s %-9s %14s %12s %12s %10s %10s")
+      % "metric" % "type" % "value" % "rate/s" % "mean" % "p50" % "p99"
+	<< std::endl;
+    previous.resize (view.size ());
+    for (std::size_t i = 0; i < view.size (); ++i)
+      {
+	const MetricSlot& slot = view.slot (i);
+	boost::int64_t value = slot.value.load (boost::memory_order_relaxed);
+	boost::uint64_t count = slot.count.load (boost::memory_order_relaxed);
+	out << boost::format ("%-40s %-9s ") % slot.name % typeName (slot.type);
+	switch (slot.type)
+	  {
+	  case METRIC_COUNTER:
+	    out << boost::format ("%14d") % value;
+	    if (elapsed > 0)
+	      out << boost::format (" %12.1f")
+		% ((double) (value - previous[i].value) / elapsed);
+	    break;
+	  case METRIC_GAUGE:
+	    out << boost::format ("%14d") % value;
+	    break;
+	  case METRIC_HISTOGRAM:
+	    out << boost::format ("%14d") % count;
+	    if (elapsed > 0)
+	      out << boost::format (" %12.1f")
+		% ((double) (count - previous[i].count) / elapsed);
+	    else
+	      out << boost::format (" %12s") % "";
+	    if (count)
+	      out << boost::format (" %12.1f %10s %10s")
+		% ((double) value / (double) count)
+		% ("<" + boost::lexical_cast<std::string>
+		   (quantile (slot, count, .5)))
+		% ("<" + boost::lexical_cast<std::string>
+		   (quantile (slot, count, .99)));
+	    break;
+	  }
+	out << std::endl;
+	previous[i].value = value;
+	previous[i].count = count;
+      }
+  }
+
+  /// \brief List the processes publishing metrics.
+  int list (std::ostream& out)
+  {
+    namespace fs = boost::filesystem;
+    // Segment names without the leading slash and the identifier.
+    std::string prefix = Metrics::segmentName (0);
+    prefix = prefix.substr (1, prefix.size () - 2);
+    boost::system::error_code error;
+    fs::directory_iterator it ("/dev/shm", error), end;
+    if (error)
+      {
+	std::cerr << "hpp-util-top: cannot list /dev/shm" << std::endl;
+	return 1;
+      }
+    for (; it != end; ++it)
+      {
+	std::string name = it->path ().filename ().string ();
+	if (name.compare (0, prefix.size (), prefix) == 0)
+	  out << name.substr (prefix.size ()) << std::endl;
+      }
+    return 0;
+  }
+
+  void usage (std::ostream& stream)
+  {
+    stream << "Usage: hpp-util-top [-d SECONDS] [-n COUNT] [PID]"
+	   << std::endl
+	   << "Show the live metrics of process PID, or list the processes"
+	   << std::endl
+	   << "publishing metrics." << std::endl
+	   << std::endl
+	   << "  -d  delay between updates (default 1)" << std::endl
+	   << "  -n  number of updates (default until the process exits)"
+	   << std::endl;
+  }
+} // end of anonymous namespace.
+
+int main (int argc, char** argv)
+{
+  double delay = 1;
+  long count = -1;
+  int pid = 0;
+  for (int i = 1; i < argc; ++i)
+    {
+      std::string arg (argv[i]);
+      if ((arg == "-d" || arg == "-n") && i + 1 < argc)
+	{
+	  char* end;
+	  double value = std::strtod (argv[++i], &end);
+	  if (*end || value <= 0)
+	    {
+	      usage (std::cerr);
+	      return 1;
+	    }
+	  if (arg == "-d")
+	    delay = value;
+	  else
+	    count = (long) value;
+	}
+      else if (arg == "-h" || arg == "--help")
+	{
+	  usage (std::cout);
+	  return 0;
+	}
+      else if (!pid
+	       && arg.find_first_not_of ("0123456789") == std::string::npos)
+	pid = std::atoi (arg.c_str ());
+      else
+	{
+	  usage (std::cerr);
+	  return 1;
+	}
+    }
+
+  if (!pid)
+    return list (std::cout);
+
+  MetricsView view (pid);
+  if (!view.isAttached ())
+    {
+      std::cerr << "hpp-util-top: no metrics for process " << pid
+		<< std::endl;
+      return 1;
+    }
+
+  // Redraw in place on terminals.
+  bool clear = isatty (STDOUT_FILENO);
+  std::vector<Previous> previous;
+  boost::uint64_t last = 0;
+  for (long n = 0; count < 0 || n < count; ++n)
+    {
+      if (n)
+	boost::this_thread::sleep
+	  (boost::posix_time::milliseconds ((long) (delay * 1000)));
+      boost::uint64_t now = steadyNow ();
+      if (clear)
+	std::cout << "\033[H\033[2J";
+      show (std::cout, pid, view, previous,
+	    last ? (double) (now - last) * 1e-9 : 0);
+      last = now;
+      if (kill (pid, 0) != 0 && errno == ESRCH)
+	{
+	  std::cout << "process " << pid << " exited" << std::endl;
+	  break;
+	}
+    }
+  return 0;
+}